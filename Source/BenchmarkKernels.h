@@ -0,0 +1,1024 @@
+#pragma once
+#include <JuceHeader.h>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <vector>
+#include "Interpolation.h"
+#include "FormulaParser.h"
+#include "dsp/Channels.h"
+#include "dsp/Wavetable.h"
+#include "dsp/Perlin2.h"
+#include "dsp/Vibrato.h"
+#include "dsp/EnvelopeFollower.h"
+#include "dsp/DryWetProcessor.h"
+#include "oversampling/ConvolutionFilter.h"
+#include "oversampling/IIRFilter.h"
+#include "BenchmarkProcessBlock.h"
+
+/*
+micro-benchmarks of the dsp primitives.
+every kernel runs at several block sizes on the same noise and is compared to a plain reference implementation,
+that computes the same thing sample by sample and in long double where it matters.
+a kernel passes if it stays within a number of ulps of its reference or far enough below it in db,
+so a vectorized or reordered kernel can be checked without being bit-exact.
+headless, f.ex. through the batch renderer's --kernels option.
+*/
+
+namespace benchmark
+{
+	namespace kernel
+	{
+		using AudioBufferD = juce::AudioBuffer<double>;
+		using Int64 = juce::int64;
+		using Real = long double;
+
+		// samples per channel every kernel processes at every block size
+		static constexpr int NumSamples = 1 << 14;
+		static constexpr int NumChannels = 2;
+		// the fastest of these runs is logged, the others were disturbed by something
+		static constexpr int NumRuns = 7;
+		static constexpr std::array<int, 5> BlockSizes { 16, 64, 256, 1024, 4096 };
+		static constexpr double SampleRate = 44100.;
+		static constexpr double Tau = 6.283185307179586476925286766559;
+
+		/*
+		how far a kernel may be off its reference. it passes if either holds.
+		ulps are counted at the level of the signal, so the samples near zero don't dominate them
+		*/
+		struct Tolerance
+		{
+			Int64 ulps;
+			// the largest error relative to the rms of the reference
+			double db;
+		};
+
+		/* n, for kernels that compute the same thing as their reference in another order */
+		inline Tolerance ulps(Int64 n) noexcept
+		{
+			return { n, -std::numeric_limits<double>::infinity() };
+		}
+
+		/* d, for recursive kernels, whose rounding errors are fed back */
+		inline Tolerance db(double d) noexcept
+		{
+			return { 0, d };
+		}
+
+		struct Kernel
+		{
+			String name;
+			Tolerance tolerance;
+			int numChannels;
+			// the kernel computes in float, so the ulps are counted in floats
+			bool singlePrecision;
+			/* blockSize, clears the states of the kernel and of its reference */
+			std::function<void(int)> prepare;
+			/* samples, s, numSamples. writes the block that starts at sample s of the input */
+			std::function<void(double* const*, int, int)> process, reference;
+		};
+
+		struct Error
+		{
+			Int64 ulps = 0;
+			double db = -std::numeric_limits<double>::infinity();
+			bool nan = false;
+
+			bool passed(const Tolerance& tolerance) const noexcept
+			{
+				return !nan && (ulps <= tolerance.ulps || db <= tolerance.db);
+			}
+
+			void merge(const Error& other) noexcept
+			{
+				ulps = std::max(ulps, other.ulps);
+				db = std::max(db, other.db);
+				nan = nan || other.nan;
+			}
+		};
+
+		/* x, singlePrecision, the distance from x to the next representable value */
+		inline double getUlp(double x, bool singlePrecision) noexcept
+		{
+			if (singlePrecision)
+			{
+				const auto f = static_cast<float>(std::abs(x));
+				return static_cast<double>(std::nextafter(f, std::numeric_limits<float>::infinity()) - f);
+			}
+			return std::nextafter(std::abs(x), std::numeric_limits<double>::infinity()) - std::abs(x);
+		}
+
+		inline Error compare(const AudioBufferD& output, const AudioBufferD& reference, int numChannels, bool singlePrecision) noexcept
+		{
+			Error error;
+			auto sumSq = 0., maxErr = 0.;
+			for (auto ch = 0; ch < numChannels; ++ch)
+			{
+				const auto out = output.getReadPointer(ch);
+				const auto ref = reference.getReadPointer(ch);
+				for (auto s = 0; s < NumSamples; ++s)
+				{
+					if (std::isnan(out[s]) || std::isnan(ref[s]))
+					{
+						error.nan = true;
+						continue;
+					}
+					sumSq += ref[s] * ref[s];
+					maxErr = std::max(maxErr, std::abs(out[s] - ref[s]));
+				}
+			}
+			if (maxErr == 0.)
+				return error;
+			auto rms = std::sqrt(sumSq / static_cast<double>(NumSamples * numChannels));
+			if (rms == 0.)
+				rms = 1.;
+			error.ulps = static_cast<Int64>(std::ceil(maxErr / getUlp(rms, singlePrecision)));
+			error.db = 20. * std::log10(maxErr / rms);
+			return error;
+		}
+
+		/* buffer, numChannels, blockSize, func(samples, s, numSamples) for every block of the signal */
+		template<typename Func>
+		inline void forEachBlock(AudioBufferD& buffer, int numChannels, int blockSize, Func&& func)
+		{
+			std::array<double*, NumChannels> samples;
+			for (auto s = 0; s < NumSamples; s += blockSize)
+			{
+				for (auto ch = 0; ch < numChannels; ++ch)
+					samples[ch] = buffer.getWritePointer(ch, s);
+				func(samples.data(), s, std::min(blockSize, NumSamples - s));
+			}
+		}
+
+		/* kernel, output, reference, log. returns true if the kernel matched its reference at every block size */
+		inline bool run(Kernel& kernel, AudioBufferD& output, AudioBufferD& reference, const std::function<void(const String&)>& log)
+		{
+			Error error;
+			String times("  ns/sample");
+			for (const auto blockSize : BlockSizes)
+			{
+				kernel.prepare(blockSize);
+				forEachBlock(reference, kernel.numChannels, blockSize, kernel.reference);
+				kernel.prepare(blockSize);
+				forEachBlock(output, kernel.numChannels, blockSize, kernel.process);
+				error.merge(compare(output, reference, kernel.numChannels, kernel.singlePrecision));
+
+				auto best = Duration(std::numeric_limits<double>::max());
+				for (auto r = 0; r < NumRuns; ++r)
+				{
+					kernel.prepare(blockSize);
+					const auto start = Clock::now();
+					forEachBlock(output, kernel.numChannels, blockSize, kernel.process);
+					best = std::min(best, Duration(Clock::now() - start));
+				}
+				const auto ns = best.count() * 1e9 / static_cast<double>(NumSamples * kernel.numChannels);
+				times += "  " + String(blockSize) + ": " + String(ns, 2);
+			}
+
+			const auto passed = error.passed(kernel.tolerance);
+			log(kernel.name + ": " + String(error.ulps) + " ulps, "
+				+ (std::isinf(error.db) ? String("exact") : String(error.db, 1) + " dB")
+				+ (error.nan ? ", nan" : "") + (passed ? ", passed" : ", FAILED"));
+			log(times);
+			return passed;
+		}
+
+		// the read positions of the interpolators run across the whole table and over its wrap
+		static constexpr int TableSize = 1 << 11;
+
+		inline std::shared_ptr<std::vector<double>> makeTable(int size, int seed)
+		{
+			auto table = std::make_shared<std::vector<double>>(static_cast<size_t>(size));
+			juce::Random rand(seed);
+			for (auto& v : *table)
+				v = rand.nextDouble() * 2. - 1.;
+			return table;
+		}
+
+		/* smpls, size, maps [-1,1] to read positions in [0, size) */
+		inline std::shared_ptr<std::vector<double>> makePositions(const double* smpls, double size)
+		{
+			auto positions = std::make_shared<std::vector<double>>(static_cast<size_t>(NumSamples));
+			for (auto s = 0; s < NumSamples; ++s)
+			{
+				auto x = (smpls[s] * .5 + .5) * size;
+				if (x >= size)
+					x -= size;
+				(*positions)[s] = x;
+			}
+			return positions;
+		}
+
+		// INTERPOLATION
+
+		inline Kernel lerp(const AudioBufferD& input)
+		{
+			const auto table = makeTable(TableSize, 69);
+			const auto positions = makePositions(input.getReadPointer(0), static_cast<double>(TableSize));
+
+			return
+			{
+				"interpolation::lerp", ulps(8), 1, false,
+				[](int) {},
+				[table, positions](double* const* samples, int s, int numSamples)
+				{
+					for (auto i = 0; i < numSamples; ++i)
+						samples[0][i] = interpolation::lerp(table->data(), (*positions)[s + i], TableSize);
+				},
+				[table, positions](double* const* samples, int s, int numSamples)
+				{
+					for (auto i = 0; i < numSamples; ++i)
+					{
+						const auto x = static_cast<Real>((*positions)[s + i]);
+						const auto i0 = static_cast<int>(std::floor(x));
+						const auto t = x - static_cast<Real>(i0);
+						const auto v0 = static_cast<Real>((*table)[i0]);
+						const auto v1 = static_cast<Real>((*table)[(i0 + 1) % TableSize]);
+						samples[0][i] = static_cast<double>((1.L - t) * v0 + t * v1);
+					}
+				}
+			};
+		}
+
+		inline Kernel cubicHermiteSpline(const AudioBufferD& input)
+		{
+			const auto table = makeTable(TableSize, 69);
+			const auto positions = makePositions(input.getReadPointer(0), static_cast<double>(TableSize));
+
+			return
+			{
+				"interpolation::cubicHermiteSpline", ulps(32), 1, false,
+				[](int) {},
+				[table, positions](double* const* samples, int s, int numSamples)
+				{
+					for (auto i = 0; i < numSamples; ++i)
+						samples[0][i] = interpolation::cubicHermiteSpline(table->data(), (*positions)[s + i], TableSize);
+				},
+				[table, positions](double* const* samples, int s, int numSamples)
+				{
+					const auto at = [&](int idx)
+					{
+						return static_cast<Real>((*table)[(idx + TableSize) % TableSize]);
+					};
+					for (auto i = 0; i < numSamples; ++i)
+					{
+						const auto x = static_cast<Real>((*positions)[s + i]);
+						const auto i1 = static_cast<int>(std::floor(x));
+						const auto t = x - static_cast<Real>(i1);
+						const auto v0 = at(i1 - 1), v1 = at(i1), v2 = at(i1 + 1), v3 = at(i1 + 2);
+						// catmull-rom, term by term
+						const auto y = v1
+							+ t * .5L * (v2 - v0)
+							+ t * t * (v0 - 2.5L * v1 + 2.L * v2 - .5L * v3)
+							+ t * t * t * (1.5L * (v1 - v2) + .5L * (v3 - v0));
+						samples[0][i] = static_cast<double>(y);
+					}
+				}
+			};
+		}
+
+		// SMOOTHING
+
+		inline Kernel lowpass(const AudioBufferD& input)
+		{
+			using Lowpass = smooth::Lowpass<double, false>;
+			struct State
+			{
+				Lowpass lp;
+				Real y1 = 0.L;
+			};
+			auto state = std::make_shared<State>();
+
+			return
+			{
+				"smooth::Lowpass", db(-260.), NumChannels, false,
+				[state](int)
+				{
+					state->lp = Lowpass();
+					state->lp.makeFromDecayInMs(5., SampleRate);
+					state->y1 = 0.L;
+				},
+				[state, &input](double* const* samples, int s, int numSamples)
+				{
+					// one filter for both channels, the way a parameter smoother runs over consecutive blocks
+					for (auto ch = 0; ch < NumChannels; ++ch)
+					{
+						std::memcpy(samples[ch], input.getReadPointer(ch, s), sizeof(double) * static_cast<size_t>(numSamples));
+						state->lp(samples[ch], numSamples);
+					}
+				},
+				[state, &input](double* const* samples, int s, int numSamples)
+				{
+					const auto a0 = static_cast<Real>(state->lp.a0);
+					const auto b1 = static_cast<Real>(state->lp.b1);
+					for (auto ch = 0; ch < NumChannels; ++ch)
+					{
+						const auto smpls = input.getReadPointer(ch, s);
+						for (auto i = 0; i < numSamples; ++i)
+						{
+							state->y1 = static_cast<Real>(smpls[i]) * a0 + state->y1 * b1;
+							samples[ch][i] = static_cast<double>(state->y1);
+						}
+					}
+				}
+			};
+		}
+
+		inline Kernel smoother(const AudioBufferD& input)
+		{
+			// a parameter that jumps every few blocks and glides to each value
+			static constexpr int StepLength = 1000;
+			static constexpr double SmoothMs = 20.;
+			struct State
+			{
+				std::unique_ptr<smooth::Smooth<double>> smooth;
+				smooth::Lowpass<double, false> lp;
+				Real cur = 0.L, y1 = 0.L;
+			};
+			auto state = std::make_shared<State>();
+			const auto getDest = [&input](int s)
+			{
+				return input.getSample(0, s / StepLength * StepLength);
+			};
+
+			return
+			{
+				"smooth::Smooth", db(-230.), 1, false,
+				[state](int)
+				{
+					state->smooth = std::make_unique<smooth::Smooth<double>>();
+					state->smooth->makeFromDecayInMs(SmoothMs, SampleRate);
+					state->lp.makeFromDecayInMs(SmoothMs, SampleRate);
+					state->cur = state->y1 = 0.L;
+				},
+				[state, getDest](double* const* samples, int s, int numSamples)
+				{
+					const auto dest = getDest(s);
+					if (!(*state->smooth)(samples[0], dest, numSamples))
+						std::fill(samples[0], samples[0] + numSamples, dest);
+				},
+				[state, getDest](double* const* samples, int s, int numSamples)
+				{
+					// a linear ramp over the block, followed by the lowpass
+					const auto dest = static_cast<Real>(getDest(s));
+					const auto a0 = static_cast<Real>(state->lp.a0);
+					const auto b1 = static_cast<Real>(state->lp.b1);
+					const auto start = state->cur;
+					for (auto i = 0; i < numSamples; ++i)
+					{
+						const auto ramp = start + (dest - start) * static_cast<Real>(i) / static_cast<Real>(numSamples);
+						state->y1 = ramp * a0 + state->y1 * b1;
+						samples[0][i] = static_cast<double>(state->y1);
+					}
+					state->cur = dest;
+				}
+			};
+		}
+
+		// WAVETABLES
+
+		inline Kernel wavetable2D(const AudioBufferD& input)
+		{
+			static constexpr size_t NumTables = 8;
+			using Wavetable = dsp::Wavetable2D<double, TableSize, NumTables>;
+			auto wavetable = std::make_shared<Wavetable>();
+			for (auto t = 0; t < static_cast<int>(NumTables); ++t)
+				wavetable->fill([t](double x)
+				{
+					return std::sin(dsp::Pi * x * static_cast<double>(t + 1)) * (1. - .1 * static_cast<double>(t));
+				}, t, false, false);
+			wavetable->finishFills();
+
+			// both phases in [0, 1)
+			const auto tablesPhases = makePositions(input.getReadPointer(0), 1.);
+			const auto tablePhases = makePositions(input.getReadPointer(1), 1.);
+
+			return
+			{
+				"dsp::Wavetable2D", ulps(32), 1, false,
+				[](int) {},
+				[wavetable, tablesPhases, tablePhases](double* const* samples, int s, int numSamples)
+				{
+					const auto& wt = *wavetable;
+					for (auto i = 0; i < numSamples; ++i)
+						samples[0][i] = wt((*tablesPhases)[s + i], (*tablePhases)[s + i]);
+				},
+				[wavetable, tablesPhases, tablePhases](double* const* samples, int s, int numSamples)
+				{
+					const auto& wt = *wavetable;
+					const auto at = [&](int table, int idx)
+					{
+						return static_cast<Real>(wt(table % static_cast<int>(NumTables), idx % TableSize));
+					};
+					for (auto i = 0; i < numSamples; ++i)
+					{
+						const auto x = static_cast<Real>((*tablesPhases)[s + i]) * static_cast<Real>(NumTables - 1);
+						const auto y = static_cast<Real>((*tablePhases)[s + i]) * static_cast<Real>(TableSize);
+						const auto x0 = static_cast<int>(std::floor(x));
+						const auto y0 = static_cast<int>(std::floor(y));
+						const auto tx = x - static_cast<Real>(x0);
+						const auto ty = y - static_cast<Real>(y0);
+						const auto v0 = (1.L - ty) * at(x0, y0) + ty * at(x0, y0 + 1);
+						const auto v1 = (1.L - ty) * at(x0 + 1, y0) + ty * at(x0 + 1, y0 + 1);
+						samples[0][i] = static_cast<double>((1.L - tx) * v0 + tx * v1);
+					}
+				}
+			};
+		}
+
+		// MODULATORS
+
+		inline Kernel perlin()
+		{
+			using Perlin = perlin2::Perlin;
+			static constexpr double RateHz = 40.;
+			// the fractional octave is faded in, so both paths of the octave sum run
+			static constexpr double Octaves = 4.5;
+			struct State
+			{
+				Perlin perlin;
+				Perlin::NoiseArray noise;
+				Perlin::GainBuffer gains;
+				Real phase = 0.L;
+				int noiseIdx = 0;
+			};
+			auto state = std::make_shared<State>();
+			perlin2::generateProceduralNoise(state->noise.data(), Perlin::NoiseSize, 420);
+			for (auto s = 0; s < Perlin::NoiseOvershoot; ++s)
+				state->noise[Perlin::NoiseSize + s] = state->noise[s];
+			for (auto o = 0; o < static_cast<int>(state->gains.size()); ++o)
+				state->gains[o] = 1. / static_cast<double>(1 << o);
+
+			return
+			{
+				"perlin2::Perlin", ulps(32), 1, false,
+				[state](int blockSize)
+				{
+					state->perlin.prepare(SampleRate, blockSize);
+					state->perlin.updatePosition(0.);
+					state->perlin.updateSpeed(RateHz / SampleRate);
+					state->phase = 0.L;
+					state->noiseIdx = 0;
+				},
+				[state](double* const* samples, int, int numSamples)
+				{
+					const dsp::PRMInfoD octaves(nullptr, Octaves, false), phs(nullptr, 0., false), width(nullptr, 0., false);
+					state->perlin(samples, state->noise.data(), state->gains.data(), octaves, phs, width,
+						Perlin::Shape::Spline, 1, numSamples);
+				},
+				[state](double* const* samples, int, int numSamples)
+				{
+					const auto inc = RateHz / SampleRate;
+					const auto octFloor = static_cast<int>(Octaves);
+					const auto octFrac = static_cast<Real>(Octaves) - static_cast<Real>(octFloor);
+					// the noise is read from its 2nd sample on, so that the spline has one before it
+					const auto spline = [&](Real x)
+					{
+						const auto i = static_cast<int>(std::floor(x));
+						const auto t = x - static_cast<Real>(i);
+						const auto v0 = static_cast<Real>(state->noise[i]), v1 = static_cast<Real>(state->noise[i + 1]);
+						const auto v2 = static_cast<Real>(state->noise[i + 2]), v3 = static_cast<Real>(state->noise[i + 3]);
+						return v1
+							+ t * .5L * (v2 - v0)
+							+ t * t * (v0 - 2.5L * v1 + 2.L * v2 - .5L * v3)
+							+ t * t * t * (1.5L * (v1 - v2) + .5L * (v3 - v0));
+					};
+					const auto octave = [&](Real phase, int o)
+					{
+						const auto x = phase * static_cast<Real>(1 << o);
+						const auto xFloor = std::floor(x);
+						const auto idx = static_cast<int>(xFloor) & Perlin::NoiseSizeMax;
+						return spline(x - xFloor + static_cast<Real>(idx));
+					};
+
+					for (auto i = 0; i < numSamples; ++i)
+					{
+						auto phase = static_cast<double>(state->phase) + inc;
+						if (phase >= 1.)
+						{
+							--phase;
+							state->noiseIdx = (state->noiseIdx + 1) & Perlin::NoiseSizeMax;
+						}
+						state->phase = phase;
+						// the phase buffer is double precision, like the modulator's
+						const auto x = static_cast<Real>(phase + static_cast<double>(state->noiseIdx));
+
+						auto sum = 0.L, gain = 0.L;
+						for (auto o = 0; o < octFloor; ++o)
+						{
+							sum += octave(x, o) * static_cast<Real>(state->gains[o]);
+							gain += static_cast<Real>(state->gains[o]);
+						}
+						sum += octFrac * octave(x, octFloor) * static_cast<Real>(state->gains[octFloor]);
+						gain += octFrac * static_cast<Real>(state->gains[octFloor]);
+						samples[0][i] = static_cast<double>(sum / std::sqrt(gain));
+					}
+				}
+			};
+		}
+
+		inline Kernel envelopeFollower(const AudioBufferD& input)
+		{
+			using EnvFol = envfol::EnvFol;
+			using PRM = dsp::PRMD;
+			// the attack changes halfway, so the parameter smoothing is part of the comparison
+			static constexpr double ReleaseMs = 200., GainDb = 6., Width = .7, CutoffHz = 80.;
+			static constexpr double SmoothMs = 20.;
+			const auto getAttackMs = [](int s)
+			{
+				return s < NumSamples / 2 ? 20. : 5.;
+			};
+
+			// the parameters are smoothed by the same PRMs, everything else is done sample by sample
+			struct Reference
+			{
+				Reference() :
+					atkPRM(1.), rlsPRM(1.), gainPRM(0.), widthPRM(0.), hpPRM(1.),
+					envelope(), hpY1(), smoothY1(), hpA0(1.L), hpB1(0.L)
+				{}
+
+				PRM atkPRM, rlsPRM, gainPRM, widthPRM, hpPRM;
+				std::array<Real, NumChannels> envelope, hpY1, smoothY1;
+				Real hpA0, hpB1;
+			};
+
+			struct State
+			{
+				std::unique_ptr<EnvFol> envFol;
+				std::unique_ptr<Reference> ref;
+			};
+			auto state = std::make_shared<State>();
+
+			return
+			{
+				"envfol::EnvFol", db(-250.), NumChannels, false,
+				[state](int blockSize)
+				{
+					state->envFol = std::make_unique<EnvFol>();
+					state->envFol->prepare(SampleRate, blockSize);
+					state->ref = std::make_unique<Reference>();
+					auto& ref = *state->ref;
+					ref.atkPRM.prepare(SampleRate, blockSize, 10.);
+					ref.rlsPRM.prepare(SampleRate, blockSize, 10.);
+					ref.gainPRM.prepare(SampleRate, blockSize, 10.);
+					ref.widthPRM.prepare(SampleRate, blockSize, 10.);
+					ref.hpPRM.prepare(SampleRate, blockSize, 10.);
+				},
+				[state, &input, getAttackMs](double* const* samples, int s, int numSamples)
+				{
+					for (auto ch = 0; ch < NumChannels; ++ch)
+						std::memcpy(samples[ch], input.getReadPointer(ch, s), sizeof(double) * static_cast<size_t>(numSamples));
+					(*state->envFol)(samples, nullptr, getAttackMs(s), ReleaseMs, GainDb, Width, CutoffHz,
+						NumChannels, numSamples, false);
+				},
+				[state, &input, getAttackMs](double* const* samples, int s, int numSamples)
+				{
+					auto& ref = *state->ref;
+					const auto getValue = [](const dsp::PRMInfoD& info, int i)
+					{
+						return static_cast<Real>(info.smoothing ? info.buf[i] : info.val);
+					};
+					const auto atkInfo = ref.atkPRM(1. / (getAttackMs(s) * .001 * SampleRate), numSamples);
+					const auto rlsInfo = ref.rlsPRM(1. / (ReleaseMs * .001 * SampleRate), numSamples);
+					const auto gainInfo = ref.gainPRM(std::pow(10., GainDb * .05), numSamples);
+					const auto widthInfo = ref.widthPRM(Width, numSamples);
+					const auto hpInfo = ref.hpPRM(CutoffHz / SampleRate, numSamples);
+					const auto smoothX = static_cast<Real>(std::exp(-1. / (SmoothMs * .001 * SampleRate)));
+
+					for (auto i = 0; i < numSamples; ++i)
+					{
+						// the highpass keeps its last cutoff once it stopped smoothing
+						if (hpInfo.smoothing)
+						{
+							const auto x = static_cast<Real>(envfol::LowpassGain::getXFromFc(hpInfo.buf[i]));
+							ref.hpA0 = 1.L - x;
+							ref.hpB1 = x * (1.L - ref.hpA0);
+						}
+						const auto atk = getValue(atkInfo, i);
+						const auto rls = getValue(rlsInfo, i);
+						const auto gain = getValue(gainInfo, i) * (1.L + std::sqrt(rls / atk));
+
+						std::array<Real, NumChannels> env;
+						for (auto ch = 0; ch < NumChannels; ++ch)
+						{
+							const auto x = static_cast<Real>(input.getSample(ch, s + i));
+							ref.hpY1[ch] = x * ref.hpA0 + ref.hpY1[ch] * ref.hpB1;
+							const auto hp = x - ref.hpY1[ch];
+							const auto target = gain * hp * hp;
+							auto& e = ref.envelope[ch];
+							e += (e < target ? atk : rls) * (target - e);
+							env[ch] = e * gain;
+						}
+						env[1] = env[0] + getValue(widthInfo, i) * (env[1] - env[0]);
+
+						for (auto ch = 0; ch < NumChannels; ++ch)
+						{
+							auto& y1 = ref.smoothY1[ch];
+							y1 = std::min(env[ch], 1.L) * (1.L - smoothX) + y1 * smoothX;
+							samples[ch][i] = static_cast<double>(2.L * y1 - 1.L);
+						}
+					}
+				}
+			};
+		}
+
+		// DELAYS
+
+		/* pair, runs the channels side by side instead of one after the other */
+		inline Kernel vibratoDelay(const AudioBufferD& input, bool pair)
+		{
+			using Delay = vibrato::Delay;
+			using LP = vibrato::LP;
+			static constexpr double Feedback = .6, DampFc = .1, RateHz = 5.;
+			const auto size = [&]()
+			{
+				auto s = static_cast<int>(std::round(SampleRate * .004));
+				return s + s % 2;
+			}();
+
+			struct State
+			{
+				std::unique_ptr<Delay> delay;
+				std::unique_ptr<dsp::WHead> wHead;
+				std::vector<double> fbBuf, dampBuf;
+				std::array<std::vector<double>, NumChannels> vib, mod;
+				std::array<std::vector<Real>, NumChannels> ring;
+				std::array<Real, NumChannels> y1;
+				int w = 0;
+			};
+			auto state = std::make_shared<State>();
+			for (auto ch = 0; ch < NumChannels; ++ch)
+			{
+				// the channels are modulated apart, so that their read heads differ
+				auto& mod = state->mod[ch];
+				mod.resize(NumSamples);
+				for (auto s = 0; s < NumSamples; ++s)
+					mod[s] = .9 * std::sin(Tau * RateHz * static_cast<double>(s) / SampleRate + static_cast<double>(ch));
+			}
+
+			return
+			{
+				pair ? "vibrato::Delay pair" : "vibrato::Delay", db(-230.), NumChannels, false,
+				[state, size](int blockSize)
+				{
+					state->delay = std::make_unique<Delay>();
+					state->delay->prepare(size, NumChannels);
+					state->delay->reset();
+					state->wHead = std::make_unique<dsp::WHead>();
+					state->wHead->prepare(blockSize, size);
+					state->fbBuf.assign(blockSize, Feedback);
+					state->dampBuf.assign(blockSize, DampFc);
+					for (auto ch = 0; ch < NumChannels; ++ch)
+					{
+						state->vib[ch].resize(blockSize);
+						state->ring[ch].assign(size, 0.L);
+						state->y1[ch] = 0.L;
+					}
+					state->w = 0;
+				},
+				[state, &input, pair](double* const* samples, int s, int numSamples)
+				{
+					std::array<double*, NumChannels> vib;
+					for (auto ch = 0; ch < NumChannels; ++ch)
+					{
+						std::memcpy(samples[ch], input.getReadPointer(ch, s), sizeof(double) * static_cast<size_t>(numSamples));
+						// the delay turns the modulation into read heads in place
+						std::memcpy(state->vib[ch].data(), state->mod[ch].data() + s, sizeof(double) * static_cast<size_t>(numSamples));
+						vib[ch] = state->vib[ch].data();
+					}
+					(*state->wHead)(numSamples);
+					// the cutoff is updated every sample, like while the damping parameter moves
+					const dsp::PRMInfoD dampInfo(state->dampBuf.data(), DampFc, true);
+					if (pair)
+						state->delay->processPair(samples[0], samples[1], 0, numSamples, vib[0], vib[1],
+							state->wHead->data(), state->fbBuf.data(), dampInfo, vibrato::InterpolationType::Spline);
+					else
+						(*state->delay)(samples, NumChannels, numSamples, vib.data(), state->wHead->data(),
+							state->fbBuf.data(), dampInfo, vibrato::InterpolationType::Spline);
+				},
+				[state, &input, size](double* const* samples, int s, int numSamples)
+				{
+					const auto sizeR = static_cast<Real>(size);
+					const auto delayMax = sizeR - 4.L;
+					const auto x = static_cast<Real>(LP::getXFromFc(DampFc));
+					const auto a0 = 1.L - x;
+					const auto b1 = x * (1.L - a0);
+					const auto waveshape = [](Real v)
+					{
+						return -.405548L * v * v * v + 1.34908L * v;
+					};
+
+					for (auto i = 0; i < numSamples; ++i)
+					{
+						const auto w = state->w;
+						for (auto ch = 0; ch < NumChannels; ++ch)
+						{
+							const auto& ring = state->ring[ch];
+							const auto at = [&](int idx)
+							{
+								return ring[(idx + size) % size];
+							};
+							auto r = static_cast<Real>(w) - (static_cast<Real>(state->mod[ch][s + i]) * delayMax + sizeR) * .5L;
+							if (r < 0.L)
+								r += sizeR;
+							const auto i1 = static_cast<int>(std::floor(r));
+							const auto t = r - static_cast<Real>(i1);
+							const auto v0 = at(i1 - 1), v1 = at(i1), v2 = at(i1 + 1), v3 = at(i1 + 2);
+							const auto sOut = v1
+								+ t * .5L * (v2 - v0)
+								+ t * t * (v0 - 2.5L * v1 + 2.L * v2 - .5L * v3)
+								+ t * t * t * (1.5L * (v1 - v2) + .5L * (v3 - v0));
+
+							auto& y1 = state->y1[ch];
+							y1 = sOut * a0 + y1 * b1;
+							state->ring[ch][w] = static_cast<Real>(input.getSample(ch, s + i)) + waveshape(-Feedback * y1);
+							samples[ch][i] = static_cast<double>(sOut);
+						}
+						state->w = (w + 1) % size;
+					}
+				}
+			};
+		}
+
+		inline Kernel ffDelay(const AudioBufferD& input)
+		{
+			using FFDelay = drywet::FFDelay;
+			// the latency of the wet signal the dry one is delayed by
+			static constexpr int Size = 97;
+			auto delay = std::make_shared<std::unique_ptr<FFDelay>>();
+
+			return
+			{
+				"drywet::FFDelay", ulps(0), NumChannels, false,
+				[delay](int blockSize)
+				{
+					*delay = std::make_unique<FFDelay>();
+					(*delay)->prepare(blockSize, Size, NumChannels);
+				},
+				[delay, &input](double* const* samples, int s, int numSamples)
+				{
+					std::array<const double*, NumChannels> src;
+					for (auto ch = 0; ch < NumChannels; ++ch)
+						src[ch] = input.getReadPointer(ch, s);
+					(**delay)(samples, src.data(), NumChannels, numSamples);
+				},
+				[&input](double* const* samples, int s, int numSamples)
+				{
+					// the read head is one sample ahead of the write head
+					for (auto ch = 0; ch < NumChannels; ++ch)
+						for (auto i = 0; i < numSamples; ++i)
+						{
+							const auto idx = s + i - (Size - 1);
+							samples[ch][i] = idx >= 0 ? input.getSample(ch, idx) : 0.;
+						}
+				}
+			};
+		}
+
+		// OVERSAMPLING
+
+		/* upsampling, the 4x filters of the oversampler */
+		inline Kernel convolutionFilter(const AudioBufferD& input, bool upsampling)
+		{
+			using Filter = oversampling::ConvolutionFilter<double>;
+			static constexpr double Fs = 176400., Cutoff = 22050., Bandwidth = 44100.;
+			auto filter = std::make_shared<Filter>(Fs, Cutoff, Bandwidth, upsampling);
+			const auto ir = oversampling::makeSincFilter2(Fs, Cutoff, Bandwidth, upsampling).data;
+
+			return
+			{
+				upsampling ? "oversampling::ConvolutionFilter up" : "oversampling::ConvolutionFilter down",
+				ulps(16), NumChannels, false,
+				[filter](int)
+				{
+					filter->prepare(NumChannels);
+				},
+				[filter, &input, upsampling](double* const* samples, int s, int numSamples)
+				{
+					for (auto ch = 0; ch < NumChannels; ++ch)
+						std::memcpy(samples[ch], input.getReadPointer(ch, s), sizeof(double) * static_cast<size_t>(numSamples));
+					if (upsampling)
+						filter->processBlockUp(samples, NumChannels, numSamples);
+					else
+						filter->processBlockDown(samples, NumChannels, numSamples);
+				},
+				[ir, &input, upsampling](double* const* samples, int s, int numSamples)
+				{
+					// a direct fir. upsampling reads only the even samples, the others are the zeros stuffed in between
+					const auto irSize = static_cast<int>(ir.size());
+					for (auto ch = 0; ch < NumChannels; ++ch)
+						for (auto i = 0; i < numSamples; ++i)
+						{
+							const auto n = s + i;
+							auto y = 0.L;
+							for (auto k = 0; k < irSize && k <= n; ++k)
+								if (!upsampling || (n - k) % 2 == 0)
+									y += static_cast<Real>(ir[k]) * static_cast<Real>(input.getSample(ch, n - k));
+							samples[ch][i] = static_cast<double>(y);
+						}
+				}
+			};
+		}
+
+		/* the 2x filter of the oversampler, its channels run as a pair */
+		inline Kernel chebyshevFilter(const AudioBufferD& input)
+		{
+			using Filter = oversampling::LowkeyChebyshevFilter<double>;
+
+			// the same coefficients in direct form I
+			struct Reference :
+				public oversampling::IIR<double>
+			{
+				Reference() :
+					IIR<double>(),
+					x(),
+					y()
+				{
+					makeChebyshev_lp_4pole_fc45_ripl5();
+					for (auto ch = 0; ch < NumChannels; ++ch)
+					{
+						x[ch].fill(0.L);
+						y[ch].fill(0.L);
+					}
+				}
+
+				double operator()(double sample, int ch) noexcept
+				{
+					auto& xs = x[ch];
+					auto& ys = y[ch];
+					const auto x0 = static_cast<Real>(sample);
+					const auto y0 = static_cast<Real>(a0) * x0
+						+ static_cast<Real>(a1) * xs[0] + static_cast<Real>(a2) * xs[1]
+						+ static_cast<Real>(a3) * xs[2] + static_cast<Real>(a4) * xs[3]
+						+ static_cast<Real>(b1) * ys[0] + static_cast<Real>(b2) * ys[1]
+						+ static_cast<Real>(b3) * ys[2] + static_cast<Real>(b4) * ys[3];
+					for (auto i = 3; i > 0; --i)
+					{
+						xs[i] = xs[i - 1];
+						ys[i] = ys[i - 1];
+					}
+					xs[0] = x0;
+					ys[0] = y0;
+					return static_cast<double>(y0);
+				}
+
+				std::array<std::array<Real, 4>, NumChannels> x, y;
+			};
+
+			struct State
+			{
+				Filter filter;
+				std::unique_ptr<Reference> ref;
+			};
+			auto state = std::make_shared<State>();
+
+			return
+			{
+				"oversampling::LowkeyChebyshevFilter", db(-240.), NumChannels, false,
+				[state](int)
+				{
+					state->filter.prepare(NumChannels);
+					state->ref = std::make_unique<Reference>();
+				},
+				[state, &input](double* const* samples, int s, int numSamples)
+				{
+					for (auto ch = 0; ch < NumChannels; ++ch)
+						std::memcpy(samples[ch], input.getReadPointer(ch, s), sizeof(double) * static_cast<size_t>(numSamples));
+					state->filter.processBlock(samples, NumChannels, numSamples);
+				},
+				[state, &input](double* const* samples, int s, int numSamples)
+				{
+					for (auto ch = 0; ch < NumChannels; ++ch)
+						for (auto i = 0; i < numSamples; ++i)
+							samples[ch][i] = (*state->ref)(input.getSample(ch, s + i), ch);
+				}
+			};
+		}
+
+		// FORMULAS
+
+		inline Kernel formulaParser(const AudioBufferD& input)
+		{
+			auto parser = std::make_shared<fx::Parser>();
+			const auto parsed = (*parser)("sin(x * pi) * 0.5 + x ^ 2");
+
+			return
+			{
+				"fx::Parser", ulps(16), 1, true,
+				[](int) {},
+				[parser, parsed, &input](double* const* samples, int s, int numSamples)
+				{
+					for (auto i = 0; i < numSamples; ++i)
+						samples[0][i] = parsed ? static_cast<double>((*parser)(static_cast<float>(input.getSample(0, s + i)))) : 0.;
+				},
+				[&input](double* const* samples, int s, int numSamples)
+				{
+					for (auto i = 0; i < numSamples; ++i)
+					{
+						const auto x = static_cast<float>(input.getSample(0, s + i));
+						samples[0][i] = static_cast<double>(std::sin(x * 3.14159265359f) * .5f + std::pow(x, 2.f));
+					}
+				}
+			};
+		}
+	}
+
+	namespace kernel
+	{
+		// LAYOUTS
+
+		/* layout, input, log. spreads two modulator edges across a surround layout and checks every channel
+		against where its speaker sits: the left ones on the first edge, the right ones on the last, the lfe unmodulated */
+		inline bool spreadLayout(const juce::AudioChannelSet& layout, const AudioBufferD& input, const std::function<void(const String&)>& log)
+		{
+			using Type = juce::AudioChannelSet::ChannelType;
+			const auto numChannels = layout.size();
+			dsp::ChannelPositions positions;
+			dsp::makePositions(positions, layout);
+
+			AudioBufferD buffer(numChannels, NumSamples);
+			std::vector<double> depth(NumSamples, .7);
+			buffer.clear();
+			buffer.copyFrom(0, 0, input, 0, 0, NumSamples);
+			buffer.copyFrom(numChannels - 1, 0, input, 1, 0, NumSamples);
+			dsp::spread(buffer.getArrayOfWritePointers(), positions, numChannels, NumSamples, depth.data());
+
+			auto maxErr = 0.;
+			for (auto ch = 0; ch < numChannels; ++ch)
+			{
+				const auto type = layout.getTypeOfChannel(ch);
+				const auto isLFE = type == Type::LFE || type == Type::LFE2;
+				const auto x = dsp::getPosition(type, 0.);
+				const auto smpls = buffer.getReadPointer(ch);
+				for (auto s = 0; s < NumSamples; ++s)
+				{
+					const auto first = input.getSample(0, s);
+					const auto last = input.getSample(1, s);
+					const auto expected = isLFE ? depth[s] - 1. : first + x * (last - first);
+					maxErr = std::max(maxErr, std::abs(smpls[s] - expected));
+				}
+			}
+
+			const auto passed = maxErr < 1e-12;
+			log("dsp::spread " + layout.getDescription() + ": " + String(maxErr) + " max error" + (passed ? ", passed" : ", FAILED"));
+			return passed;
+		}
+	}
+
+	/* runs every dsp kernel at every block size of kernel::BlockSizes and checks it against its reference.
+	logs the error and the time per sample of each, returns the number of kernels that failed */
+	inline int kernels(const std::function<void(const String&)>& log)
+	{
+		using namespace kernel;
+		AudioBufferD input(NumChannels, NumSamples), output(NumChannels, NumSamples), reference(NumChannels, NumSamples);
+		juce::Random rand(420);
+		for (auto ch = 0; ch < NumChannels; ++ch)
+		{
+			auto smpls = input.getWritePointer(ch);
+			for (auto s = 0; s < NumSamples; ++s)
+				smpls[s] = rand.nextDouble() * 2. - 1.;
+		}
+
+		std::vector<Kernel> list
+		{
+			lerp(input),
+			cubicHermiteSpline(input),
+			lowpass(input),
+			smoother(input),
+			wavetable2D(input),
+			perlin(),
+			envelopeFollower(input),
+			vibratoDelay(input, false),
+			vibratoDelay(input, true),
+			ffDelay(input),
+			convolutionFilter(input, false),
+			convolutionFilter(input, true),
+			chebyshevFilter(input),
+			formulaParser(input)
+		};
+
+		log(String(NumSamples) + " samples per block size, instruction set: " + simd::toString(simd::getISA()) + "\n");
+		auto numFailed = 0;
+		for (auto& k : list)
+			if (!run(k, output, reference, log))
+				++numFailed;
+
+		const juce::AudioChannelSet layouts[] =
+		{
+			juce::AudioChannelSet::create5point1(),
+			juce::AudioChannelSet::create7point1(),
+			juce::AudioChannelSet::create7point1point4()
+		};
+		for (const auto& layout : layouts)
+			if (!spreadLayout(layout, input, log))
+				++numFailed;
+		const auto numKernels = static_cast<int>(list.size() + std::size(layouts));
+		log("\n" + String(numKernels - numFailed) + " of " + String(numKernels) + " kernels passed");
+		return numFailed;
+	}
+}
@@ -1,6 +1,12 @@
 #pragma once
 #include <JuceHeader.h>
 #include <chrono>
+#include <functional>
+#include <vector>
+#include <thread>
+#include "dsp/AllpassVibrato.h"
+#include "dsp/ForkJoin.h"
+#include "dsp/RealtimeSanitizer.h"
 
 namespace benchmark
 {
@@ -79,22 +85,34 @@ namespace benchmark
 		Duration timeStart;
 	};
 
+	/* id, the file a benchmark logs its results to.
+	in the Benchmark2 folder on the desktop, named after the build time and the benchmark */
+	inline File getLog(const String& id)
+	{
+		const auto time = String(__TIME__).replaceCharacter(':', '_');
+		const auto name = time + (id.isEmpty() ? String() : "_" + id) + "_log.txt";
+		const auto desktop = SpecialLoc::userDesktopDirectory;
+		return File::getSpecialLocation(desktop).getChildFile("Benchmark2").getChildFile(name);
+	}
+
+	/* id, replaces the benchmark's last log with an empty one */
+	inline File createLog(const String& id)
+	{
+		const auto file = getLog(id);
+		file.getParentDirectory().createDirectory();
+		if (file.exists())
+			file.deleteFile();
+		file.create();
+		return file;
+	}
+
 	inline void processBlock(AudioProcessor& p, int numIterations = 1024, int numChannels = 2, int blockSize = 512)
 	{
 		AtomicDuration duration;
 		AudioBuffer buffer(numChannels, blockSize);
 		MidiBuffer midi;
 
-		const String name(String(__TIME__).replaceCharacter(':', '_') + "_log.txt");
-
-		const auto desktop = SpecialLoc::userDesktopDirectory;
-		const auto folder = File::getSpecialLocation(desktop).getChildFile("Benchmark2");
-		if (!folder.exists())
-			folder.createDirectory();
-		const auto file = folder.getChildFile(name);
-		if (file.exists())
-			file.deleteFile();
-		file.create();
+		const auto file = createLog("");
 
 		auto min = std::numeric_limits<long long>::max();
 		auto max = std::numeric_limits<long long>::min();
@@ -124,6 +142,268 @@ namespace benchmark
 		file.appendText("\navg: " + String(avg));
 	}
 
+	/* processes blocks like a realtime host would and logs the violations the sanitizer reports.
+	returns false if there was any. the processor has to be prepared already.
+	onBlock(blockIdx) runs before every block, f.ex. to switch presets while the audio keeps running.
+	needs a build with NEL_REALTIME_SANITIZER, everything passes otherwise */
+	inline bool realtimeSafety(AudioProcessor& p, int numIterations = 1024, int numChannels = 2, int blockSize = 512,
+		const std::function<void(int)>& onBlock = nullptr, const String& id = "realtime")
+	{
+		AudioBuffer buffer(numChannels, blockSize);
+		MidiBuffer midi;
+		juce::Random rand(420);
+
+		const auto file = createLog(id);
+
+		p.setNonRealtime(false);
+		dsp::realtime::resetViolations();
+		auto numBlocksViolating = 0;
+
+		for (auto i = 0; i < numIterations; ++i)
+		{
+			for (auto ch = 0; ch < numChannels; ++ch)
+			{
+				auto smpls = buffer.getWritePointer(ch);
+				for (auto s = 0; s < blockSize; ++s)
+					smpls[s] = rand.nextFloat() * 2.f - 1.f;
+			}
+
+			if (onBlock != nullptr)
+				onBlock(i);
+			const auto numViolations = dsp::realtime::getNumViolations();
+			p.processBlock(buffer, midi);
+			if (dsp::realtime::getNumViolations() != numViolations)
+			{
+				file.appendText("block " + String(i) + ": " + String(dsp::realtime::getNumViolations() - numViolations) + "\n");
+				++numBlocksViolating;
+			}
+		}
+
+		const auto numViolations = dsp::realtime::getNumViolations();
+		file.appendText("\nblocks: " + String(numIterations));
+		file.appendText("\nblocks violating: " + String(numBlocksViolating));
+		file.appendText("\nviolations: " + String(numViolations));
+		file.appendText(NEL_REALTIME_SANITIZER ? "" : "\n(sanitizer disabled)");
+		jassert(numViolations == 0); // see stderr for the stacks
+		return numViolations == 0;
+	}
+
+	/* measures construction and destruction of plugin instances, like a host scanning or loading a project would.
+	the first instance is logged separately, because it pays for the process-wide caches.
+	returns false if the warm instances took longer than maxAvgMs on average */
+	inline bool instantiation(const std::function<AudioProcessor*()>& create, double maxAvgMs = 10., int numInstances = 64)
+	{
+		AtomicDuration duration;
+
+		const auto file = createLog("instantiation");
+
+		auto min = std::numeric_limits<long long>::max();
+		auto max = std::numeric_limits<long long>::min();
+		long long sum = 0;
+
+		for (auto i = 0; i < numInstances; ++i)
+		{
+			{
+				Measure measure(duration);
+				std::unique_ptr<AudioProcessor> p(create());
+			}
+
+			const auto time = std::chrono::duration_cast<Micro>(duration.load()).count();
+
+			if (i == 0)
+			{
+				file.appendText("cold: " + String(time) + "\n\n");
+				continue;
+			}
+
+			if (time < min)
+				min = time;
+			if (time > max)
+				max = time;
+			sum += time;
+
+			file.appendText(String(time) + "\n");
+		}
+
+		if (numInstances < 2)
+			return true;
+		const auto avg = sum / (numInstances - 1);
+		const auto passed = static_cast<double>(avg) <= maxAvgMs * 1000.;
+		file.appendText("\nmin: " + String(min));
+		file.appendText("\nmax: " + String(max));
+		file.appendText("\navg: " + String(avg));
+		file.appendText("\nlimit: " + String(maxAvgMs * 1000.) + (passed ? ", passed" : ", FAILED"));
+		return passed;
+	}
+
+	/* runs the vibrato engines on the same noise and modulation.
+	logs the memory each of them holds and the time it needs per block in microseconds */
+	inline void vibratoEngines(double sampleRate = 44100., int blockSize = 512, double bufferSizeMs = 4.,
+		int numIterations = 1024, int numChannels = 2)
+	{
+		const auto file = createLog("engines");
+
+		auto delaySize = static_cast<int>(std::round(sampleRate * bufferSizeMs * .001));
+		delaySize += delaySize % 2;
+		vibrato::Processor delay;
+		delay.prepare(sampleRate, blockSize, delaySize, delaySize / 2, numChannels);
+		vibrato::AllpassProcessor allpass;
+		allpass.prepare(sampleRate, blockSize, delaySize);
+
+		juce::AudioBuffer<double> audio(numChannels, blockSize), mods(numChannels, blockSize);
+		std::vector<double> depthBuf(static_cast<size_t>(blockSize));
+		juce::Random rand(420);
+		auto phase = 0.;
+		const auto inc = 5. / sampleRate;
+
+		const auto fill = [&]()
+		{
+			for (auto ch = 0; ch < numChannels; ++ch)
+			{
+				auto smpls = audio.getWritePointer(ch);
+				auto mod = mods.getWritePointer(ch);
+				for (auto s = 0; s < blockSize; ++s)
+				{
+					smpls[s] = rand.nextDouble() * 2. - 1.;
+					mod[s] = std::sin(juce::MathConstants<double>::twoPi * (phase + inc * static_cast<double>(s)));
+				}
+			}
+			std::fill(depthBuf.begin(), depthBuf.end(), 1.);
+			phase += inc * static_cast<double>(blockSize);
+			phase -= std::floor(phase);
+		};
+
+		const auto run = [&](const String& engine, size_t memory, const std::function<void()>& process)
+		{
+			AtomicDuration duration;
+			auto min = std::numeric_limits<long long>::max();
+			auto max = std::numeric_limits<long long>::min();
+			long long sum = 0;
+
+			for (auto i = 0; i < numIterations; ++i)
+			{
+				fill();
+				{
+					Measure measure(duration);
+					process();
+				}
+
+				const auto time = std::chrono::duration_cast<Nano>(duration.load()).count();
+				if (time < min)
+					min = time;
+				if (time > max)
+					max = time;
+				sum += time;
+			}
+
+			const auto toMicro = [](long long ns) { return String(static_cast<double>(ns) * .001, 2); };
+			file.appendText(engine + "\nmemory: " + String(memory) + " bytes");
+			file.appendText("\nmin: " + toMicro(min));
+			file.appendText("\nmax: " + toMicro(max));
+			file.appendText("\navg: " + toMicro(sum / numIterations) + "\n\n");
+		};
+
+		run("delay", delay.getMemoryUsage(), [&]()
+		{
+			delay(audio.getArrayOfWritePointers(), numChannels, blockSize, mods.getArrayOfWritePointers(),
+				depthBuf.data(), .5, 4000., vibrato::InterpolationType::Spline, true);
+		});
+		// the voices of the chorus share the ring, so neither memory nor time grow like they would with more instances
+		delay.setNumVoices(vibrato::MaxNumVoices);
+		run("chorus " + String(vibrato::MaxNumVoices) + " voices", delay.getMemoryUsage(), [&]()
+		{
+			delay(audio.getArrayOfWritePointers(), numChannels, blockSize, mods.getArrayOfWritePointers(),
+				depthBuf.data(), .5, 4000., vibrato::InterpolationType::Spline, true);
+		});
+		run("allpass", allpass.getMemoryUsage(), [&]()
+		{
+			allpass(audio.getArrayOfWritePointers(), numChannels, blockSize, mods.getArrayOfWritePointers(),
+				.5, 4000.);
+		});
+	}
+
+	/* stands in for a host's audio callback, that processes the delay engine once per block period.
+	runs serially first and on the realtime worker pool then, and logs the time per callback,
+	the callbacks that took longer than a period and the helpers that missed their deadline */
+	inline void workerPool(double sampleRate = 192000., int blockSize = 64, int numChannels = 16,
+		int numIterations = 4096, int numThreads = 4)
+	{
+		const auto file = createLog("pool");
+
+		auto delaySize = static_cast<int>(std::round(sampleRate * .004));
+		delaySize += delaySize % 2;
+		vibrato::Processor delay;
+		delay.prepare(sampleRate, blockSize, delaySize, delaySize / 2, numChannels);
+
+		juce::AudioBuffer<double> audio(numChannels, blockSize), mods(numChannels, blockSize);
+		std::vector<double> depthBuf(static_cast<size_t>(blockSize), 1.);
+		juce::Random rand(420);
+		const auto period = Duration(static_cast<double>(blockSize) / sampleRate);
+
+		const auto run = [&](const String& mode, int threads)
+		{
+			dsp::ForkJoin forkJoin;
+			forkJoin.prepare(threads, true);
+			forkJoin.setEnabled(true);
+			forkJoin.setDeadline(.25 * period.count());
+			delay.reset();
+
+			AtomicDuration duration;
+			auto max = std::numeric_limits<long long>::min();
+			long long sum = 0;
+			auto numOverruns = 0, numMisses = 0;
+			auto next = Clock::now();
+
+			for (auto i = 0; i < numIterations; ++i)
+			{
+				for (auto ch = 0; ch < numChannels; ++ch)
+				{
+					auto smpls = audio.getWritePointer(ch);
+					auto mod = mods.getWritePointer(ch);
+					for (auto s = 0; s < blockSize; ++s)
+					{
+						smpls[s] = rand.nextDouble() * 2. - 1.;
+						mod[s] = rand.nextDouble() * 2. - 1.;
+					}
+				}
+
+				next += std::chrono::duration_cast<Clock::duration>(period);
+				std::this_thread::sleep_until(next);
+				{
+					Measure measure(duration);
+					delay.prepareBlock(blockSize, depthBuf.data(), .5, 4000., true);
+					const auto samples = audio.getArrayOfWritePointers();
+					const auto vibBuf = mods.getArrayOfWritePointers();
+					forkJoin(numChannels, [&](int ch)
+					{
+						delay.processChannel(samples[ch], ch, blockSize, vibBuf[ch], depthBuf.data(),
+							vibrato::InterpolationType::Spline, true);
+					});
+				}
+
+				const auto time = std::chrono::duration_cast<Nano>(duration.load()).count();
+				if (time > max)
+					max = time;
+				sum += time;
+				if (duration.load() > period)
+					++numOverruns;
+				numMisses += forkJoin.getNumMisses();
+			}
+
+			const auto toMicro = [](long long ns) { return String(static_cast<double>(ns) * .001, 2); };
+			file.appendText(mode + ", " + String(threads) + " threads");
+			file.appendText("\nmax: " + toMicro(max));
+			file.appendText("\navg: " + toMicro(sum / numIterations));
+			file.appendText("\nblocks over the period: " + String(numOverruns));
+			file.appendText("\nhelpers late: " + String(numMisses) + "\n\n");
+		};
+
+		file.appendText(String(numChannels) + " channels, " + String(blockSize) + " samples at " + String(sampleRate)
+			+ " Hz, period: " + String(period.count() * 1000000., 2) + "\n\n");
+		run("serial", 1);
+		run("pool", numThreads);
+	}
+
 	struct ProcessBlock :
 		public Timer
 	{
@@ -1052,6 +1052,75 @@ namespace menu2
 				};
 				addSwitchButton(id, child, i, onSwitch, buttonName, onIsEnabled);
 			}
+			else if (buttonName == "lookahead")
+			{
+				const auto onSwitch = [this](int e)
+				{
+					processor.lookaheadAdaptive = e != 0;
+					processor.markStateDirty();
+					processor.forcePrepare();
+				};
+				const auto onIsEnabled = [this](int i)
+				{
+					return (processor.lookaheadAdaptive ? 1 : 0) == i;
+				};
+				addSwitchButton(id, child, i, onSwitch, buttonName, onIsEnabled);
+			}
+			else if (buttonName == "engine")
+			{
+				const auto onSwitch = [this](int e)
+				{
+					processor.engine = static_cast<vibrato::EngineType>(e);
+					processor.markStateDirty();
+					processor.forcePrepare();
+				};
+				const auto onIsEnabled = [this](int i)
+				{
+					return static_cast<int>(processor.engine) == i;
+				};
+				addSwitchButton(id, child, i, onSwitch, buttonName, onIsEnabled);
+			}
+			else if (buttonName == "voices")
+			{
+				const auto onSwitch = [this](int e)
+				{
+					processor.numVoices.store(e + 1);
+					processor.markStateDirty();
+				};
+				const auto onIsEnabled = [this](int i)
+				{
+					return processor.numVoices.load() == i + 1;
+				};
+				addSwitchButton(id, child, i, onSwitch, buttonName, onIsEnabled);
+			}
+			else if (buttonName == "threads")
+			{
+				const auto onSwitch = [this](int e)
+				{
+					processor.parallelRealtime = e != 0;
+					processor.markStateDirty();
+					processor.forcePrepare();
+				};
+				const auto onIsEnabled = [this](int i)
+				{
+					return (processor.parallelRealtime ? 1 : 0) == i;
+				};
+				addSwitchButton(id, child, i, onSwitch, buttonName, onIsEnabled);
+			}
+			else if (buttonName == "cache")
+			{
+				const auto onSwitch = [this](int e)
+				{
+					processor.cacheCurves = e != 0;
+					processor.markStateDirty();
+					processor.forcePrepare();
+				};
+				const auto onIsEnabled = [this](int i)
+				{
+					return (processor.cacheCurves ? 1 : 0) == i;
+				};
+				addSwitchButton(id, child, i, onSwitch, buttonName, onIsEnabled);
+			}
 			else if (buttonName.contains("modType"))
 			{
 				auto mIdx = 0;
@@ -1,5 +1,6 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "presets/Presets.h"
 
 gui::Notify makeNotify(Nel19AudioProcessorEditor* comp)
 {
@@ -54,10 +55,11 @@ Nel19AudioProcessorEditor::Nel19AudioProcessorEditor(Nel19AudioProcessor& p) :
     macro3(utils, "M3", "Modulate parameters with this macro.", modSys6::PID::MSMacro3, modulatables, gui::ParameterType::Knob),
     modComps
     {
-        gui::ModComp(utils, modulatables, audioProcessor.modulators[0].getTables(), 0),
-        gui::ModComp(utils, modulatables, audioProcessor.modulators[1].getTables(), modSys6::NumParamsPerMod)
+        gui::ModComp(utils, modulatables, audioProcessor.modulators[0], 0),
+        gui::ModComp(utils, modulatables, audioProcessor.modulators[1], modSys6::NumParamsPerMod)
     },
-    visualizer(utils, "Visualizes the sum of the vibrato's modulators.", p.getChannelCountOfBus(false, 0), 1),
+    visualizer(utils, "Visualizes the sum of the vibrato's modulators.", p.getChannelCountOfBus(false, 0),
+        static_cast<int>(dsp::Telemetry::FramesPerSec)),
 	bufferSizes(utils, "Buffer", "Switch between different buffer sizes for the vibrato.", modSys6::PID::BufferSize, modulatables, gui::ParameterType::Knob),
     modsDepth(utils, "Depth", "Modulate the depth of the vibrato.", modSys6::PID::Depth, modulatables, gui::ParameterType::Knob),
     modsMix(utils, "Mods", "Interpolate between the vibrato's modulators.", modSys6::PID::ModsMix, modulatables, gui::ParameterType::Knob),
@@ -86,7 +88,11 @@ Nel19AudioProcessorEditor::Nel19AudioProcessorEditor(Nel19AudioProcessor& p) :
 #if PresetsExist
     ,presetBrowser(utils, ".nel", "presets")
 #endif
+    ,lastTickMs(0.)
+    ,vblank(this, [this]() { updateFrame(); })
 {
+    presets::init(p.appProperties);
+
     nelLabel.font = gui::Shared::shared.font;
 
     paramRandomizer.add(&stereoConfig);
@@ -94,20 +100,22 @@ Nel19AudioProcessorEditor::Nel19AudioProcessorEditor(Nel19AudioProcessor& p) :
     visualizer.onPaint = gui::makeVibratoVisualizerOnPaint2();
     visualizer.onUpdate = [&p = audioProcessor](gui::Visualizer::Buffer& b)
     {
-        const auto& vals = p.visualizerValues;
+        // the buffer holds the last second of frames, the newest one first
+        dsp::TelemetryFrame frame;
         bool needsUpdate = false;
-        for (auto ch = 0; ch < b.size(); ++ch)
-        {
-            const auto val = static_cast<float>(vals[ch]);
-
-            if (b[ch][0] != val)
+        while (p.telemetry.pop(frame))
+            for (auto ch = 0; ch < b.size(); ++ch)
             {
-                b[ch][0] = val;
+                auto& history = b[ch];
+                const auto val = frame.modMin[ch] > frame.modMax[ch] ? 0.
+                    : static_cast<double>(frame.modMin[ch] + frame.modMax[ch]) * .5;
+                std::rotate(history.rbegin(), history.rbegin() + 1, history.rend());
+                history.front() = val;
                 needsUpdate = true;
             }
-        }
         return needsUpdate;
     };
+    visualizer.getGeneration = [&p = audioProcessor]() { return p.telemetry.getGeneration(); };
 
     addAndMakeVisible(nelLabel);
 
@@ -161,6 +169,18 @@ Nel19AudioProcessorEditor::Nel19AudioProcessorEditor(Nel19AudioProcessor& p) :
         utils.updatePatch(vt);
         notify(gui::NotificationType::PatchUpdated);
     };
+
+    presetBrowser.morphFunc = [&](const juce::ValueTree& vt)
+    {
+        utils.audioProcessor.savePatch();
+        utils.morphPatches(utils.audioProcessor.params.state.createCopy(), vt);
+        notify(gui::NotificationType::PatchUpdated);
+    };
+
+    presetBrowser.onMorph = [&](float x)
+    {
+        utils.setPatchMorph(x);
+    };
 #endif
 
 #if DebugMenuExists
@@ -184,6 +204,7 @@ Nel19AudioProcessorEditor::Nel19AudioProcessorEditor(Nel19AudioProcessor& p) :
         modComp.onModChange = [this, m](vibrato::ModType t)
         {
             audioProcessor.modType[m] = t;
+            audioProcessor.markStateDirty();
         };
         modComp.setMod(p.modType[m]);
         modComp.addButtonsToRandomizer(paramRandomizer);
@@ -211,15 +232,31 @@ Nel19AudioProcessorEditor::Nel19AudioProcessorEditor(Nel19AudioProcessor& p) :
     setResizable(true, true);
     {
         const auto user = p.appProperties.getUserSettings();
+        user->setValue("firstTimeUwU", false);
         const auto w = user->getIntValue("BoundsWidth", gui::Width);
         const auto h = user->getIntValue("BoundsHeight", gui::Height);
         setSize(w, h);
     }
+}
 
-    startTimerHz(60);
+void Nel19AudioProcessorEditor::updateFrame()
+{
+    const auto nowMs = juce::Time::getMillisecondCounterHiRes();
+    const auto tickMs = 1000. / TickHz;
+    // starts over after the editor was hidden instead of catching up
+    if (nowMs - lastTickMs > tickMs * 4.)
+        lastTickMs = nowMs - tickMs;
+    // a frame that comes a little early still ticks, so a 60 Hz display doesn't skip ticks because of jitter
+    while (nowMs - lastTickMs >= tickMs * .75)
+    {
+        lastTickMs += tickMs;
+        updateTick();
+    }
 }
 
-void Nel19AudioProcessorEditor::timerCallback()
+/* only components that poll something get ticked, every one of them returns early unless its generation moved.
+the macro draggers and the preset browser only change on their own events */
+void Nel19AudioProcessorEditor::updateTick()
 {
     nelLabel.updateTimer();
     tooltips.updateTimer();
@@ -229,10 +266,6 @@ void Nel19AudioProcessorEditor::timerCallback()
     for (auto& modComp : modComps)
         modComp.updateTimer();
     visualizer.updateTimer();
-    macro0Dragger.updateTimer();
-	macro1Dragger.updateTimer();
-	macro2Dragger.updateTimer();
-	macro3Dragger.updateTimer();
     paramRandomizer.updateTimer();
     popUp.updateTimer();
     enterValue.updateTimer();
@@ -241,9 +274,6 @@ void Nel19AudioProcessorEditor::timerCallback()
         menu->updateTimer();
     menuButton.updateTimer();
 #endif
-#if PresetsExist
-    presetBrowser.updateTimer();
-#endif
 }
 
 void Nel19AudioProcessorEditor::resized()
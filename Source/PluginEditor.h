@@ -13,10 +13,11 @@
 #endif
 
 struct Nel19AudioProcessorEditor :
-    public juce::AudioProcessorEditor,
-    public juce::Timer
+    public juce::AudioProcessorEditor
 {
     static constexpr int MinEditorBounds = 120;
+    // the components count ticks for their animations, so they tick at this rate whatever the display's is
+    static constexpr double TickHz = 60.;
     
     Nel19AudioProcessorEditor(Nel19AudioProcessor&);
 
@@ -24,7 +25,9 @@ struct Nel19AudioProcessorEditor :
     void paint(juce::Graphics&) override;
     void mouseEnter(const juce::MouseEvent&) override;
     void mouseDown(const juce::MouseEvent&) override;
-    void timerCallback() override;
+    // called once per display frame, components only repaint what changed
+    void updateFrame();
+    void updateTick();
 
 protected:
     Nel19AudioProcessor& audioProcessor;
@@ -64,6 +67,9 @@ protected:
 #if PresetsExist
     gui::PresetBrowser presetBrowser;
 #endif
+
+    double lastTickMs;
+    juce::VBlankAttachment vblank;
 };
 
 /*
@@ -1,6 +1,5 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
-#include "presets/Presets.h"
 #define RemoveValueTree false
 #define OversamplingEnabled true
 #define DebugModsBuffer false
@@ -23,10 +22,12 @@ Nel19AudioProcessor::Nel19AudioProcessor()
      :
     AudioProcessor(makeBusesProps()),
     Timer(),
+    arena(),
     sidechain(),
     appProperties(),
     standalonePlayHead(),
     audioBufferD(),
+    midiSlice(),
     dryWet(),
     params(*this),
     oversampling(),
@@ -38,21 +39,40 @@ Nel19AudioProcessor::Nel19AudioProcessor()
         vibrato::ModType::Perlin
     },
     vibrat(),
-    visualizerValues{ 0., 0. },
-    depth(1.), modsMix(0.)
+    vibratAllpass(),
+    telemetry(),
+    lookaheadAdaptive(false),
+    parallelNonRealtime(true),
+    parallelRealtime(false),
+    cacheCurves(false),
+    engine(vibrato::EngineType::Delay),
+    numVoices(1),
+    stateGeneration(0),
+    depth(1.), modsMix(0.),
+    lookaheadDepth(1.f), lookaheadDepthPrepared(1.f),
+    lookaheadAdaptivePrepared(false),
+    enginePrepared(vibrato::EngineType::Delay),
+    stateChunk(),
+    maxBlockSize(0),
+    channelPositions(),
+    forkJoin(),
+    silence(),
+    wetBypassed(false),
+    morph(),
+    presetNotified(),
+    modTypeActive(modType),
+    presetPostedMs(0),
+    presetRebuild(false), presetNotifyPending(false), presetLatchPending(false)
 #endif
 {
+    // the settings file is only loaded once the editor asks for it
     appProperties.setStorageParameters(makeOptions());
-    presets::init(appProperties);
 
     startTimerHz(4);
 }
 
 Nel19AudioProcessor::~Nel19AudioProcessor()
 {
-    auto user = appProperties.getUserSettings();
-    user->setValue("firstTimeUwU", false);
-    user->save();
 }
 
 bool Nel19AudioProcessor::canAddBus(bool isInput) const
@@ -100,7 +120,16 @@ bool Nel19AudioProcessor::isMidiEffect() const
 
 double Nel19AudioProcessor::getTailLengthSeconds() const
 {
-    return 0.;
+    using PID = modSys6::PID;
+    auto delayMs = static_cast<double>(params(PID::BufferSize).getValSumDenorm());
+    if (enginePrepared == vibrato::EngineType::Allpass)
+    {
+        using Allpass = vibrato::AllpassProcessor;
+        delayMs = juce::jmin(delayMs, Allpass::MaxStageDelayMs * static_cast<double>(Allpass::NumStages));
+    }
+    const auto delaySecs = delayMs * .001;
+    const auto feedback = static_cast<double>(params(PID::Feedback).getValSumDenorm());
+    return vibrato::getTailSecs(delaySecs, feedback);
 }
 
 int Nel19AudioProcessor::getNumPrograms()
@@ -127,9 +156,18 @@ void Nel19AudioProcessor::changeProgramName(int, const String&)
 
 void Nel19AudioProcessor::prepareToPlay(double sampleRate, int maxBufferSize)
 {
+    // the scratch buffers declared in here get their memory when this goes out of scope
+    const dsp::Arena::Preparing preparing(arena);
     standalonePlayHead.prepare(sampleRate);
+    morph.prepare(params, sampleRate);
     
-    audioBufferD.setSize(4, maxBufferSize, false, true, false);
+    // the main bus and the sidechain
+    const auto numChannelsAll = juce::jmax(getTotalNumInputChannels(), getTotalNumOutputChannels());
+    const auto numChannels = juce::jmax(1, getMainBusNumOutputChannels());
+    audioBufferD.setSize(numChannelsAll, maxBufferSize);
+    maxBlockSize = maxBufferSize;
+    midiSlice.ensureSize(MidiSliceBytes);
+    dsp::makePositions(channelPositions, getChannelLayoutOfBus(false, 0));
 
     using PID = modSys6::PID;
 
@@ -140,17 +178,34 @@ void Nel19AudioProcessor::prepareToPlay(double sampleRate, int maxBufferSize)
     if (delaySize % 2 != 0)
 		delaySize += 1;
     const auto delaySizeHalf = delaySize / 2;
+
+    enginePrepared = engine;
+    const auto delayEngine = engine == vibrato::EngineType::Delay;
+
+    // the vibrato's average delay scales with depth, so in adaptive mode
+    // the lookahead only has to cover the latched depth's maximum excursion.
+    // the allpass engine is too short to need any lookahead
+    auto lookahead = delaySizeHalf;
+    if (!delayEngine)
+        lookahead = 1;
+    else if (lookaheadAdaptive)
+    {
+        const auto lookaheadD = std::ceil(static_cast<double>(lookaheadDepth) * static_cast<double>(delaySizeHalf));
+        lookahead = juce::jlimit(1, delaySizeHalf, static_cast<int>(lookaheadD));
+    }
+    lookaheadDepthPrepared = lookaheadDepth;
+    lookaheadAdaptivePrepared = lookaheadAdaptive;
     
-    dryWet.prepare(sampleRate, maxBufferSize, delaySizeHalf);
+    dryWet.prepare(sampleRate, maxBufferSize, lookahead, numChannels);
 
-    const auto lookaheadEnabled = params(PID::Lookahead).getValueSum() > .5f;
+    const auto lookaheadEnabled = delayEngine && params(PID::Lookahead).getValueSum() > .5f;
 
-	auto latency = delaySizeHalf * (lookaheadEnabled ? 1 : 0);
+	auto latency = lookahead * (lookaheadEnabled ? 1 : 0);
     
     bool osEnabled = false;
 #if OversamplingEnabled && !DebugModsBuffer
 	osEnabled = params(PID::HQ).getValueSum() > .5f;
-    oversampling.prepareToPlay(sampleRate, maxBufferSize, osEnabled);
+    oversampling.prepareToPlay(sampleRate, maxBufferSize, osEnabled, numChannelsAll);
 
     const auto sampleRateUpD = oversampling.getSampleRateUpsampled();
     const auto blockSizeUp = oversampling.getBlockSizeUp();
@@ -162,45 +217,82 @@ void Nel19AudioProcessor::prepareToPlay(double sampleRate, int maxBufferSize)
     depth.prepare(sampleRate, blockSizeUp, 24.);
 	modsMix.prepare(sampleRate, blockSizeUp, 24.);
 
-    modsBuffer.setSize(2, blockSizeUp, false, true, false);
+    modsBuffer.setSize(numChannels, blockSizeUp);
+    telemetry.prepare(sampleRateUpD);
+
+    // one thread per channel (sidechain included) or modulator, whichever there are more of
+    auto numThreads = 1;
+    if (parallelRealtime || (parallelNonRealtime && isNonRealtime()))
+    {
+        const auto numTasks = juce::jmax(getTotalNumInputChannels(), getTotalNumOutputChannels(), NumActiveMods);
+        numThreads = juce::jmin(numTasks, juce::SystemStats::getNumCpus());
+    }
+    forkJoin.prepare(numThreads, parallelRealtime);
     
+    // the modulators are done before the vibrato starts, so their scratch memory is shared.
+    // they also share it among each other, unless they run on different threads
     for (auto m = 0; m < NumActiveMods; ++m)
+    {
+        const dsp::Arena::Stage stage(arena, numThreads > 1 ? StageModulators : StageModulators + m);
+        modulators[m].setCacheEnabled(cacheCurves);
         modulators[m].prepare(sampleRateUpD, blockSizeUp, latency, osEnabled ? 4 : 1);
-        
-    vibrat.prepare
+    }
+
+    const dsp::Arena::Stage stage(arena, StageVibrato);
+    // only the selected engine holds on to its memory
+    if (delayEngine)
+        vibrat.prepare
+        (
+            sampleRateUpD,
+            blockSizeUp,
+            delaySize * (osEnabled ? 4 : 1),
+            lookahead * (osEnabled ? 4 : 1),
+            numChannels
+        );
+    else
+        vibrat.prepare(sampleRateUpD, blockSizeUp, 4, 0, numChannels);
+    vibratAllpass.prepare
     (
         sampleRateUpD,
         blockSizeUp,
         delaySize * (osEnabled ? 4 : 1)
     );
 
+    silence.reset();
+    wetBypassed = false;
+
     setLatencySamples(latency);
 }
 
 void Nel19AudioProcessor::releaseResources()
 {}
 
-bool Nel19AudioProcessor::isBusesLayoutSupported(const BusesLayout& layouts) const
+#if NEL_AUDIO_WORKGROUP
+void Nel19AudioProcessor::audioWorkgroupContextChanged(const juce::AudioWorkgroup& workgroup)
 {
-    const auto mono = ChannelSet::mono();
-    const auto stereo = ChannelSet::stereo();
+    // the helpers of the audio thread join the host's workgroup on the next prepare
+    forkJoin.setWorkgroup(workgroup);
+}
+#endif
 
+bool Nel19AudioProcessor::isBusesLayoutSupported(const BusesLayout& layouts) const
+{
     const auto mainIn = layouts.getMainInputChannelSet();
     const auto mainOut = layouts.getMainOutputChannelSet();
 
     if (mainIn != mainOut)
         return false;
 
-    if (mainOut != stereo && mainOut != mono)
+    // any layout up to 16 channels, from mono to immersive beds
+    if (mainOut.isDisabled() || mainOut.size() > dsp::MaxNumChannels)
         return false;
 
 #if PPDHasSidechain
     if (wrapperType != wrapperType_Standalone)
     {
         const auto scIn = layouts.getChannelSet(true, 1);
-        if (!scIn.isDisabled())
-            if (scIn != mono && scIn != stereo)
-                return false;
+        if (scIn.size() > dsp::MaxNumChannels)
+            return false;
     }
 #endif
 
@@ -209,26 +301,38 @@ bool Nel19AudioProcessor::isBusesLayoutSupported(const BusesLayout& layouts) con
 
 void Nel19AudioProcessor::processBlock(AudioBufferF& buffer, MidiBuffer& midi)
 {
+    juce::ScopedNoDenormals noDenormals;
+    const dsp::realtime::Scope realtime(!isNonRealtime());
     const auto numChannels = buffer.getNumChannels();
-    const auto numSamples = buffer.getNumSamples();
-    audioBufferD.setSize(numChannels, numSamples, true, false, true);
-    
-    auto samplesD = audioBufferD.getArrayOfWritePointers();
+    const auto numSamplesAll = buffer.getNumSamples();
+    // the double buffer only holds as many samples as were prepared, a larger block is converted slice by slice
+    const auto sliceSize = numSamplesAll <= maxBlockSize || maxBlockSize == 0 ? numSamplesAll : maxBlockSize;
     auto samplesF = buffer.getArrayOfWritePointers();
 
-    for(auto ch = 0; ch < numChannels; ++ch)
-        for (auto s = 0; s < numSamples; ++s)
-        {
-            const auto smplF = samplesF[ch][s];
-            const auto smplD = static_cast<double>(smplF);
-			samplesD[ch][s] = smplD;
-        }
-    
-    processBlock(audioBufferD, midi);
+    auto start = 0;
+    do
+    {
+        const auto numSamples = juce::jmin(sliceSize, numSamplesAll - start);
+        AudioBufferD bufferD;
+        audioBufferD.referTo(bufferD, numChannels, numSamples);
+        auto samplesD = bufferD.getArrayOfWritePointers();
 
-    for (auto ch = 0; ch < numChannels; ++ch)
-        for (auto s = 0; s < numSamples; ++s)
-			samplesF[ch][s] = static_cast<float>(samplesD[ch][s]);
+        for (auto ch = 0; ch < numChannels; ++ch)
+            for (auto s = 0; s < numSamples; ++s)
+            {
+                const auto smplF = samplesF[ch][start + s];
+                const auto smplD = static_cast<double>(smplF);
+                samplesD[ch][s] = smplD;
+            }
+
+        processBlockSlice(bufferD, sliceSize == numSamplesAll ? midi : sliceMidi(midi, start, numSamples));
+
+        for (auto ch = 0; ch < numChannels; ++ch)
+            for (auto s = 0; s < numSamples; ++s)
+                samplesF[ch][start + s] = static_cast<float>(samplesD[ch][s]);
+
+        start += sliceSize;
+    } while (start < numSamplesAll);
 }
 
 void Nel19AudioProcessor::processBlockBypassed(AudioBufferF& buffer, MidiBuffer&)
@@ -239,20 +343,44 @@ void Nel19AudioProcessor::processBlockBypassed(AudioBufferF& buffer, MidiBuffer&
     for (auto ch = 0; ch < buffer.getNumChannels(); ++ch)
         SIMD::clear(samples[ch], buffer.getNumSamples());
 
+    morph(params, numSamples, true);
     params.processMacros();
+}
 
-    if (numSamples == 0)
+void Nel19AudioProcessor::processBlock(AudioBufferD& buffer, MidiBuffer& midi)
+{
+    juce::ScopedNoDenormals noDenormals;
+    const dsp::realtime::Scope realtime(!isNonRealtime());
+    const auto numSamplesAll = buffer.getNumSamples();
+    if (numSamplesAll <= maxBlockSize || maxBlockSize == 0)
+        return processBlockSlice(buffer, midi);
+
+    // some hosts send more samples than they prepared for, the scratch buffers can't hold them in one go.
+    // the slices refer to the host's channels, juce keeps their pointers in preallocated space
+    const auto numChannels = buffer.getNumChannels();
+    for (auto start = 0; start < numSamplesAll; start += maxBlockSize)
     {
-        for (auto& v : visualizerValues)
-            v = 0.;
-        return;
+        const auto numSamples = juce::jmin(maxBlockSize, numSamplesAll - start);
+        AudioBufferD slice(buffer.getArrayOfWritePointers(), numChannels, start, numSamples);
+        processBlockSlice(slice, sliceMidi(midi, start, numSamples));
     }
 }
 
-void Nel19AudioProcessor::processBlock(AudioBufferD& buffer, MidiBuffer& midi)
+const juce::MidiBuffer& Nel19AudioProcessor::sliceMidi(const MidiBuffer& midi, int start, int numSamples) noexcept
+{
+    midiSlice.clear();
+    midiSlice.addEvents(midi, start, numSamples, -start);
+    return midiSlice;
+}
+
+void Nel19AudioProcessor::processBlockSlice(AudioBufferD& buffer, const MidiBuffer& midi) noexcept
 {
-    juce::ScopedNoDenormals noDenormals;
     const auto numSamples = buffer.getNumSamples();
+    // a host can switch back to realtime without preparing again
+    const auto nonRealtime = isNonRealtime();
+    forkJoin.setEnabled(nonRealtime ? parallelNonRealtime : parallelRealtime);
+    // a block forks a few times, helpers that wake up later than a tenth of it leave their tasks to the audio thread
+    forkJoin.setDeadline(nonRealtime ? 0. : .1 * static_cast<double>(numSamples) / getSampleRate());
     {
         const auto numChannelsIn = getTotalNumInputChannels();
         const auto numChannelsOut = getTotalNumOutputChannels();
@@ -270,40 +398,78 @@ void Nel19AudioProcessor::processBlock(AudioBufferD& buffer, MidiBuffer& midi)
         numSamples
     );
 
+    // the wet chain didn't run in the last block if it was bypassed or asleep
+    morph(params, numSamples, wetBypassed || silence.isSleeping());
+    if (!morph.isStructural())
+        modTypeActive = modType;
     params.processMacros();
     
     if (numSamples == 0)
-    {
-        for (auto& v : visualizerValues)
-            v = 0.;
         return;
-    }
 
     const auto samplesMainRead = sidechain.samplesMainRead;
     const auto numChannels = sidechain.numChannels;
-    const auto dryWetMix = params(modSys6::PID::DryWetMix).getValueSum();
-    const auto lookaheadEnabled = params(modSys6::PID::Lookahead).getValueSum() > .5f;
-    dryWet.saveDry(samplesMainRead, dryWetMix, numChannels, numSamples, lookaheadEnabled);
-
     auto samplesMain = sidechain.samplesMain;
-    
+
+    // SLEEP WHILE THE INPUT IS SILENT AND THE TAIL HAS DECAYED
+    silence.setTail(getTailLengthSeconds() * getSampleRate() + static_cast<double>(getLatencySamples()));
+    if (silence(samplesMainRead, numChannels, numSamples))
+    {
+        if (silence.justFellAsleep())
+            resetWet();
+        buffer.clear();
+        skipWet(buffer, midi, false, false);
+        telemetry.pushLevelDry(samplesMainRead, numChannels, numSamples);
+        telemetry.pushLevelWet(samplesMainRead, numChannels, numSamples);
+        return;
+    }
+
+    // a structural preset switch fades the wet signal out while the engine is rebuilt
+    const auto dryWetMix = params(modSys6::PID::DryWetMix).getValueSum() * morph.getWet();
+    const auto lookaheadEnabled = enginePrepared == vibrato::EngineType::Delay
+        && params(modSys6::PID::Lookahead).getValueSum() > .5f;
+    if (wetBypassed && dryWetMix != 0.f)
+    {
+        // the delays kept taking in the input while the mix was dry, only the allpass cascade starts over
+        wetBypassed = false;
+        vibratAllpass.reset();
+    }
+
+    dryWet.prepareDry(dryWetMix, numSamples, lookaheadEnabled);
+    forkJoin(numChannels, [&](int ch)
+    {
+        dryWet.saveDryChannel(samplesMainRead[ch], ch, numSamples, lookaheadEnabled);
+    });
+    telemetry.pushLevelDry(samplesMainRead, numChannels, numSamples);
+
     const auto midSideEnabled = params(modSys6::PID::StereoConfig).getValueSum() > .5f;
     bool shallMidSide = midSideEnabled && numChannels == 2;
 #if !DebugModsBuffer
     if (shallMidSide)
     {
         midSide::encode(samplesMain, numSamples);
-        if (sidechain.enabled)
+        if (sidechain.enabled && sidechain.numChannelsSC == 2)
             midSide::encode(sidechain.samplesSC, numSamples);
-        processBlockVibrato(buffer, midi, lookaheadEnabled);
-        midSide::decode(samplesMain, numSamples);
     }
-    else
 #endif
+
+    // BYPASS THE WET CHAIN WHILE THE MIX IS FULLY DRY
+    if (dryWet.isDry())
     {
-        processBlockVibrato(buffer, midi, lookaheadEnabled);
+        wetBypassed = true;
+        skipWet(buffer, midi, true, lookaheadEnabled);
+        dryWet.processDry(samplesMain, numChannels, numSamples);
+        telemetry.pushLevelWet(samplesMainRead, numChannels, numSamples);
+        return;
     }
+
+    processBlockVibrato(buffer, midi, lookaheadEnabled);
+#if !DebugModsBuffer
+    if (shallMidSide)
+        midSide::decode(samplesMain, numSamples);
+#endif
     
+    telemetry.pushLevelWet(samplesMainRead, numChannels, numSamples);
     const auto gainWet = params(modSys6::PID::WetGain).getValSumDenorm();
     dryWet.processWet(samplesMain, gainWet, numChannels, numSamples);
 }
@@ -311,9 +477,11 @@ void Nel19AudioProcessor::processBlock(AudioBufferD& buffer, MidiBuffer& midi)
 void Nel19AudioProcessor::processBlockVibrato(AudioBufferD& bufferAll, const MidiBuffer& midi,
     bool lookaheadEnabled) noexcept
 {
+    // without helper threads the channels are processed in pairs, that share the simd registers of the recursive filters
+    const auto forking = forkJoin.isForking();
     
 #if OversamplingEnabled && !DebugModsBuffer
-    auto& buffer = oversampling.upsample(bufferAll);
+    auto& buffer = upsampleWet(bufferAll);
     const auto osEnabled = oversampling.isEnabled();
 #else
     auto& buffer = bufferAll;
@@ -322,121 +490,52 @@ void Nel19AudioProcessor::processBlockVibrato(AudioBufferD& bufferAll, const Mid
     
     const auto numChannels = sidechain.numChannels;
     const auto numSamples = buffer.getNumSamples();
-    const auto samplesMainRead = sidechain.samplesMainReadUpsampled;
-    const auto samplesSCRead = sidechain.samplesSCReadUpsampled;
 
-    using namespace modSys6;
+    // MODULATOR WEIGHTS
+    const auto modsMixV = params(modSys6::PID::ModsMix).getValueSum();
+    const auto depthV = params(modSys6::PID::Depth).getValueSum();
 
-    // SYNTHESIZE MODULATORS
-    for (auto m = 0; m < NumActiveMods; ++m)
-    {
-        auto& mod = modulators[m];
-        const auto type = modType[m];
-        mod.setType(type);
-        const auto offset = m * NumParamsPerMod;
+    auto modsMixInfo = modsMix(modsMixV, numSamples);
+    auto depthInfo = depth(depthV, numSamples);
+    auto depthBuf = depthInfo.buf;
 
-        switch (type)
-        {
-        case vibrato::ModType::AudioRate:
-            mod.setParametersAudioRate
-            (
-                params(withOffset(PID::AudioRate0Oct, offset)).getValSumDenorm(),
-                params(withOffset(PID::AudioRate0Semi, offset)).getValSumDenorm(),
-                params(withOffset(PID::AudioRate0Fine, offset)).getValSumDenorm(),
-                params(withOffset(PID::AudioRate0Width, offset)).getValSumDenorm(),
-                params(withOffset(PID::AudioRate0RetuneSpeed, offset)).getValSumDenorm(),
-                params(withOffset(PID::AudioRate0Atk, offset)).getValSumDenorm(),
-                params(withOffset(PID::AudioRate0Dcy, offset)).getValSumDenorm(),
-                params(withOffset(PID::AudioRate0Sus, offset)).getValSumDenorm(),
-                params(withOffset(PID::AudioRate0Rls, offset)).getValSumDenorm()
-            );
-            break;
-        case vibrato::ModType::Perlin:
-            mod.setParametersPerlin
-            (
-                static_cast<double>(params(withOffset(PID::Perlin0RateHz, offset)).getValSumDenorm()),
-                static_cast<double>(params(withOffset(PID::Perlin0RateBeats, offset)).getValSumDenorm()),
-                static_cast<double>(params(withOffset(PID::Perlin0Octaves, offset)).getValSumDenorm()),
-                static_cast<double>(params(withOffset(PID::Perlin0Width, offset)).getValSumDenorm()),
-                static_cast<double>(params(withOffset(PID::Perlin0Phase, offset)).getValSumDenorm()),
-                static_cast<double>(params(withOffset(PID::Perlin0Bias, offset)).getValueSum()),
-                perlin2::Shape(std::round(params(withOffset(PID::Perlin0Shape, offset)).getValSumDenorm())),
-                params(withOffset(PID::Perlin0RateType, offset)).getValueSum() > .5f
-            );
-            break;
-        case vibrato::ModType::EnvFol:
-            mod.setParametersEnvFol
-            (
-                params(withOffset(PID::EnvFol0Attack, offset)).getValSumDenorm(),
-                params(withOffset(PID::EnvFol0Release, offset)).getValSumDenorm(),
-                params(withOffset(PID::EnvFol0Gain, offset)).getValSumDenorm(),
-                params(withOffset(PID::EnvFol0Width, offset)).getValueSum(),
-                params(withOffset(PID::EnvFol0SC, offset)).getValueSum() > .5f,
-				params(withOffset(PID::EnvFol0HighPass, offset)).getValSumDenorm()
-            );
-            break;
-        case vibrato::ModType::Macro:
-            mod.setParametersMacro
-            (
-                params(withOffset(PID::Macro0, offset)).getValSumDenorm(),
-                params(withOffset(PID::Macro0Smooth, offset)).getValSumDenorm(),
-				params(withOffset(PID::Macro0SCGain, offset)).getValSumDenorm()
-            );
-            break;
-        case vibrato::ModType::Pitchwheel:
-            mod.setParametersPitchbend
-            (
-                params(withOffset(PID::Pitchbend0Smooth, offset)).getValSumDenorm()
-            );
-            break;
-        case vibrato::ModType::LFO:
-            mod.setParametersLFO
-            (
-                params(withOffset(PID::LFO0FreeSync, offset)).getValueSum() > .5f,
-                params(withOffset(PID::LFO0RateFree, offset)).getValSumDenorm(),
-                params(withOffset(PID::LFO0RateSync, offset)).getValSumDenorm(),
-                params(withOffset(PID::LFO0Waveform, offset)).getValueSum(),
-                params(withOffset(PID::LFO0Phase, offset)).getValSumDenorm(),
-                params(withOffset(PID::LFO0Width, offset)).getValSumDenorm()
-            );
-            break;
-        }
+    if (!modsMixInfo.smoothing)
+        SIMD::fill(modsMixInfo.buf, modsMixV, numSamples);
+    if (!depthInfo.smoothing)
+        SIMD::fill(depthBuf, depthV, numSamples);
 
-        mod.processBlock
-        (
-            samplesMainRead,
-            samplesSCRead,
-            midi,
-            standalonePlayHead.posInfo,
-            numChannels,
-            numSamples
-        );
+    // a modulator is only needed if its weight isn't zero for the whole block.
+    // the smoothers start from exactly zero, so a modulator that comes back
+    // is synthesized for a few ms before it becomes audible
+    std::array<bool, NumActiveMods> modActive;
+    {
+        const auto depthIdle = !depthInfo.smoothing && depthV == 0.f;
+        const auto mixIdle = !modsMixInfo.smoothing;
+        modActive[0] = !depthIdle && !(mixIdle && modsMixV == 1.f);
+        modActive[1] = !depthIdle && !(mixIdle && modsMixV == 0.f);
     }
+
+    // SYNTHESIZE MODULATORS
+    forkJoin(NumActiveMods, [&](int m)
+    {
+        processModulator(m, modActive[m], midi, numChannels, numSamples);
+    });
     
     auto modsBuf = modsBuffer.getArrayOfWritePointers();
 
-    double* depthBuf;
-
     // FILL MODBUFFER WITH MODULATORS
     {
-        const auto modsMixV = params(modSys6::PID::ModsMix).getValueSum();
-        const auto depthV = params(modSys6::PID::Depth).getValueSum();
+        // the buffer of a skipped modulator is stale, so it's replaced by the other one
+        const auto& modBuf0 = modulators[modActive[0] ? 0 : 1].buffer;
+        const auto& modBuf1 = modulators[modActive[1] ? 1 : 0].buffer;
 
-        auto modsMixInfo = modsMix(modsMixV, numSamples);
-        auto depthInfo = depth(depthV, numSamples);
-        depthBuf = depthInfo.buf;
-
-        if (!modsMixInfo.smoothing)
-            SIMD::fill(modsMixInfo.buf, modsMixV, numSamples);
-        if (!depthInfo.smoothing)
-            SIMD::fill(depthBuf, depthV, numSamples);
-
-        for (auto ch = 0; ch < numChannels; ++ch)
+        // the first and the last channel, spread across the layout afterwards
+        const auto numEdges = juce::jmin(numChannels, dsp::NumModChannels);
+        for (auto e = 0; e < numEdges; ++e)
         {
-            const auto mod0 = modulators[0].buffer[ch].data();
-            const auto mod1 = modulators[1].buffer[ch].data();
-            auto& visualizer = visualizerValues[ch];
-            auto mAll = modsBuf[ch];
+            const auto mod0 = modBuf0[e].data();
+            const auto mod1 = modBuf1[e].data();
+            auto mAll = modsBuf[e == 0 ? 0 : numChannels - 1];
             for (auto s = 0; s < numSamples; ++s)
             {
                 const auto modMixed = mod0[s] + modsMixInfo.buf[s] * (mod1[s] - mod0[s]);
@@ -444,48 +543,236 @@ void Nel19AudioProcessor::processBlockVibrato(AudioBufferD& bufferAll, const Mid
                 const auto modShifted = modGained - 1.f;
                 const auto modOut = modShifted + depthInfo.buf[s] * (modGained - modShifted);
                 mAll[s] = modOut;
-                visualizer = modGained;
             }
         }
+        dsp::spread(modsBuf, channelPositions, numChannels, numSamples, depthBuf);
+
+        telemetry.pushModulation(modsBuf, depthBuf, numChannels, numSamples);
     }
 
 #if DebugModsBuffer
-    const auto depthV = params(modSys6::PID::Depth).getValueSum();
     for (auto ch = 0; ch < numChannels; ++ch)
     {
         const auto mAll = modsBuf[ch];
         auto samples = buffer.getWritePointer(ch);
         for (auto s = 0; s < numSamples; ++s)
             samples[s] = mAll[s] * depthV;
-        visualizerValues[ch] = mAll[numSamples - 1];
     }
 #else
     const auto feedback = static_cast<double>(params(modSys6::PID::Feedback).getValSumDenorm());
     const auto dampHz = static_cast<double>(params(modSys6::PID::Damp).getValSumDenorm());
-    vibrat
-    (
-        buffer.getArrayOfWritePointers(),
-        numChannels,
-        numSamples,
-        modsBuf,
-        depthBuf,
-        feedback,
-        dampHz,
-        osEnabled ? vibrato::InterpolationType::Lerp : vibrato::InterpolationType::Spline,
-        lookaheadEnabled
-    );
-#endif
+    auto samples = buffer.getArrayOfWritePointers();
 
-#if OversamplingEnabled && !DebugModsBuffer
-    if (osEnabled)
-        oversampling.downsample(bufferAll);
+    if (enginePrepared == vibrato::EngineType::Allpass)
+    {
+        // the cascade processes all channels at once, so only the downsampling is split up
+        vibratAllpass(samples, numChannels, numSamples, modsBuf, feedback, dampHz);
+        if (osEnabled)
+        {
+            if (forking)
+                forkJoin(bufferAll.getNumChannels(), [&](int ch)
+                {
+                    oversampling.downsampleChannel(bufferAll, ch);
+                });
+            else
+                oversampling.downsample(bufferAll);
+        }
+        return;
+    }
+
+    const auto interpolationType = osEnabled ? vibrato::InterpolationType::Lerp : vibrato::InterpolationType::Spline;
+    vibrat.setNumVoices(numVoices.load());
+
+    if (!forking)
+    {
+        vibrat(samples, numChannels, numSamples, modsBuf, depthBuf, feedback, dampHz, interpolationType, lookaheadEnabled);
+        if (osEnabled)
+            oversampling.downsample(bufferAll);
+        return;
+    }
+
+    vibrat.prepareBlock(numSamples, depthBuf, feedback, dampHz, lookaheadEnabled);
+
+    // every channel is vibrated and downsampled on the same thread,
+    // sidechain channels only need to be downsampled
+    const auto numChannelsAll = osEnabled ? bufferAll.getNumChannels() : numChannels;
+    forkJoin(numChannelsAll, [&](int ch)
+    {
+        if (ch < numChannels)
+            vibrat.processChannel
+            (
+                samples[ch],
+                ch,
+                numSamples,
+                modsBuf[ch],
+                depthBuf,
+                interpolationType,
+                lookaheadEnabled
+            );
+        if (osEnabled)
+            oversampling.downsampleChannel(bufferAll, ch);
+    });
 #endif
 }
 
+Nel19AudioProcessor::AudioBufferD& Nel19AudioProcessor::upsampleWet(AudioBufferD& bufferAll) noexcept
+{
+    auto& buffer = oversampling.prepareUpsample(bufferAll);
+    if (!oversampling.isEnabled())
+        return buffer;
+    if (forkJoin.isForking())
+        forkJoin(bufferAll.getNumChannels(), [&](int ch)
+        {
+            oversampling.upsampleChannel(bufferAll, ch);
+        });
+    else
+        oversampling.upsample(bufferAll);
+    return buffer;
+}
+
+void Nel19AudioProcessor::skipWet(AudioBufferD& bufferAll, const MidiBuffer& midi, bool feed,
+    bool lookaheadEnabled) noexcept
+{
+    // the modulators still advance and follow the input, so they continue seamlessly once the wet signal is needed again.
+    // if feed, the input keeps going into the delays as well. otherwise it's silent, but the upsampled buffer isn't
+    auto& buffer = feed ? upsampleWet(bufferAll) : oversampling.prepareUpsample(bufferAll);
+    if (!feed && oversampling.isEnabled())
+        buffer.clear();
+    sidechain.setBufferUpsampled(&buffer);
+
+    const auto numChannels = sidechain.numChannels;
+    const auto numSamples = buffer.getNumSamples();
+    forkJoin(NumActiveMods, [&](int m)
+    {
+        processModulator(m, false, midi, numChannels, numSamples);
+    });
+    if (feed && enginePrepared == vibrato::EngineType::Delay)
+        vibrat.feed(buffer.getArrayOfReadPointers(), numChannels, numSamples, lookaheadEnabled);
+    telemetry.skipModulation(numSamples);
+}
+
+void Nel19AudioProcessor::resetWet() noexcept
+{
+    vibrat.reset();
+    vibratAllpass.reset();
+    oversampling.reset();
+}
+
+void Nel19AudioProcessor::processModulator(int m, bool active, const MidiBuffer& midi, int numChannels, int numSamples) noexcept
+{
+    using namespace modSys6;
+    // modulators follow the edges of the layout, whatever lies in between is spread later
+    const auto numChannelsSC = sidechain.enabled ? sidechain.numChannelsSC : numChannels;
+    const double* samplesMainRead[dsp::NumModChannels] =
+    {
+        sidechain.samplesMainReadUpsampled[0],
+        sidechain.samplesMainReadUpsampled[numChannels - 1]
+    };
+    const double* samplesSCRead[dsp::NumModChannels] =
+    {
+        sidechain.samplesSCReadUpsampled[0],
+        sidechain.samplesSCReadUpsampled[numChannelsSC - 1]
+    };
+
+    auto& mod = modulators[m];
+    const auto type = modTypeActive[m];
+    mod.setType(type);
+    const auto offset = m * NumParamsPerMod;
+
+    switch (type)
+    {
+    case vibrato::ModType::AudioRate:
+        mod.setParametersAudioRate
+        (
+            params(withOffset(PID::AudioRate0Oct, offset)).getValSumDenorm(),
+            params(withOffset(PID::AudioRate0Semi, offset)).getValSumDenorm(),
+            params(withOffset(PID::AudioRate0Fine, offset)).getValSumDenorm(),
+            params(withOffset(PID::AudioRate0Width, offset)).getValSumDenorm(),
+            params(withOffset(PID::AudioRate0RetuneSpeed, offset)).getValSumDenorm(),
+            params(withOffset(PID::AudioRate0Atk, offset)).getValSumDenorm(),
+            params(withOffset(PID::AudioRate0Dcy, offset)).getValSumDenorm(),
+            params(withOffset(PID::AudioRate0Sus, offset)).getValSumDenorm(),
+            params(withOffset(PID::AudioRate0Rls, offset)).getValSumDenorm()
+        );
+        break;
+    case vibrato::ModType::Perlin:
+        mod.setParametersPerlin
+        (
+            static_cast<double>(params(withOffset(PID::Perlin0RateHz, offset)).getValSumDenorm()),
+            static_cast<double>(params(withOffset(PID::Perlin0RateBeats, offset)).getValSumDenorm()),
+            static_cast<double>(params(withOffset(PID::Perlin0Octaves, offset)).getValSumDenorm()),
+            static_cast<double>(params(withOffset(PID::Perlin0Width, offset)).getValSumDenorm()),
+            static_cast<double>(params(withOffset(PID::Perlin0Phase, offset)).getValSumDenorm()),
+            static_cast<double>(params(withOffset(PID::Perlin0Bias, offset)).getValueSum()),
+            perlin2::Shape(std::round(params(withOffset(PID::Perlin0Shape, offset)).getValSumDenorm())),
+            params(withOffset(PID::Perlin0RateType, offset)).getValueSum() > .5f
+        );
+        break;
+    case vibrato::ModType::EnvFol:
+        mod.setParametersEnvFol
+        (
+            params(withOffset(PID::EnvFol0Attack, offset)).getValSumDenorm(),
+            params(withOffset(PID::EnvFol0Release, offset)).getValSumDenorm(),
+            params(withOffset(PID::EnvFol0Gain, offset)).getValSumDenorm(),
+            params(withOffset(PID::EnvFol0Width, offset)).getValueSum(),
+            params(withOffset(PID::EnvFol0SC, offset)).getValueSum() > .5f,
+				params(withOffset(PID::EnvFol0HighPass, offset)).getValSumDenorm()
+        );
+        break;
+    case vibrato::ModType::Macro:
+        mod.setParametersMacro
+        (
+            params(withOffset(PID::Macro0, offset)).getValSumDenorm(),
+            params(withOffset(PID::Macro0Smooth, offset)).getValSumDenorm(),
+				params(withOffset(PID::Macro0SCGain, offset)).getValSumDenorm()
+        );
+        break;
+    case vibrato::ModType::Pitchwheel:
+        mod.setParametersPitchbend
+        (
+            params(withOffset(PID::Pitchbend0Smooth, offset)).getValSumDenorm()
+        );
+        break;
+    case vibrato::ModType::LFO:
+        mod.setParametersLFO
+        (
+            params(withOffset(PID::LFO0FreeSync, offset)).getValueSum() > .5f,
+            params(withOffset(PID::LFO0RateFree, offset)).getValSumDenorm(),
+            params(withOffset(PID::LFO0RateSync, offset)).getValSumDenorm(),
+            params(withOffset(PID::LFO0Waveform, offset)).getValueSum(),
+            params(withOffset(PID::LFO0Phase, offset)).getValSumDenorm(),
+            params(withOffset(PID::LFO0Width, offset)).getValSumDenorm()
+        );
+        break;
+    }
+
+    if (active)
+        mod.processBlock
+        (
+            samplesMainRead,
+            samplesSCRead,
+            midi,
+            standalonePlayHead.posInfo,
+            numChannels,
+            numSamples
+        );
+    else
+        mod.skip
+        (
+            samplesMainRead,
+            samplesSCRead,
+            midi,
+            standalonePlayHead.posInfo,
+            numChannels,
+            numSamples
+        );
+}
+
 void Nel19AudioProcessor::processBlockBypassed(AudioBufferD& buffer, MidiBuffer&)
 {
     juce::ScopedNoDenormals noDenormals;
     const auto numSamples = buffer.getNumSamples();
+    morph(params, numSamples, true);
     params.processMacros();
     if (numSamples == 0)
         return;
@@ -512,13 +799,24 @@ juce::AudioProcessorEditor* Nel19AudioProcessor::createEditor()
 
 void Nel19AudioProcessor::getStateInformation(juce::MemoryBlock& destData)
 {
-    savePatch();
+    // hosts ask for the state on every autosave and undo snapshot,
+    // so only serialize again if something changed since last time
+    if (params.dirty.exchange(false) || stateChunk.isEmpty())
+    {
+        savePatch();
+        stateChunk.reset();
+        {
+            juce::MemoryOutputStream stream(stateChunk, false);
+            stream.writeInt(StateMagic);
+            stream.writeInt(StateVersion);
+            params.state.writeToStream(stream);
+        }
 #if RemoveValueTree
-    modSys.state.removeAllChildren(nullptr);
-    modSys.state.removeAllProperties(nullptr);
+        modSys.state.removeAllChildren(nullptr);
+        modSys.state.removeAllProperties(nullptr);
 #endif
-    std::unique_ptr<juce::XmlElement> xml(params.state.createXml());
-    copyXmlToBinary(*xml, destData);
+    }
+    destData = stateChunk;
 }
 
 void Nel19AudioProcessor::savePatch()
@@ -543,15 +841,40 @@ void Nel19AudioProcessor::savePatch()
     for (auto m = 0; m < NumActiveMods; ++m)
         modulators[m].savePatch(params.state, m);
     
+    params.state.setProperty("lookaheadAdaptive", lookaheadAdaptive, nullptr);
+    params.state.setProperty("parallelNonRealtime", parallelNonRealtime, nullptr);
+    params.state.setProperty("parallelRealtime", parallelRealtime, nullptr);
+    params.state.setProperty("cacheCurves", cacheCurves, nullptr);
+    params.state.setProperty("engine", vibrato::toString(engine), nullptr);
+    params.state.setProperty("voices", numVoices.load(), nullptr);
     params.state.setProperty("firstTimeUwU", false, nullptr);
 }
 
 void Nel19AudioProcessor::setStateInformation(const void* data, int sizeInBytes)
 {
-    std::unique_ptr<juce::XmlElement> xmlState(getXmlFromBinary(data, sizeInBytes));
-    if (xmlState.get() != nullptr)
-        if (xmlState->hasTagName(params.state.getType()))
-            params.state = juce::ValueTree::fromXml(*xmlState);
+    bool isBinary = false;
+    if (sizeInBytes > 8)
+    {
+        juce::MemoryInputStream stream(data, static_cast<size_t>(sizeInBytes), false);
+        if (stream.readInt() == StateMagic)
+        {
+            isBinary = true;
+            const auto version = stream.readInt();
+            if (version <= StateVersion)
+            {
+                const auto state = juce::ValueTree::readFromStream(stream);
+                if (state.hasType(params.state.getType()))
+                    params.state = state;
+            }
+        }
+    }
+    if (!isBinary)
+    { // IMPORT SESSIONS SAVED BEFORE THE BINARY FORMAT
+        std::unique_ptr<juce::XmlElement> xmlState(getXmlFromBinary(data, sizeInBytes));
+        if (xmlState.get() != nullptr)
+            if (xmlState->hasTagName(params.state.getType()))
+                params.state = juce::ValueTree::fromXml(*xmlState);
+    }
     loadPatch();
 #if RemoveValueTree
     modSys.state.removeAllChildren(nullptr);
@@ -562,30 +885,168 @@ void Nel19AudioProcessor::setStateInformation(const void* data, int sizeInBytes)
 void Nel19AudioProcessor::loadPatch()
 {
     suspendProcessing(true);
+    // the patch replaces whatever a preset switch was heading for
+    morph.reset();
+    presetRebuild = presetNotifyPending = presetLatchPending = false;
     params.loadPatch();
+    modType = decodeModTypes(params.state);
+    loadSettings();
+
+    // make the modulated values of the new patch visible before comparing the engine's configuration
+    params.processMacros();
+    if (needsPrepare())
+        prepareToPlay(getSampleRate(), getBlockSize());
+    markStateDirty();
+    suspendProcessing(false);
+}
+
+std::array<vibrato::ModType, Nel19AudioProcessor::NumActiveMods> Nel19AudioProcessor::decodeModTypes(const juce::ValueTree& state) const
+{
+    auto types = modType;
+    const auto modTypeID = vibrato::toString(vibrato::ObjType::ModType);
+    const auto modTypeState = state.getChildWithName(modTypeID);
+    if (!modTypeState.isValid())
+        return types;
+    for (auto m = 0; m < NumActiveMods; ++m)
     {
-        const auto modTypeID = vibrato::toString(vibrato::ObjType::ModType);
-        const auto modTypeState = params.state.getChildWithName(modTypeID);
-        if (modTypeState.isValid())
+        const auto propID = modTypeID + static_cast<String>(m);
+        const auto typeProp = modTypeState.getProperty(propID).toString();
+        for (auto i = 0; i < static_cast<int>(vibrato::ModType::NumMods); ++i)
         {
-            for (auto m = 0; m < NumActiveMods; ++m)
-            {
-                const auto propID = modTypeID + static_cast<String>(m);
-                const auto typeProp = modTypeState.getProperty(propID).toString();
-                for (auto i = 0; i < static_cast<int>(vibrato::ModType::NumMods); ++i)
-                {
-                    const auto type = static_cast<vibrato::ModType>(i);
-                    if (typeProp == vibrato::toString(type))
-                        modType[m] = type;
-                }
-            }
+            const auto type = static_cast<vibrato::ModType>(i);
+            if (typeProp == vibrato::toString(type))
+                types[m] = type;
         }
     }
+    return types;
+}
+
+void Nel19AudioProcessor::loadSettings()
+{
+    // nothing would pick up a wavetable imported in the background while rendering offline,
+    // and setStateInformation may not even be called on the message thread then
     for (auto m = 0; m < modulators.size(); ++m)
+        modulators[m].loadPatch(params.state, m, isNonRealtime());
+
+    lookaheadAdaptive = static_cast<bool>(params.state.getProperty("lookaheadAdaptive", false));
+    parallelNonRealtime = static_cast<bool>(params.state.getProperty("parallelNonRealtime", true));
+    parallelRealtime = static_cast<bool>(params.state.getProperty("parallelRealtime", false));
+    cacheCurves = static_cast<bool>(params.state.getProperty("cacheCurves", false));
+    engine = vibrato::toEngineType(params.state.getProperty("engine", vibrato::toString(vibrato::EngineType::Delay)).toString());
+    numVoices.store(juce::jlimit(1, vibrato::MaxNumVoices, static_cast<int>(params.state.getProperty("voices", 1))));
+    latchLookahead();
+}
+
+void Nel19AudioProcessor::switchPreset(const juce::ValueTree& state, double lengthMs)
+{
+    modSys6::Snapshot snapshot;
+    snapshot.decode(params, state);
+    postPreset(state, snapshot, snapshot, lengthMs);
+}
+
+void Nel19AudioProcessor::morphPresets(const juce::ValueTree& a, const juce::ValueTree& b, double lengthMs)
+{
+    modSys6::Snapshot snapshotA, snapshotB;
+    snapshotA.decode(params, a);
+    snapshotB.decode(params, b);
+    // what only a rebuild can change comes from a
+    using PID = modSys6::PID;
+    for (const auto pID : { PID::HQ, PID::Lookahead, PID::BufferSize })
+    {
+        const auto p = static_cast<int>(pID);
+        snapshotB.values[p] = snapshotA.values[p];
+    }
+    postPreset(a, snapshotA, snapshotB, lengthMs);
+}
+
+void Nel19AudioProcessor::setPresetMorph(float x) noexcept
+{
+    morph.setPosition(x);
+}
+
+bool Nel19AudioProcessor::needsRebuild(const juce::ValueTree& state, const modSys6::Snapshot& snapshot)
+{
+    using PID = modSys6::PID;
+    for (const auto pID : { PID::HQ, PID::Lookahead, PID::BufferSize })
+        if (snapshot.values[static_cast<int>(pID)] != params(pID).getValue())
+            return true;
+
+    if (lookaheadAdaptive != static_cast<bool>(state.getProperty("lookaheadAdaptive", false))
+        || parallelNonRealtime != static_cast<bool>(state.getProperty("parallelNonRealtime", true))
+        || parallelRealtime != static_cast<bool>(state.getProperty("parallelRealtime", false))
+        || cacheCurves != static_cast<bool>(state.getProperty("cacheCurves", false))
+        || engine != vibrato::toEngineType(state.getProperty("engine", vibrato::toString(vibrato::EngineType::Delay)).toString()))
+        return true;
+
+    // wavetables and seeds are swapped while the audio keeps running, see postPreset
+    return false;
+}
+
+void Nel19AudioProcessor::postPreset(const juce::ValueTree& state, const modSys6::Snapshot& a,
+    const modSys6::Snapshot& b, double lengthMs)
+{
+    if (getSampleRate() <= 0.)
+    { // NOTHING PLAYS YET, SO THERE IS NOTHING TO GLIDE
+        params.state = state;
+        return loadPatch();
+    }
+
+    presetRebuild = needsRebuild(state, a);
+    const auto types = decodeModTypes(state);
+    // a switch that still waits for its rebuild stays structural, the rebuild picks up this patch instead
+    const auto structural = presetRebuild || types != modType || morph.isStructural();
+    if (!presetNotifyPending)
+    {
+        presetNotified.capture(params);
+        presetNotifyPending = true;
+    }
+    morph.post(a, b, lengthMs, structural);
+    presetPostedMs = juce::Time::getMillisecondCounter();
+    if (structural)
+        startTimer(PresetTimerMs);
+
+    params.state = state;
+    // the editor shows the new mod types right away, the audio thread switches to them once the wet signal faded out
+    modType = types;
+    numVoices.store(juce::jlimit(1, vibrato::MaxNumVoices, static_cast<int>(state.getProperty("voices", 1))));
+    // wavetables swap atomics and seeds generate their noise right here. the audio thread picks both up on its next block
+    for (auto m = 0; m < NumActiveMods; ++m)
         modulators[m].loadPatch(params.state, m);
-    
-    prepareToPlay(getSampleRate(), getBlockSize());
-    suspendProcessing(false);
+    // the lookahead latches the depth the glide arrives at
+    presetLatchPending = true;
+    markStateDirty();
+}
+
+void Nel19AudioProcessor::rebuildEngine()
+{
+    if (presetRebuild)
+    { // THE WET SIGNAL IS SILENT, BUT THE DRY ONE DROPS OUT WHILE PROCESSING IS SUSPENDED
+        suspendProcessing(true);
+        loadSettings();
+        // the stepped parameters of the new patch are in place already
+        params.processMacros();
+        if (needsPrepare())
+            prepareToPlay(getSampleRate(), getBlockSize());
+        presetRebuild = false;
+        morph.release();
+        suspendProcessing(false);
+    }
+    else
+        morph.release();
+    markStateDirty();
+}
+
+void Nel19AudioProcessor::notifyPreset()
+{
+    // the host only hears about the parameters once they arrived, and only about the ones that changed
+    for (auto p = 0; p < modSys6::NumParams; ++p)
+    {
+        auto& param = params(p);
+        const auto val = param.getValue();
+        if (val != presetNotified.values[p])
+            param.sendValueChangedMessageToListeners(val);
+    }
+    presetNotifyPending = false;
 }
 
 juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
@@ -595,6 +1056,39 @@ juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
 
 void Nel19AudioProcessor::timerCallback()
 {
+    if (morph.isHolding())
+        rebuildEngine();
+    else if (morph.isPending())
+    {
+        if (juce::Time::getMillisecondCounter() - presetPostedMs > PresetTimeoutMs)
+            loadPatch();
+    }
+    else if (needsPrepare())
+        forcePrepare();
+
+    if (morph.hasSettled())
+    {
+        notifyPreset();
+        if (presetLatchPending)
+        { // THE SETTINGS THAT DEPEND ON WHERE THE PARAMETERS ARRIVED
+            presetLatchPending = false;
+            latchLookahead();
+            if (needsPrepare())
+                forcePrepare();
+        }
+    }
+
+    // a structural switch waits for this, so it's checked more often while one is pending
+    const auto intervalMs = morph.isStructural() ? PresetTimerMs : 1000 / 4;
+    if (getTimerInterval() != intervalMs)
+        startTimer(intervalMs);
+}
+
+bool Nel19AudioProcessor::needsPrepare() const
+{
+    if (getSampleRate() <= 0.)
+        return false;
+
     using PID = modSys6::PID;
 #if OversamplingEnabled && !DebugModsBuffer
     const bool oversamplingChanged = (params(PID::HQ).getValueSum() > .5f) != oversampling.isEnabled();
@@ -602,26 +1096,46 @@ void Nel19AudioProcessor::timerCallback()
 	const bool oversamplingChanged = false;
 #endif
 	const auto bufferSize = static_cast<int>(std::round(params(PID::BufferSize).getValSumDenorm()));
-    const auto bufferSizeVibrato = static_cast<int>(std::round(vibrat.getSizeInMs(oversampling.getSampleRateUpsampled())));
+    // the allpass engine is always prepared with the full buffer size, whichever engine is selected
+    const auto bufferSizeVibrato = static_cast<int>(std::round(vibratAllpass.getSizeInMs(oversampling.getSampleRateUpsampled())));
     //DBG(bufferSize << " :: " << bufferSizeVibrato);
     const bool bufferSizeChanged = bufferSize != bufferSizeVibrato;
     
     const auto curLatency = getLatencySamples();
     const auto latencyWithoutOversampling = curLatency - oversampling.getLatency();
     const auto hasLatency = latencyWithoutOversampling != 0;
-    const bool lookaheadChanged = (params(PID::Lookahead).getValueSum() > .5f) != hasLatency;
+    const auto delayEngine = enginePrepared == vibrato::EngineType::Delay;
+    const bool lookaheadChanged = (delayEngine && params(PID::Lookahead).getValueSum() > .5f) != hasLatency;
+    const bool engineChanged = engine != enginePrepared;
+    const bool parallelRealtimeChanged = parallelRealtime != forkJoin.isRealtimePriority();
+    const bool cacheCurvesChanged = cacheCurves != modulators[0].isCacheEnabled();
+    // the latched depth only matters to the lookahead in adaptive mode
+    const bool lookaheadAdaptiveChanged = lookaheadAdaptive != lookaheadAdaptivePrepared
+        || (lookaheadAdaptive && lookaheadDepth != lookaheadDepthPrepared);
     
-    if (oversamplingChanged || lookaheadChanged || bufferSizeChanged)
-        forcePrepare();
+    return oversamplingChanged || lookaheadChanged || bufferSizeChanged || lookaheadAdaptiveChanged || engineChanged
+        || parallelRealtimeChanged || cacheCurvesChanged;
 }
 
 void Nel19AudioProcessor::forcePrepare()
 {
     suspendProcessing(true);
+    latchLookahead();
 	prepareToPlay(getSampleRate(), getBlockSize());
 	suspendProcessing(false);
 }
 
+void Nel19AudioProcessor::markStateDirty() noexcept
+{
+    params.dirty.store(true);
+    stateGeneration.fetch_add(1, std::memory_order_release);
+}
+
+void Nel19AudioProcessor::latchLookahead()
+{
+    lookaheadDepth = params(modSys6::PID::Depth).getValueMax();
+}
+
 #undef RemoveValueTree
 #undef OversamplingEnabled
 #undef DebugModsBuffer
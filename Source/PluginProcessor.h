@@ -75,12 +75,21 @@ ich studiere.
 #include "dsp/MidSideEncoder.h"
 #include "dsp/Modulator.h"
 #include "dsp/Vibrato.h"
+#include "dsp/AllpassVibrato.h"
 #include "dsp/PRM.h"
 #include "oversampling/Oversampling.h"
 #include <JuceHeader.h>
 #include "modsys/ModSys.h"
+#include "modsys/Morph.h"
 #include "BenchmarkProcessBlock.h"
 #include "dsp/Sidechain.h"
+#include "dsp/Telemetry.h"
+#include "dsp/ForkJoin.h"
+#include "dsp/Silence.h"
+#include "dsp/Arena.h"
+#include "dsp/Channels.h"
+#include "dsp/RealtimeSanitizer.h"
+#include <atomic>
 #include <limits>
 
 struct Nel19AudioProcessor :
@@ -100,6 +109,20 @@ struct Nel19AudioProcessor :
     using PRMInfo = dsp::PRMInfo<double>;
     using PID = modSys6::PID;
     static constexpr int NumActiveMods = 2;
+    // scratch arena stages in the order a block runs through them
+    static constexpr int StageModulators = 0;
+    static constexpr int StageVibrato = StageModulators + NumActiveMods;
+    // "NEL1", precedes the binary state chunk so it can't be confused with juce's xml chunks
+    static constexpr int StateMagic = 0x4e454c31;
+    static constexpr int StateVersion = 1;
+    // how long a preset switch glides, long enough to not click
+    static constexpr double PresetGlideMs = 20.;
+    // a switch the audio thread didn't pick up in time is loaded the old way, f.ex. without an audio device
+    static constexpr juce::uint32 PresetTimeoutMs = 1000;
+    // how often the message thread checks if a structural switch is ready for its rebuild
+    static constexpr int PresetTimerMs = 1000 / 30;
+    // bytes of midi a slice of an oversized block can hold without allocating
+    static constexpr int MidiSliceBytes = 2048;
     
     bool supportsDoublePrecisionProcessing() const override
     {
@@ -111,6 +134,9 @@ struct Nel19AudioProcessor :
     
     void prepareToPlay(double sampleRate, int samplesPerBlock) override;
     void releaseResources() override;
+#if NEL_AUDIO_WORKGROUP
+    void audioWorkgroupContextChanged(const juce::AudioWorkgroup&) override;
+#endif
    #ifndef JucePlugin_PreferredChannelConfigurations
     bool isBusesLayoutSupported(const BusesLayout&) const override;
    #endif
@@ -136,18 +162,33 @@ struct Nel19AudioProcessor :
     void setStateInformation (const void*, int) override;
     void savePatch();
     void loadPatch();
+    /* state, lengthMs. message thread. glides to the patch while the audio keeps running,
+    unless the patch needs a different engine. its rebuild suspends processing for a moment, see modSys6::Morph */
+    void switchPreset(const juce::ValueTree&, double = PresetGlideMs);
+    /* a, b, lengthMs. message thread. morphs between two patches with the engine of a, see setPresetMorph */
+    void morphPresets(const juce::ValueTree&, const juce::ValueTree&, double = PresetGlideMs);
+    /* x[0,1], any thread. 0 is a, 1 is b */
+    void setPresetMorph(float) noexcept;
     juce::PropertiesFile::Options makeOptions();
     void forcePrepare();
+    bool needsPrepare() const;
+    void markStateDirty() noexcept;
+    /* only call this on explicit user actions, so that hosts don't get latency churn */
+    void latchLookahead();
     
     bool canAddBus(bool) const override;
 
     BusesProps makeBusesProps();
 
+    // declared first, so that it outlives the buffers that live in it
+    dsp::Arena arena;
     dsp::Sidechain sidechain;
 
     juce::ApplicationProperties appProperties;
     dsp::StandalonePlayHead standalonePlayHead;
-    AudioBufferD audioBufferD;
+    dsp::ScratchBuffer<double> audioBufferD;
+    // the events of the current slice, if the host sends more samples than it prepared for
+    juce::MidiBuffer midiSlice;
 
     drywet::Processor dryWet;
 
@@ -156,16 +197,64 @@ struct Nel19AudioProcessor :
     oversampling::OversamplerWithShelf oversampling;
     
     std::array<vibrato::Modulator, NumActiveMods> modulators;
-    AudioBufferD modsBuffer;
+    dsp::ScratchBuffer<double> modsBuffer;
     std::array<vibrato::ModType, NumActiveMods> modType;
     
     vibrato::Processor vibrat;
+    vibrato::AllpassProcessor vibratAllpass;
     
-    std::array<double, 2> visualizerValues;
+    // written by the audio thread, read by the editor
+    dsp::Telemetry telemetry;
+    // lookahead only compensates the delay swing the latched depth can reach
+    bool lookaheadAdaptive;
+    // splits channels and modulators across threads while the host renders offline
+    bool parallelNonRealtime;
+    // saved with the patch, does the same in realtime. for high channel counts at high sample rates
+    bool parallelRealtime;
+    // saved with the patch, lfo and perlin copy their curves on later passes of a loop
+    bool cacheCurves;
+    // saved with the patch, takes effect on the next prepare
+    vibrato::EngineType engine;
+    // saved with the patch, the delay engine turns into a chorus with more than one voice
+    std::atomic<int> numVoices;
+    // moves whenever markStateDirty does, so the editor only rereads the mod types and settings then
+    std::atomic<unsigned> stateGeneration;
 private:
     PRM depth, modsMix;
-
+    float lookaheadDepth, lookaheadDepthPrepared;
+    bool lookaheadAdaptivePrepared;
+    vibrato::EngineType enginePrepared;
+    juce::MemoryBlock stateChunk;
+    // the block size the scratch buffers were prepared for, larger blocks are processed in slices
+    int maxBlockSize;
+    // where the channels of the main bus sit in a modulation's width, by their speakers
+    dsp::ChannelPositions channelPositions;
+    dsp::ForkJoin forkJoin;
+    dsp::SilenceDetector silence;
+    // the wet chain was skipped in the last block because the mix was dry
+    bool wetBypassed;
+    // preset switches, decoded on the message thread and interpolated on the audio thread
+    modSys6::Morph morph;
+    // the values the host was told about last
+    modSys6::Snapshot presetNotified;
+    // the mod types the audio thread uses. they follow modType, unless a switch waits for the wet signal to fade out
+    std::array<vibrato::ModType, NumActiveMods> modTypeActive;
+    juce::uint32 presetPostedMs;
+    bool presetRebuild, presetNotifyPending, presetLatchPending;
+
+    void processBlockSlice(AudioBufferD&, const juce::MidiBuffer&) noexcept;
+    const juce::MidiBuffer& sliceMidi(const juce::MidiBuffer&, int, int) noexcept;
     void processBlockVibrato(AudioBufferD&, const juce::MidiBuffer&, bool) noexcept;
+    AudioBufferD& upsampleWet(AudioBufferD&) noexcept;
+    void skipWet(AudioBufferD&, const juce::MidiBuffer&, bool, bool) noexcept;
+    void resetWet() noexcept;
+    void processModulator(int, bool, const juce::MidiBuffer&, int, int) noexcept;
+    std::array<vibrato::ModType, NumActiveMods> decodeModTypes(const juce::ValueTree&) const;
+    void loadSettings();
+    bool needsRebuild(const juce::ValueTree&, const modSys6::Snapshot&);
+    void postPreset(const juce::ValueTree&, const modSys6::Snapshot&, const modSys6::Snapshot&, double);
+    void rebuildEngine();
+    void notifyPreset();
     void timerCallback() override;
 };
 
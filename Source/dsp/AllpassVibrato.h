@@ -0,0 +1,175 @@
+#pragma once
+#include <juce_dsp/juce_dsp.h>
+#include <array>
+#include "Vibrato.h"
+
+namespace vibrato
+{
+	/*
+	vibrato from a cascade of first order allpass filters with modulated coefficients.
+	an allpass delays low frequencies depending on its coefficient, so modulating it bends the pitch
+	like a modulated delay does, but without a ring buffer and without lookahead.
+	the delay gets shorter towards nyquist, which gives it a slightly phasey character.
+	channels are processed side by side in the lanes of a SIMD register.
+	*/
+	struct AllpassProcessor
+	{
+		using Vec = juce::dsp::SIMDRegister<double>;
+		static constexpr int Lanes = static_cast<int>(Vec::SIMDNumElements);
+		static constexpr int MaxNumChannels = dsp::MaxNumChannels;
+		static constexpr int NumGroups = (MaxNumChannels + Lanes - 1) / Lanes;
+		static constexpr int NumStages = 16;
+		// the whole cascade reaches 4ms, longer delays would only smear the highs
+		static constexpr double MaxStageDelayMs = .25;
+		// a stage with no delay at all would have its pole on the unit circle
+		static constexpr double MinStageDelay = .05;
+
+		AllpassProcessor() :
+			feedbackPRM(0.),
+			dampPRM(1.),
+			lp(),
+			states(),
+			lpStates(),
+			outs(),
+			fsInv(1.),
+			stageDelayMax(1.),
+			size(0)
+		{
+			reset();
+		}
+
+		/* Fs, blockSize, delaySize */
+		void prepare(double Fs, int blockSize, int _delaySize)
+		{
+			size = _delaySize;
+			fsInv = 1. / Fs;
+			const auto stageDelayLimit = MaxStageDelayMs * .001 * Fs;
+			const auto stageDelay = static_cast<double>(size) / static_cast<double>(NumStages);
+			stageDelayMax = juce::jmax(MinStageDelay * 2., juce::jmin(stageDelay, stageDelayLimit));
+			feedbackPRM.prepare(Fs, blockSize, 8.);
+			dampPRM.prepare(Fs, blockSize, 13.);
+			reset();
+		}
+
+		void reset() noexcept
+		{
+			for (auto& group : states)
+				for (auto& state : group)
+					state = Vec::expand(0.);
+			for (auto& state : lpStates)
+				state = Vec::expand(0.);
+			for (auto& out : outs)
+				out = Vec::expand(0.);
+		}
+
+		/* samples, numChannels, numSamples, vibBuf[-1,1], feedback[0,1], dampHz[1, N]
+		vibBuf is overwritten with the allpass coefficients */
+		void operator()(double* const* samples, int numChannels, int numSamples,
+			double* const* vibBuf, double feedback, double dampHz) noexcept
+		{
+			const auto fbInfo = feedbackPRM(feedback, numSamples);
+			if (!fbInfo.smoothing)
+				juce::FloatVectorOperations::fill(fbInfo.buf, feedback, numSamples);
+			const auto dampInfo = dampPRM(dampHz * fsInv, numSamples);
+			if (!dampInfo.smoothing)
+				lp.makeFromDecayInFc(dampInfo.val);
+
+			for (auto ch = 0; ch < numChannels; ++ch)
+				synthesizeCoefficients(vibBuf[ch], numSamples);
+
+			for (auto g = 0; g * Lanes < numChannels; ++g)
+			{
+				const auto ch0 = g * Lanes;
+				const auto numLanes = juce::jmin(Lanes, numChannels - ch0);
+				processGroup(samples, vibBuf, g, ch0, numLanes, numSamples, fbInfo, dampInfo);
+			}
+		}
+
+		double getSizeInMs(double Fs) const noexcept
+		{
+			return 1000. * static_cast<double>(size) / Fs;
+		}
+
+		/* the longest delay the cascade reaches at low frequencies, in samples */
+		double getMaxDelay() const noexcept
+		{
+			return stageDelayMax * static_cast<double>(NumStages);
+		}
+
+		/* bytes of state, without the parameter smoothing buffers every engine has */
+		size_t getMemoryUsage() const noexcept
+		{
+			return sizeof(*this);
+		}
+
+	protected:
+		PRM feedbackPRM, dampPRM;
+		LP lp;
+		std::array<std::array<Vec, NumStages>, NumGroups> states;
+		std::array<Vec, NumGroups> lpStates, outs;
+		double fsInv, stageDelayMax;
+		int size;
+
+		/* buf[-1,1] to coefficients.
+		a stage delays the lows by (1 - a) / (1 + a) samples */
+		void synthesizeCoefficients(double* buf, int numSamples) noexcept
+		{
+			const auto halfRange = stageDelayMax * .5;
+			for (auto s = 0; s < numSamples; ++s)
+			{
+				const auto d = juce::jmax(MinStageDelay, (buf[s] + 1.) * halfRange);
+				buf[s] = (1. - d) / (1. + d);
+			}
+		}
+
+		static Vec load(const double* const* bufs, int ch0, int numLanes, int s) noexcept
+		{
+			auto v = Vec::expand(0.);
+			for (auto l = 0; l < numLanes; ++l)
+				v.set(static_cast<size_t>(l), bufs[ch0 + l][s]);
+			return v;
+		}
+
+		static void store(double* const* bufs, const Vec& v, int ch0, int numLanes, int s) noexcept
+		{
+			for (auto l = 0; l < numLanes; ++l)
+				bufs[ch0 + l][s] = v.get(static_cast<size_t>(l));
+		}
+
+		void processGroup(double* const* samples, const double* const* coefs, int g, int ch0, int numLanes,
+			int numSamples, const PRMInfo& fbInfo, const PRMInfo& dampInfo) noexcept
+		{
+			auto& stages = states[g];
+			auto lpState = lpStates[g];
+			auto out = outs[g];
+			const auto c1 = Vec::expand(1.34908);
+			const auto c3 = Vec::expand(-.405548);
+
+			for (auto s = 0; s < numSamples; ++s)
+			{
+				if (dampInfo.smoothing)
+					lp.makeFromDecayInFc(dampInfo[s]);
+
+				// FEEDBACK, SAME DAMPING AND SATURATION AS THE DELAY ENGINE
+				lpState = out * lp.a0 + lpState * lp.b1;
+				const auto fb = lpState * -fbInfo[s];
+				auto x = load(samples, ch0, numLanes, s) + fb * (c1 + c3 * fb * fb);
+
+				// CASCADE
+				const auto a = load(coefs, ch0, numLanes, s);
+				for (auto& state : stages)
+				{
+					const auto y = a * x + state;
+					state = x - a * y;
+					x = y;
+				}
+
+				out = x;
+				store(samples, out, ch0, numLanes, s);
+			}
+
+			lpStates[g] = lpState;
+			outs[g] = out;
+		}
+	};
+}
@@ -0,0 +1,362 @@
+#pragma once
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace dsp
+{
+	/*
+	one aligned allocation for the scratch buffers of a plugin instance.
+	buffers that are resized while the instance prepares declare a region, and once it's done
+	the arena allocates all of them at once and hands every buffer its piece.
+	a block is processed in stages, f.ex. modulators and then the vibrato. buffers of different stages
+	are never in use at the same time, so all stages start at the same offset and share their memory.
+	buffers outside of an arena (benchmarks, tools..) simply own their memory.
+	*/
+	struct Arena
+	{
+		// enough for a cache line and for any simd register
+		static constexpr size_t Alignment = 64;
+		// used across the whole block, so it never shares its memory
+		static constexpr int Persistent = -1;
+
+		struct Region
+		{
+			Region() :
+				arena(nullptr),
+				numBytes(0),
+				stage(Persistent)
+			{}
+
+			Region(const Region&) :
+				Region()
+			{}
+
+			Region& operator=(const Region&) noexcept
+			{
+				return *this;
+			}
+
+			virtual ~Region()
+			{
+				if (arena != nullptr)
+					arena->remove(*this);
+			}
+
+		protected:
+			/* numBytes, asks the arena that is being prepared for memory.
+			returns false if there is none, in which case the region has to own its memory */
+			bool request(size_t _numBytes)
+			{
+				auto preparing = getPreparing();
+				if (arena != nullptr && arena != preparing)
+					arena->remove(*this);
+				if (preparing == nullptr)
+					return false;
+				numBytes = _numBytes;
+				stage = preparing->stage;
+				preparing->add(*this);
+				return true;
+			}
+
+			/* memory, zeroed, valid until the arena is prepared again */
+			virtual void bind(char*) noexcept = 0;
+
+		private:
+			friend struct Arena;
+			Arena* arena;
+			size_t numBytes;
+			int stage;
+		};
+
+		/* everything that is resized while this exists takes its memory from arena,
+		which is allocated when it goes out of scope */
+		struct Preparing
+		{
+			Preparing(Arena& _arena) :
+				arena(_arena),
+				previous(getPreparing())
+			{
+				getPreparing() = &arena;
+				arena.stage = Persistent;
+			}
+
+			~Preparing()
+			{
+				getPreparing() = previous;
+				arena.commit();
+			}
+
+			Arena& arena;
+			Arena* previous;
+		};
+
+		/* regions declared while this exists belong to stage */
+		struct Stage
+		{
+			Stage(Arena& _arena, int _stage) :
+				arena(_arena),
+				previous(arena.stage)
+			{
+				arena.stage = _stage;
+			}
+
+			~Stage()
+			{
+				arena.stage = previous;
+			}
+
+			Arena& arena;
+			int previous;
+		};
+
+		Arena() :
+			regions(),
+			memory(),
+			capacity(0),
+			workingSet(0),
+			unshared(0),
+			stage(Persistent)
+		{}
+
+		~Arena()
+		{
+			for (auto region : regions)
+				region->arena = nullptr;
+		}
+
+		Arena(const Arena&) = delete;
+		Arena& operator=(const Arena&) = delete;
+
+		/* bytes the buffers of the instance take up */
+		size_t getWorkingSetSize() const noexcept
+		{
+			return workingSet;
+		}
+
+		/* bytes they would take up if no stages shared their memory */
+		size_t getUnsharedSize() const noexcept
+		{
+			return unshared;
+		}
+
+	protected:
+		std::vector<Region*> regions;
+		juce::HeapBlock<char> memory;
+		size_t capacity, workingSet, unshared;
+		int stage;
+
+		static Arena*& getPreparing() noexcept
+		{
+			thread_local Arena* preparing = nullptr;
+			return preparing;
+		}
+
+		static size_t align(size_t numBytes) noexcept
+		{
+			return (numBytes + Alignment - 1) & ~(Alignment - 1);
+		}
+
+		void add(Region& region)
+		{
+			if (region.arena == this)
+				return;
+			region.arena = this;
+			regions.push_back(&region);
+		}
+
+		void remove(Region& region) noexcept
+		{
+			regions.erase(std::remove(regions.begin(), regions.end(), &region), regions.end());
+			region.arena = nullptr;
+		}
+
+		void commit()
+		{
+			// PERSISTENT REGIONS FIRST, THEN THE STAGES ON TOP OF EACH OTHER
+			size_t persistentSize = 0;
+			unshared = 0;
+			for (auto region : regions)
+			{
+				const auto numBytes = align(region->numBytes);
+				unshared += numBytes;
+				if (region->stage == Persistent)
+					persistentSize += numBytes;
+			}
+
+			std::vector<std::pair<int, size_t>> stageEnds;
+			std::vector<size_t> offsets;
+			offsets.reserve(regions.size());
+			workingSet = persistentSize;
+			auto persistentEnd = static_cast<size_t>(0);
+			for (auto region : regions)
+			{
+				const auto numBytes = align(region->numBytes);
+				if (region->stage == Persistent)
+				{
+					offsets.push_back(persistentEnd);
+					persistentEnd += numBytes;
+					continue;
+				}
+				auto stageEnd = std::find_if(stageEnds.begin(), stageEnds.end(), [&](const auto& s)
+				{
+					return s.first == region->stage;
+				});
+				if (stageEnd == stageEnds.end())
+				{
+					stageEnds.push_back({ region->stage, persistentSize });
+					stageEnd = stageEnds.end() - 1;
+				}
+				offsets.push_back(stageEnd->second);
+				stageEnd->second += numBytes;
+				workingSet = std::max(workingSet, stageEnd->second);
+			}
+
+			// only grows, so that preparing again with the same configuration doesn't allocate
+			if (workingSet + Alignment > capacity)
+			{
+				capacity = workingSet + Alignment;
+				memory.allocate(capacity, false);
+			}
+			const auto address = reinterpret_cast<juce::pointer_sized_uint>(memory.get());
+			const auto base = memory.get() + (align(address) - address);
+			std::memset(base, 0, workingSet);
+
+			for (auto r = 0; r < static_cast<int>(regions.size()); ++r)
+				regions[r]->bind(base + offsets[r]);
+		}
+	};
+
+	/* a block sized buffer, f.ex. for parameter smoothing */
+	template<typename T>
+	struct Scratch :
+		public Arena::Region
+	{
+		Scratch() :
+			Region(),
+			owned(),
+			ptr(nullptr),
+			num(0)
+		{}
+
+		Scratch(const Scratch& other) :
+			Region(),
+			owned(other.ptr, other.ptr + other.num),
+			ptr(owned.data()),
+			num(other.num)
+		{}
+
+		Scratch& operator=(const Scratch& other)
+		{
+			if (this != &other)
+			{
+				resize(other.num);
+				std::copy(other.ptr, other.ptr + other.num, ptr);
+			}
+			return *this;
+		}
+
+		/* numElements, call while preparing */
+		void resize(int numElements)
+		{
+			num = numElements;
+			if (request(static_cast<size_t>(num) * sizeof(T)))
+			{
+				owned = {};
+				ptr = nullptr;
+				return;
+			}
+			owned.assign(static_cast<size_t>(num), T());
+			ptr = owned.data();
+		}
+
+		T* data() noexcept { return ptr; }
+		const T* data() const noexcept { return ptr; }
+		T& operator[](int i) noexcept { return ptr[i]; }
+		const T& operator[](int i) const noexcept { return ptr[i]; }
+		int size() const noexcept { return num; }
+
+	protected:
+		std::vector<T> owned;
+		T* ptr;
+		int num;
+
+		void bind(char* memory) noexcept override
+		{
+			ptr = reinterpret_cast<T*>(memory);
+		}
+	};
+
+	/* a multichannel buffer, every channel starts on its own cache line */
+	template<typename Float>
+	struct ScratchBuffer :
+		public Arena::Region
+	{
+		using AudioBuffer = juce::AudioBuffer<Float>;
+		static constexpr int ChannelAlignment = static_cast<int>(Arena::Alignment / sizeof(Float));
+
+		ScratchBuffer() :
+			Region(),
+			owned(),
+			channels(),
+			numChannels(0),
+			numSamples(0),
+			stride(0)
+		{}
+
+		ScratchBuffer(const ScratchBuffer& other) :
+			ScratchBuffer()
+		{
+			setSize(other.numChannels, other.numSamples);
+			for (auto ch = 0; ch < numChannels; ++ch)
+				std::copy(other.channels[ch], other.channels[ch] + numSamples, channels[ch]);
+		}
+
+		ScratchBuffer& operator=(const ScratchBuffer&) = delete;
+
+		/* numChannels, numSamples, call while preparing */
+		void setSize(int _numChannels, int _numSamples)
+		{
+			numChannels = _numChannels;
+			numSamples = _numSamples;
+			stride = (numSamples + ChannelAlignment - 1) / ChannelAlignment * ChannelAlignment;
+			channels.assign(static_cast<size_t>(numChannels), nullptr);
+			const auto numElements = static_cast<size_t>(numChannels * stride);
+			if (request(numElements * sizeof(Float)))
+			{
+				owned = {};
+				return;
+			}
+			owned.assign(numElements, static_cast<Float>(0));
+			bind(reinterpret_cast<char*>(owned.data()));
+		}
+
+		Float* const* getArrayOfWritePointers() noexcept { return channels.data(); }
+		const Float* const* getArrayOfReadPointers() const noexcept { return channels.data(); }
+		Float* getWritePointer(int ch) noexcept { return channels[ch]; }
+		const Float* getReadPointer(int ch) const noexcept { return channels[ch]; }
+		int getNumChannels() const noexcept { return numChannels; }
+		int getNumSamples() const noexcept { return numSamples; }
+
+		/* dest, numChannels, numSamples
+		points dest at the first numChannels and numSamples without allocating */
+		void referTo(AudioBuffer& dest, int _numChannels, int _numSamples) noexcept
+		{
+			jassert(_numChannels <= numChannels && _numSamples <= numSamples);
+			dest.setDataToReferTo(channels.data(), _numChannels, _numSamples);
+		}
+
+	protected:
+		std::vector<Float> owned;
+		std::vector<Float*> channels;
+		int numChannels, numSamples, stride;
+
+		void bind(char* memory) noexcept override
+		{
+			auto samples = reinterpret_cast<Float*>(memory);
+			for (auto ch = 0; ch < numChannels; ++ch)
+				channels[ch] = samples + ch * stride;
+		}
+	};
+}
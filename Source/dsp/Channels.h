@@ -0,0 +1,113 @@
+#pragma once
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <array>
+
+namespace dsp
+{
+	// channels of a bus, enough for a 9.1.6 bed
+	static constexpr int MaxNumChannels = 16;
+	// channels of the host's buffer, the main bus and the sidechain
+	static constexpr int MaxNumChannelsAll = MaxNumChannels * 2;
+	// channels a modulator synthesizes, whatever the layout. the first one and the one at the full width
+	static constexpr int NumModChannels = 2;
+	// the position of a channel that isn't modulated at all, f.ex. the lfe
+	static constexpr double Unmodulated = -1.;
+
+	// where each channel of a bus sits between the first modulator channel [0] and the one at the full width [1]
+	using ChannelPositions = std::array<double, MaxNumChannels>;
+
+	/* type, position of a channel type or Unmodulated. left channels on one edge, right channels on the other,
+	returns the fallback for types without a side, f.ex. discrete channels */
+	inline double getPosition(juce::AudioChannelSet::ChannelType type, double fallback) noexcept
+	{
+		using Type = juce::AudioChannelSet::ChannelType;
+		switch (type)
+		{
+		case Type::left:
+		case Type::leftSurround:
+		case Type::leftSurroundSide:
+		case Type::leftSurroundRear:
+		case Type::wideLeft:
+		case Type::topFrontLeft:
+		case Type::topSideLeft:
+		case Type::topRearLeft:
+			return 0.;
+		case Type::leftCentre:
+			return .25;
+		case Type::centre:
+		case Type::centreSurround:
+		case Type::topMiddle:
+		case Type::topFrontCentre:
+		case Type::topRearCentre:
+			return .5;
+		case Type::rightCentre:
+			return .75;
+		case Type::right:
+		case Type::rightSurround:
+		case Type::rightSurroundSide:
+		case Type::rightSurroundRear:
+		case Type::wideRight:
+		case Type::topFrontRight:
+		case Type::topSideRight:
+		case Type::topRearRight:
+			return 1.;
+		case Type::LFE:
+		case Type::LFE2:
+			return Unmodulated;
+		default:
+			return fallback;
+		}
+	}
+
+	/* positions, layout. mono and stereo keep their channel order, so they sound like they always did.
+	bigger layouts place every channel by its type, channels without a side in the order of the bus */
+	inline void makePositions(ChannelPositions& positions, const juce::AudioChannelSet& layout) noexcept
+	{
+		const auto numChannels = std::min(layout.size(), MaxNumChannels);
+		const auto numGapsInv = numChannels > 1 ? 1. / static_cast<double>(numChannels - 1) : 0.;
+		for (auto ch = 0; ch < MaxNumChannels; ++ch)
+		{
+			const auto fallback = std::min(1., static_cast<double>(ch) * numGapsInv);
+			positions[ch] = ch < numChannels && numChannels > NumModChannels
+				? getPosition(layout.getTypeOfChannel(ch), fallback)
+				: fallback;
+		}
+	}
+
+	/* samples, positions, numChannels, numSamples, depth
+	the first and the last channel come in as the modulator's edges. every channel becomes the crossfade between them
+	at its position, so a modulation's width spreads across the bus by where its speakers are.
+	unmodulated channels only keep the lookahead shift of the depth, see the modbuffer */
+	inline void spread(double* const* samples, const ChannelPositions& positions,
+		int numChannels, int numSamples, const double* depth) noexcept
+	{
+		if (numChannels <= NumModChannels)
+			return;
+		const auto first = samples[0];
+		const auto last = samples[numChannels - 1];
+		for (auto ch = 1; ch < numChannels - 1; ++ch)
+		{
+			const auto x = positions[ch];
+			auto smpls = samples[ch];
+			if (x == Unmodulated)
+				for (auto s = 0; s < numSamples; ++s)
+					smpls[s] = depth[s] - 1.;
+			else
+				for (auto s = 0; s < numSamples; ++s)
+					smpls[s] = first[s] + x * (last[s] - first[s]);
+		}
+
+		// the edges themselves last, everything else was read from them
+		const auto x0 = positions[0];
+		const auto x1 = positions[numChannels - 1];
+		if (x0 == 0. && x1 == 1.)
+			return;
+		for (auto s = 0; s < numSamples; ++s)
+		{
+			const auto f = first[s];
+			const auto l = last[s];
+			first[s] = x0 == Unmodulated ? depth[s] - 1. : f + x0 * (l - f);
+			last[s] = x1 == Unmodulated ? depth[s] - 1. : f + x1 * (l - f);
+		}
+	}
+}
@@ -0,0 +1,178 @@
+#pragma once
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <array>
+#include "Arena.h"
+#include "Channels.h"
+
+namespace dsp
+{
+	/*
+	lets a slow modulator run at a fraction of the processing rate.
+	the modulator synthesizes control points, which are expanded to the processing rate with a cubic spline.
+	the points lie on a fixed grid that continues across blocks, so the result doesn't depend on the block size.
+	the expanded curve lags behind the synthesized one by two control periods.
+	*/
+	struct ControlRate
+	{
+		using PosInfo = juce::AudioPlayHead::CurrentPositionInfo;
+
+		static constexpr int MaxNumChannels = NumModChannels;
+		static constexpr int MaxDecimation = 32;
+		// control points per cycle of the highest frequency a modulator declares
+		static constexpr double PointsPerCycle = 4.;
+
+		ControlRate() :
+			points(),
+			pointers(),
+			history(),
+			Fs(1.),
+			decimationInv(1.),
+			decimation(1),
+			phase(0),
+			stale(true)
+		{}
+
+		/* Fs, blockSize, bandwidthHz
+		bandwidthHz <= 0 keeps the full rate */
+		void prepare(double _Fs, int blockSize, double bandwidthHz)
+		{
+			Fs = _Fs;
+			decimation = 1;
+			if (bandwidthHz > 0.)
+				while (decimation < MaxDecimation
+					&& Fs / static_cast<double>(decimation * 2) >= bandwidthHz * PointsPerCycle)
+					decimation *= 2;
+			decimationInv = 1. / static_cast<double>(decimation);
+
+			for (auto& p : points)
+				p.resize(getMaxNumPoints(blockSize) + 4); // compensate for potential spline interpolation
+			reset();
+		}
+
+		void reset() noexcept
+		{
+			phase = 0;
+			stale = true;
+		}
+
+		bool isDecimating() const noexcept
+		{
+			return decimation != 1;
+		}
+
+		int getDecimation() const noexcept
+		{
+			return decimation;
+		}
+
+		/* processing samples the expanded curve lags behind */
+		int getLag() const noexcept
+		{
+			return isDecimating() ? 2 * decimation : 0;
+		}
+
+		/* blockSize */
+		int getMaxNumPoints(int blockSize) const noexcept
+		{
+			return blockSize / decimation + 1;
+		}
+
+		/* numSamples, how many control points are due within the next numSamples */
+		int getNumPoints(int numSamples) const noexcept
+		{
+			const auto offset = getOffset();
+			if (offset >= numSamples)
+				return 0;
+			return (numSamples - offset - 1) / decimation + 1;
+		}
+
+		/* transport
+		moves the transport to where the next control point is, so that the modulator syncs to it */
+		PosInfo shift(const PosInfo& transport) const noexcept
+		{
+			const auto secs = static_cast<double>(getOffset()) / Fs;
+			auto shifted = transport;
+			shifted.timeInSeconds += secs;
+			shifted.ppqPosition += secs * transport.bpm / 60.;
+			return shifted;
+		}
+
+		/* where the modulator synthesizes its control points to */
+		double* const* getPoints() noexcept
+		{
+			pointers[0] = points[0].data();
+			pointers[1] = points[1].data();
+			return pointers.data();
+		}
+
+		/* samples, numChannels, numSamples
+		expands the control points that were synthesized for this block */
+		void expand(double* const* samples, int numChannels, int numSamples) noexcept
+		{
+			if (stale && getNumPoints(numSamples) != 0)
+			{
+				// nothing was synthesized for a while, so the curve starts from the first new point
+				for (auto ch = 0; ch < numChannels; ++ch)
+					history[ch].fill(points[ch][0]);
+				stale = false;
+			}
+
+			auto ph = phase;
+			for (auto ch = 0; ch < numChannels; ++ch)
+			{
+				auto smpls = samples[ch];
+				const auto pts = points[ch].data();
+				auto& h = history[ch];
+				auto p = 0;
+				ph = phase;
+
+				for (auto s = 0; s < numSamples; ++s)
+				{
+					if (ph == 0)
+					{
+						h[0] = h[1];
+						h[1] = h[2];
+						h[2] = h[3];
+						h[3] = pts[p];
+						++p;
+					}
+					smpls[s] = spline(h, static_cast<double>(ph) * decimationInv);
+					++ph;
+					if (ph == decimation)
+						ph = 0;
+				}
+			}
+			phase = ph;
+		}
+
+		/* numSamples, keeps the grid going while nothing is synthesized */
+		void skip(int numSamples) noexcept
+		{
+			phase = (phase + numSamples) % decimation;
+			stale = true;
+		}
+
+	protected:
+		std::array<Scratch<double>, MaxNumChannels> points;
+		std::array<double*, MaxNumChannels> pointers;
+		std::array<std::array<double, 4>, MaxNumChannels> history;
+		double Fs, decimationInv;
+		int decimation, phase;
+		bool stale;
+
+		/* processing samples until the next control point is due */
+		int getOffset() const noexcept
+		{
+			return phase == 0 ? 0 : decimation - phase;
+		}
+
+		/* catmull-rom between h[1] and h[2] */
+		static double spline(const std::array<double, 4>& h, double x) noexcept
+		{
+			const auto c1 = .5 * (h[2] - h[0]);
+			const auto c2 = h[0] - 2.5 * h[1] + 2. * h[2] - .5 * h[3];
+			const auto c3 = .5 * (h[3] - h[0]) + 1.5 * (h[1] - h[2]);
+			return ((c3 * x + c2) * x + c1) * x + h[1];
+		}
+	};
+}
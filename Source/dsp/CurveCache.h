@@ -0,0 +1,292 @@
+#pragma once
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <array>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#include <vector>
+#include "Channels.h"
+
+namespace dsp
+{
+	/*
+	remembers the curves of modulators that only depend on the transport position, their parameters and their seed,
+	so that looped playback copies them instead of synthesizing them again on every pass.
+	curves are stored in chunks along the timeline, so the blocks of a pass don't need to line up with the ones before.
+	chunks map to a fixed number of slots, which bounds the memory. a long arrangement overwrites older chunks.
+	a curve is only stored once the settle time passed since the last jump or parameter change,
+	because crossfades and smoothers still depend on what came before until then.
+	blocks served from the cache glide from where the curve was to the cached one,
+	that replaces the crossfade the modulator would synthesize on a loop jump.
+	*/
+	struct CurveCache
+	{
+		using PosInfo = juce::AudioPlayHead::CurrentPositionInfo;
+		using Int64 = juce::int64;
+		using Key = juce::uint64;
+
+		static constexpr int MaxNumChannels = NumModChannels;
+		static constexpr int ChunkSize = 1 << 10;
+		// per modulator. curves are stored as float
+		static constexpr size_t BudgetBytes = 16 << 20;
+		// longer than the crossfades and smoothers of the modulators
+		static constexpr double SettleMs = 250.;
+		// as long as the crossfade of a loop jump
+		static constexpr double GlideMs = 200.;
+
+		/* values, mixes every bit of them into a key. parameters, seed, tempo.. */
+		static Key makeKey(std::initializer_list<double> values) noexcept
+		{
+			Key key = 0xcbf29ce484222325;
+			for (const auto v : values)
+			{
+				Key bits;
+				std::memcpy(&bits, &v, sizeof(Key));
+				key = (key ^ bits) * 0x100000001b3;
+				key ^= key >> 29;
+			}
+			return key;
+		}
+
+		CurveCache() :
+			curves(),
+			chunks(),
+			last(),
+			glideOffset(),
+			oversamplingFactor(1.),
+			lastKey(0),
+			expectedPos(-1),
+			settleLength(0),
+			settleRemaining(0),
+			glideLength(1),
+			glideRemaining(0),
+			wasCached(false)
+		{}
+
+		/* Fs, oversamplingFactor, enabled
+		allocates the whole budget if enabled and frees it otherwise */
+		void prepare(double Fs, double _oversamplingFactor, bool enabled)
+		{
+			oversamplingFactor = _oversamplingFactor;
+			settleLength = static_cast<int>(std::ceil(Fs * SettleMs * .001));
+			glideLength = std::max(1, static_cast<int>(std::ceil(Fs * GlideMs * .001)));
+
+			const auto numSlots = enabled ? BudgetBytes / (sizeof(float) * MaxNumChannels * ChunkSize) : 0;
+			if (numSlots == chunks.size())
+				return reset();
+			std::vector<float>(numSlots * MaxNumChannels * ChunkSize).swap(curves);
+			std::vector<Chunk>(numSlots).swap(chunks);
+			reset();
+		}
+
+		/* forgets every curve */
+		void reset() noexcept
+		{
+			for (auto& chunk : chunks)
+				chunk = Chunk();
+			last.fill(0.);
+			glideOffset.fill(0.);
+			expectedPos = -1;
+			settleRemaining = settleLength;
+			glideRemaining = 0;
+			wasCached = false;
+		}
+
+		bool isEnabled() const noexcept
+		{
+			return !chunks.empty();
+		}
+
+		size_t getMemoryUsage() const noexcept
+		{
+			return curves.size() * sizeof(float) + chunks.size() * sizeof(Chunk);
+		}
+
+		/* samples, numChannels, numSamples, transport, key, synthesize(), advance()
+		copies the block from the cache if all of it is there and only advances the modulator, so it keeps its position.
+		synthesizes it otherwise and stores it if it's settled */
+		template<typename Synthesize, typename Advance>
+		void operator()(double* const* samples, int numChannels, int numSamples, const PosInfo& transport,
+			Key key, Synthesize&& synthesize, Advance&& advance) noexcept
+		{
+			if (!isEnabled() || numSamples == 0)
+				return synthesize();
+
+			if (key != lastKey)
+			{
+				lastKey = key;
+				settleRemaining = settleLength;
+			}
+
+			// the modulators don't follow the transport while it stops, but they keep smoothing
+			if (!transport.isPlaying)
+			{
+				synthesize();
+				expectedPos = -1;
+				endBlock(samples, numChannels, numSamples, false);
+				return;
+			}
+
+			const auto pos = static_cast<Int64>(std::round(static_cast<double>(transport.timeInSamples) * oversamplingFactor));
+			const auto jumped = expectedPos != -1 && pos != expectedPos;
+			if (jumped)
+				settleRemaining = settleLength;
+			expectedPos = pos + numSamples;
+
+			const auto cached = read(samples, numChannels, pos, numSamples, key);
+			if (cached)
+				advance();
+			else
+			{
+				synthesize();
+				// the control rate starts over after a skip, so the curve needs to settle again
+				if (wasCached)
+					settleRemaining = settleLength;
+				if (settleRemaining == 0)
+					write(samples, numChannels, pos, numSamples, key);
+			}
+
+			if (cached != wasCached || (cached && jumped))
+				startGlide(samples, numChannels);
+			endBlock(samples, numChannels, numSamples, cached);
+		}
+
+		/* the modulator was skipped, so nothing it continues with is settled */
+		void skip() noexcept
+		{
+			expectedPos = -1;
+			settleRemaining = settleLength;
+			wasCached = false;
+		}
+
+	private:
+		struct Chunk
+		{
+			Int64 idx = std::numeric_limits<Int64>::min();
+			Key key = 0;
+			// the samples of the chunk that were stored without a gap
+			int begin = 0, end = 0;
+		};
+
+		std::vector<float> curves;
+		std::vector<Chunk> chunks;
+		std::array<double, MaxNumChannels> last, glideOffset;
+		double oversamplingFactor;
+		Key lastKey;
+		Int64 expectedPos;
+		int settleLength, settleRemaining, glideLength, glideRemaining;
+		bool wasCached;
+
+		Int64 getChunkIdx(Int64 pos) const noexcept
+		{
+			// the timeline can start before zero, f.ex. for a pre-roll
+			return pos >= 0 ? pos / ChunkSize : (pos - ChunkSize + 1) / ChunkSize;
+		}
+
+		Chunk& getChunk(Int64 idx) noexcept
+		{
+			const auto numSlots = static_cast<Int64>(chunks.size());
+			return chunks[static_cast<size_t>(((idx % numSlots) + numSlots) % numSlots)];
+		}
+
+		float* getCurve(const Chunk& chunk, int ch) noexcept
+		{
+			const auto slot = static_cast<size_t>(&chunk - chunks.data());
+			return curves.data() + (slot * MaxNumChannels + static_cast<size_t>(ch)) * ChunkSize;
+		}
+
+		/* func(chunkIdx, offsetInChunk, offsetInBlock, length) for every chunk the block touches, until it returns false */
+		template<typename Func>
+		bool forEachChunk(Int64 pos, int numSamples, Func&& func) noexcept
+		{
+			for (auto s = 0; s < numSamples;)
+			{
+				const auto idx = getChunkIdx(pos + s);
+				const auto offset = static_cast<int>(pos + s - idx * ChunkSize);
+				const auto length = std::min(ChunkSize - offset, numSamples - s);
+				if (!func(idx, offset, s, length))
+					return false;
+				s += length;
+			}
+			return true;
+		}
+
+		bool read(double* const* samples, int numChannels, Int64 pos, int numSamples, Key key) noexcept
+		{
+			const auto complete = forEachChunk(pos, numSamples, [&](Int64 idx, int offset, int, int length)
+			{
+				const auto& chunk = getChunk(idx);
+				return chunk.idx == idx && chunk.key == key && chunk.begin <= offset && offset + length <= chunk.end;
+			});
+			if (!complete)
+				return false;
+
+			return forEachChunk(pos, numSamples, [&](Int64 idx, int offset, int s, int length)
+			{
+				const auto& chunk = getChunk(idx);
+				for (auto ch = 0; ch < numChannels; ++ch)
+				{
+					const auto curve = getCurve(chunk, ch) + offset;
+					auto smpls = samples[ch] + s;
+					for (auto i = 0; i < length; ++i)
+						smpls[i] = static_cast<double>(curve[i]);
+				}
+				return true;
+			});
+		}
+
+		void write(const double* const* samples, int numChannels, Int64 pos, int numSamples, Key key) noexcept
+		{
+			forEachChunk(pos, numSamples, [&](Int64 idx, int offset, int s, int length)
+			{
+				auto& chunk = getChunk(idx);
+				const auto continues = chunk.idx == idx && chunk.key == key
+					&& chunk.begin <= offset && offset <= chunk.end;
+				if (!continues)
+				{
+					chunk.idx = idx;
+					chunk.key = key;
+					chunk.begin = chunk.end = offset;
+				}
+				for (auto ch = 0; ch < numChannels; ++ch)
+				{
+					auto curve = getCurve(chunk, ch) + offset;
+					const auto smpls = samples[ch] + s;
+					for (auto i = 0; i < length; ++i)
+						curve[i] = static_cast<float>(smpls[i]);
+				}
+				chunk.end = std::max(chunk.end, offset + length);
+				return true;
+			});
+		}
+
+		/* samples, numChannels, the block glides from the end of the last one */
+		void startGlide(double* const* samples, int numChannels) noexcept
+		{
+			for (auto ch = 0; ch < numChannels; ++ch)
+				glideOffset[ch] = last[ch] - samples[ch][0];
+			glideRemaining = glideLength;
+		}
+
+		void endBlock(double* const* samples, int numChannels, int numSamples, bool cached) noexcept
+		{
+			if (glideRemaining != 0)
+			{
+				const auto glideInv = 1. / static_cast<double>(glideLength);
+				const auto length = std::min(glideRemaining, numSamples);
+				for (auto ch = 0; ch < numChannels; ++ch)
+				{
+					auto smpls = samples[ch];
+					for (auto s = 0; s < length; ++s)
+						smpls[s] += glideOffset[ch] * static_cast<double>(glideRemaining - s) * glideInv;
+				}
+				glideRemaining -= length;
+			}
+
+			for (auto ch = 0; ch < numChannels; ++ch)
+				last[ch] = samples[ch][numSamples - 1];
+			settleRemaining = std::max(0, settleRemaining - numSamples);
+			wasCached = cached;
+		}
+	};
+}
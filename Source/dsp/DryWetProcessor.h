@@ -2,6 +2,7 @@
 #include "WHead.h"
 #include "../modsys/ModSys.h"
 #include "Smooth.h"
+#include "Simd.h"
 
 namespace drywet
 {
@@ -15,10 +16,11 @@ namespace drywet
 			rHead(0)
 		{}
 		
-		void prepare(int blockSize, int size)
+		/* blockSize, size, numChannels */
+		void prepare(int blockSize, int size, int numChannels)
 		{
 			wHead.prepare(blockSize, size);
-			ringBuffer.setSize(2, size, false, true, false);
+			ringBuffer.setSize(numChannels, size, false, true, false);
 			rHead.resize(blockSize);
 		}
 		
@@ -47,29 +49,25 @@ namespace drywet
 			int numChannels, int numSamples) noexcept
 		{
 			synthesizeHeads(numSamples);
-			auto ringBuf = ringBuffer.getArrayOfWritePointers();
-			
 			for (auto ch = 0; ch < numChannels; ++ch)
-			{
-				const auto src = samplesSrc[ch];
-				auto dest = samplesDest[ch];
-				auto ring = ringBuf[ch];
+				processChannel(samplesDest[ch], samplesSrc[ch], ch, numSamples);
+		}
 
-				for (auto s = 0; s < numSamples; ++s)
-				{
-					const auto w = wHead[s];
-					const auto r = rHead[s];
+		/* dest, src, ch, numSamples
+		the heads must have been synthesized for this block already */
+		void processChannel(double* dest, const double* src, int ch, int numSamples) noexcept
+		{
+			auto ring = ringBuffer.getWritePointer(ch);
 
-					ring[w] = src[s];
-					dest[s] = ring[r];
-				}
+			for (auto s = 0; s < numSamples; ++s)
+			{
+				const auto w = wHead[s];
+				const auto r = rHead[s];
+
+				ring[w] = src[s];
+				dest[s] = ring[r];
 			}
 		}
-	
-	protected:
-		dsp::WHead wHead;
-		AudioBufferD ringBuffer;
-		std::vector<int> rHead;
 
 		void synthesizeHeads(int numSamples) noexcept
 		{
@@ -81,19 +79,23 @@ namespace drywet
 					rHead[s] -= wHead.delaySize;
 			}
 		}
+	
+	protected:
+		dsp::WHead wHead;
+		AudioBufferD ringBuffer;
+		dsp::Scratch<int> rHead;
 	};
 
 	struct Processor
 	{
+		// the dry channels come last, as many as the bus has
 		enum
 		{
-			kL,
-			kR,
 			kMix,
 			kMixDry,
 			kMixWet,
 			kGainWet,
-			kNumChannels
+			kDry
 		};
 
 		Processor() :
@@ -101,20 +103,31 @@ namespace drywet
 			delay(),
 			buffers(),
 			gainWet(420.f), gainWetVal(1.f),
-			gainWetSmooth(0.f)
+			gainWetSmooth(0.f),
+			dry(false)
 		{
 		}
 		
-		void prepare(double sampleRate, int blockSize, int latency)
+		/* sampleRate, blockSize, latency, numChannels */
+		void prepare(double sampleRate, int blockSize, int latency, int numChannels)
 		{
 			mixSmooth.makeFromDecayInMs(10., sampleRate);
 			gainWetSmooth.makeFromDecayInMs(4., sampleRate);
-			buffers.setSize(kNumChannels, blockSize, false, true, false);
-			delay.prepare(blockSize, latency);
+			buffers.setSize(kDry + numChannels, blockSize);
+			delay.prepare(blockSize, latency, numChannels);
 		}
 		
 		void saveDry(const double* const* samples, double mixVal, int numChannels, int numSamples,
 			bool lookaheadEnabled) noexcept
+		{
+			prepareDry(mixVal, numSamples, lookaheadEnabled);
+			for (auto ch = 0; ch < numChannels; ++ch)
+				saveDryChannel(samples[ch], ch, numSamples, lookaheadEnabled);
+		}
+
+		/* mixVal, numSamples, lookaheadEnabled
+		everything the channels share, call once per block before saveDryChannel */
+		void prepareDry(double mixVal, int numSamples, bool lookaheadEnabled) noexcept
 		{
 			auto bufs = buffers.getArrayOfWritePointers();
 
@@ -122,23 +135,40 @@ namespace drywet
 				auto mixSmoothing = mixSmooth(bufs[kMix], mixVal, numSamples);
 				if(!mixSmoothing)
 					juce::FloatVectorOperations::fill(bufs[kMix], mixVal, numSamples);
+				dry = !mixSmoothing && mixVal == 0.;
 			}
-			{ // MAKING EQUAL LOUDNESS CURVES
-				for (auto s = 0; s < numSamples; ++s)
-					bufs[kMixDry][s] = std::sqrt(1. - bufs[kMix][s]);
-				for (auto s = 0; s < numSamples; ++s)
-					bufs[kMixWet][s] = std::sqrt(bufs[kMix][s]);
-			}
+			// MAKING EQUAL LOUDNESS CURVES
+			simd::getKernels().equalPower(bufs[kMixDry], bufs[kMixWet], bufs[kMix], numSamples);
 			
 			if(lookaheadEnabled)
-				delay(bufs, samples, numChannels, numSamples);
+				delay.synthesizeHeads(numSamples);
+		}
+
+		/* samples, ch, numSamples, lookaheadEnabled */
+		void saveDryChannel(const double* samples, int ch, int numSamples, bool lookaheadEnabled) noexcept
+		{
+			auto dry = buffers.getWritePointer(kDry + ch);
+			if(lookaheadEnabled)
+				delay.processChannel(dry, samples, ch, numSamples);
 			else
-			{
-				for (auto ch = 0; ch < numChannels; ++ch)
-					juce::FloatVectorOperations::copy(bufs[kL + ch], samples[ch], numSamples);
-			}
+				juce::FloatVectorOperations::copy(dry, samples, numSamples);
 		}
 		
+		/* true if the mix is fully dry and not smoothing in this block,
+		which means the wet signal doesn't have to be processed at all */
+		bool isDry() const noexcept
+		{
+			return dry;
+		}
+
+		/* samples, numChannels, numSamples
+		writes the saved dry signal to the output, instead of processWet */
+		void processDry(double* const* samples, int numChannels, int numSamples) noexcept
+		{
+			for (auto ch = 0; ch < numChannels; ++ch)
+				juce::FloatVectorOperations::copy(samples[ch], buffers.getReadPointer(kDry + ch), numSamples);
+		}
+
 		void processWet(double* const* samples, double _gainWet, int numChannels, int numSamples) noexcept
 		{
 			auto bufs = buffers.getArrayOfWritePointers();
@@ -154,14 +184,9 @@ namespace drywet
 					juce::FloatVectorOperations::fill(bufs[kGainWet], gainWetVal, numSamples);
 			}
 			
+			const auto& kernels = simd::getKernels();
 			for (auto ch = 0; ch < numChannels; ++ch)
-			{
-				auto smpls = samples[ch];
-				const auto dry = bufs[kL + ch];
-
-				for (auto s = 0; s < numSamples; ++s)
-					smpls[s] = dry[s] * bufs[kMixDry][s] + smpls[s] * bufs[kMixWet][s] * bufs[kGainWet][s];
-			}
+				kernels.mix(samples[ch], bufs[kDry + ch], bufs[kMixDry], bufs[kMixWet], bufs[kGainWet], numSamples);
 		}
 	
 		void processBypass(double* const* samples, int numChannels, int numSamples,
@@ -173,16 +198,17 @@ namespace drywet
 			{
 				auto bufs = buffers.getArrayOfWritePointers();
 				for (auto ch = 0; ch < numChannels; ++ch)
-					juce::FloatVectorOperations::copy(bufs[kL + ch], samples[ch], numSamples);
+					juce::FloatVectorOperations::copy(bufs[kDry + ch], samples[ch], numSamples);
 			}
 		}
 
 	protected:
 		smooth::Smooth<double> mixSmooth;
 		FFDelay delay;
-		AudioBufferD buffers;
+		dsp::ScratchBuffer<double> buffers;
 		double gainWet, gainWetVal;
 		smooth::Smooth<double> gainWetSmooth;
+		bool dry;
 	};
 }
 
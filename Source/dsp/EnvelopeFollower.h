@@ -3,6 +3,7 @@
 #include <vector>
 #include <array>
 #include "PRM.h"
+#include "SimdPair.h"
 #include <juce_audio_basics/juce_audio_basics.h>
 
 namespace envfol
@@ -45,8 +46,10 @@ namespace envfol
 		{
 			const auto freqFc = freqHz * sampleRateInv;
 			const auto freqInfo = freqPRM(freqFc, numSamples);
-			
-			if (!freqInfo.smoothing)
+
+			if (numChannels == 2)
+				processPair(samples, freqInfo, numSamples);
+			else if (!freqInfo.smoothing)
 				for (auto ch = 0; ch < numChannels; ++ch)
 					for (auto s = 0; s < numSamples; ++s)
 						samples[ch][s] -= filters[ch](samples[ch][s]);
@@ -74,6 +77,32 @@ namespace envfol
 		std::array<LowpassGain, 2> filters;
 		PRM freqPRM;
 		double sampleRate, sampleRateInv;
+
+		/* samples, freqInfo, numSamples
+		both channels share the cutoff, so they advance together and it's only computed once */
+		void processPair(double* const* samples, const PRMInfo& freqInfo, int numSamples) noexcept
+		{
+			using Pair = simd::Pair<double>;
+			auto& filter = filters[0];
+			auto smplsL = samples[0];
+			auto smplsR = samples[1];
+			auto y1 = Pair(filters[0].y1, filters[1].y1);
+
+			for (auto s = 0; s < numSamples; ++s)
+			{
+				if (freqInfo.smoothing)
+					filter.makeFromDecayInFc(freqInfo.buf[s]);
+				const auto x0 = Pair(smplsL[s], smplsR[s]);
+				y1 = x0 * filter.a0 + y1 * filter.b1;
+				const auto y0 = x0 - y1;
+				smplsL[s] = y0.left();
+				smplsR[s] = y0.right();
+			}
+
+			filters[1].copyCutoffFrom(filter);
+			filters[0].y1 = y1.left();
+			filters[1].y1 = y1.right();
+		}
 	};
 
 	struct EnvFol
@@ -93,7 +122,7 @@ namespace envfol
 		void prepare(double _sampleRate, int blockSize)
 		{
 			sampleRate = _sampleRate;
-			inputBuffer.setSize(2, blockSize, false, false, false);
+			inputBuffer.setSize(2, blockSize);
 			atkPRM.prepare(sampleRate, blockSize, 10.);
 			rlsPRM.prepare(sampleRate, blockSize, 10.);
 			gainPRM.prepare(sampleRate, blockSize, 10.);
@@ -128,7 +157,7 @@ namespace envfol
 		}
 
 	protected:
-		AudioBuffer inputBuffer;
+		dsp::ScratchBuffer<double> inputBuffer;
 		PRM atkPRM, rlsPRM, gainPRM, widthPRM;
 		std::array<double, 2> envelope;
 		std::array<Lowpass, 2> envSmooth;
@@ -162,7 +191,7 @@ namespace envfol
 		{
 			const auto rlsSamples = msInSamples(releaseMs, sampleRate);
 			const auto rls = 1. / rlsSamples;
-			auto rlsInfo = atkPRM(rls, numSamples);
+			auto rlsInfo = rlsPRM(rls, numSamples);
 			if (!rlsInfo.smoothing)
 				SIMD::fill(rlsInfo.buf, rls, numSamples);
 			return rlsInfo.buf;
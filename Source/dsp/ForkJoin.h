@@ -0,0 +1,367 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include "RealtimeSanitizer.h"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <vector>
+#if JUCE_INTEL
+#include <immintrin.h>
+#endif
+
+// 1 if the helpers can join the host's audio workgroup, so the os schedules them like the audio thread
+#if JUCE_VERSION >= 0x070006
+#define NEL_AUDIO_WORKGROUP 1
+#include <juce_audio_basics/juce_audio_basics.h>
+#else
+#define NEL_AUDIO_WORKGROUP 0
+#endif
+
+namespace dsp
+{
+	/*
+	runs the independent tasks of a block (channels, modulators..) on a few helper threads
+	and waits until all of them are done.
+	tasks are assigned to threads by index, so every task usually runs on the same thread.
+	nothing locks: a fork publishes a new generation, that the helpers spin on for a while before they park,
+	and every task is claimed by whoever starts it. the join only waits for tasks that were claimed by a helper.
+	offline the caller parks as well while it waits. in realtime it never does. once the deadline of a fork passed,
+	the caller claims every task no helper started yet and only waits for the ones already running,
+	so a late helper costs at most the rest of one task.
+	*/
+	struct ForkJoin
+	{
+		// pauses before a waiting thread parks, long enough to bridge the forks within a block
+		static constexpr int SpinCount = 1 << 12;
+		// the low bits of a generation tell how many threads it runs on
+		static constexpr unsigned ThreadBits = 8;
+		static constexpr int MaxNumThreads = (1 << ThreadBits) - 1;
+		// more tasks than this run serially
+		static constexpr int MaxNumTasks = 64;
+
+		ForkJoin() :
+			workers(),
+			claims(),
+			finished(),
+			generation(0),
+			numMisses(0),
+			exiting(false),
+			task(nullptr),
+			context(nullptr),
+			numTasks(0),
+			numThreadsActive(1),
+			deadlineTicks(0),
+			deadline(0),
+			enabled(false),
+			realtimePriority(false),
+#if NEL_AUDIO_WORKGROUP
+			workgroup(),
+#endif
+			workgroupChanged(false)
+		{}
+
+		~ForkJoin()
+		{
+			prepare(1);
+		}
+
+		/* numThreads including the calling one, 1 means serial processing.
+		realtimePriority for helpers of an audio callback, they run as realtime threads in the host's workgroup */
+		void prepare(int numThreads, bool _realtimePriority = false)
+		{
+			const auto numWorkers = static_cast<size_t>(juce::jlimit(1, MaxNumThreads, numThreads) - 1);
+			if (numWorkers == workers.size() && _realtimePriority == realtimePriority && !workgroupChanged)
+				return;
+
+			exiting.store(true);
+			publish(nextGeneration(0));
+			for (auto& worker : workers)
+				worker->stopThread(1000);
+			workers.clear();
+			exiting.store(false);
+
+			realtimePriority = _realtimePriority;
+			workgroupChanged = false;
+			const auto gen = generation.load();
+			for (auto w = 0; w < static_cast<int>(numWorkers); ++w)
+			{
+				workers.push_back(std::make_unique<Worker>(*this, w + 1, gen));
+				auto& worker = *workers.back();
+				if (!realtimePriority)
+					worker.startThread(juce::Thread::Priority::normal);
+				else if (!worker.startRealtimeThread(juce::Thread::RealtimeOptions{}))
+					worker.startThread(juce::Thread::Priority::highest);
+			}
+		}
+
+#if NEL_AUDIO_WORKGROUP
+		/* any thread but the audio thread. the helpers join it the next time they are prepared */
+		void setWorkgroup(const juce::AudioWorkgroup& wg)
+		{
+			if (workgroup == wg)
+				return;
+			workgroup = wg;
+			workgroupChanged = true;
+		}
+#endif
+
+		/* audio thread, f.ex. only while the host renders offline */
+		void setEnabled(bool e) noexcept
+		{
+			enabled = e;
+		}
+
+		/* seconds, audio thread. how long the helpers may take to start their tasks, counted from the start of every fork.
+		0 waits for the helpers as long as it takes, f.ex. offline */
+		void setDeadline(double seconds) noexcept
+		{
+			const auto ticksPerSec = static_cast<double>(juce::Time::getHighResolutionTicksPerSecond());
+			deadlineTicks = seconds <= 0. ? 0 : std::max(static_cast<juce::int64>(1), static_cast<juce::int64>(seconds * ticksPerSec));
+		}
+
+		bool isRealtimePriority() const noexcept
+		{
+			return realtimePriority;
+		}
+
+		int getNumThreads() const noexcept
+		{
+			return static_cast<int>(workers.size()) + 1;
+		}
+
+		/* if false, the tasks run one after the other, so channels may as well be processed in pairs */
+		bool isForking() const noexcept
+		{
+			return enabled && getNumThreads() > 1;
+		}
+
+		/* forks that ran past their deadline since the last call, any thread */
+		int getNumMisses() noexcept
+		{
+			return numMisses.exchange(0);
+		}
+
+		/* numTasks, func(int taskIdx)
+		returns when all tasks are done */
+		template<typename Func>
+		void operator()(int _numTasks, Func&& func) noexcept
+		{
+			const auto numThreads = enabled && _numTasks <= MaxNumTasks ? std::min(_numTasks, getNumThreads()) : 1;
+			if (numThreads < 2)
+			{
+				for (auto t = 0; t < _numTasks; ++t)
+					func(t);
+				return;
+			}
+
+			task = &call<std::remove_reference_t<Func>>;
+			context = &func;
+			numTasks = _numTasks;
+			numThreadsActive = numThreads;
+			deadline = deadlineTicks == 0 ? 0 : juce::Time::getHighResolutionTicks() + deadlineTicks;
+			const auto gen = nextGeneration(numThreads);
+			for (auto t = 0; t < numTasks; ++t)
+				claims[t].store(makeClaim(gen, false), std::memory_order_relaxed);
+			publish(gen);
+
+			for (auto t = 0; t < numTasks; t += numThreadsActive)
+				task(context, t);
+			join(gen);
+		}
+
+	private:
+		using Task = void(*)(void*, int) noexcept;
+		using Claim = juce::uint64;
+
+		struct Worker :
+			public juce::Thread
+		{
+			Worker(ForkJoin& _owner, int _threadIdx, unsigned _generation) :
+				juce::Thread("NEL ForkJoin " + juce::String(_threadIdx)),
+				owner(_owner),
+				threadIdx(_threadIdx),
+				gen(_generation),
+				realtimePriority(_owner.realtimePriority)
+#if NEL_AUDIO_WORKGROUP
+				, workgroup(_owner.workgroup)
+#endif
+			{}
+
+			void run() override
+			{
+#if NEL_AUDIO_WORKGROUP
+				juce::WorkgroupToken token;
+				if (realtimePriority)
+					workgroup.join(token);
+#endif
+				while (true)
+				{
+					gen = owner.await(gen);
+					if (owner.exiting.load())
+						return;
+					// a fork that doesn't need this helper doesn't wait for it either
+					const auto numThreads = getNumThreads(gen);
+					if (threadIdx >= numThreads)
+						continue;
+					const realtime::Scope scope(realtimePriority);
+					// the claims of a fork's tasks are open or taken for its generation as long as it runs.
+					// a helper that woke up too late finds them taken for a later one or not open at all
+					for (auto t = threadIdx; t < MaxNumTasks; t += numThreads)
+					{
+						const auto claimed = owner.claim(t, gen);
+						if (claimed < 0)
+							break;
+						if (claimed == 0)
+							continue;
+						owner.task(owner.context, t);
+						auto& f = owner.finished[t];
+						f.store(gen, std::memory_order_release);
+						f.notify_one();
+					}
+				}
+			}
+
+		private:
+			ForkJoin& owner;
+			const int threadIdx;
+			unsigned gen;
+			const bool realtimePriority;
+#if NEL_AUDIO_WORKGROUP
+			const juce::AudioWorkgroup workgroup;
+#endif
+		};
+
+		std::vector<std::unique_ptr<Worker>> workers;
+		// the generation each task was opened for, and whether someone took it already
+		std::array<std::atomic<Claim>, MaxNumTasks> claims;
+		// the generation each task was last done for
+		std::array<std::atomic<unsigned>, MaxNumTasks> finished;
+		std::atomic<unsigned> generation;
+		std::atomic<int> numMisses;
+		std::atomic<bool> exiting;
+		Task task;
+		void* context;
+		int numTasks, numThreadsActive;
+		juce::int64 deadlineTicks, deadline;
+		bool enabled, realtimePriority;
+#if NEL_AUDIO_WORKGROUP
+		juce::AudioWorkgroup workgroup;
+#endif
+		bool workgroupChanged;
+
+		template<typename Func>
+		static void call(void* ctx, int t) noexcept
+		{
+			(*static_cast<Func*>(ctx))(t);
+		}
+
+		static int getNumThreads(unsigned gen) noexcept
+		{
+			return static_cast<int>(gen & static_cast<unsigned>(MaxNumThreads));
+		}
+
+		static Claim makeClaim(unsigned gen, bool taken) noexcept
+		{
+			return (static_cast<Claim>(gen) << 1) | (taken ? 1 : 0);
+		}
+
+		static void pause() noexcept
+		{
+#if JUCE_INTEL
+			_mm_pause();
+#elif JUCE_ARM && JUCE_MSVC
+			__yield();
+#elif JUCE_ARM
+			asm volatile("yield");
+#endif
+		}
+
+		unsigned nextGeneration(int numThreads) const noexcept
+		{
+			return (((generation.load() >> ThreadBits) + 1) << ThreadBits) | static_cast<unsigned>(numThreads);
+		}
+
+		/* gen, wakes up the helpers. they read the fork's task only after they claimed one of its tasks,
+		and a fork only ends once every claimed task is done, so it can't change under their feet */
+		void publish(unsigned gen) noexcept
+		{
+			generation.store(gen, std::memory_order_release);
+			generation.notify_all();
+		}
+
+		/* t, gen. 1 if the task was open for this generation and is taken now, 0 if someone else took it,
+		-1 if it doesn't belong to this generation, f.ex. because its fork is over or has fewer tasks */
+		int claim(int t, unsigned gen) noexcept
+		{
+			auto expected = makeClaim(gen, false);
+			if (claims[t].compare_exchange_strong(expected, makeClaim(gen, true), std::memory_order_acquire))
+				return 1;
+			return expected == makeClaim(gen, true) ? 0 : -1;
+		}
+
+		/* seen, returns the next generation */
+		unsigned await(unsigned seen) noexcept
+		{
+			for (auto spin = 0; spin < SpinCount; ++spin)
+			{
+				const auto gen = generation.load(std::memory_order_acquire);
+				if (gen != seen)
+					return gen;
+				pause();
+			}
+			generation.wait(seen, std::memory_order_acquire);
+			return generation.load(std::memory_order_acquire);
+		}
+
+		/* gen. takes the tasks of the helpers that didn't start yet, returns true if there were any */
+		bool takeOver(unsigned gen) noexcept
+		{
+			bool tookOver = false;
+			for (auto t = 0; t < numTasks; ++t)
+				if (t % numThreadsActive != 0 && claim(t, gen) == 1)
+				{
+					task(context, t);
+					finished[t].store(gen, std::memory_order_relaxed);
+					tookOver = true;
+				}
+			return tookOver;
+		}
+
+		/* gen. returns once every task of the helpers is done, by them or by the caller.
+		past the deadline the caller only waits for the tasks in flight, a fork that needed that counts as a miss */
+		void join(unsigned gen) noexcept
+		{
+			bool late = false;
+			for (auto t = 0; t < numTasks; ++t)
+			{
+				if (t % numThreadsActive == 0)
+					continue;
+				auto& f = finished[t];
+				for (auto spin = 0; true; ++spin)
+				{
+					const auto last = f.load(std::memory_order_acquire);
+					if (last == gen)
+						break;
+
+					if (deadline != 0)
+					{
+						if (!late && juce::Time::getHighResolutionTicks() > deadline)
+						{
+							late = true;
+							takeOver(gen);
+							continue;
+						}
+						pause();
+					}
+					else if (spin < SpinCount)
+						pause();
+					else
+						f.wait(last, std::memory_order_acquire);
+				}
+			}
+			if (late)
+				++numMisses;
+		}
+	};
+}
@@ -40,6 +40,12 @@ namespace dsp
             phasor.inc = inc;
         }
 
+        /* numSamples, advances the phase without synthesizing */
+        void skip(int numSamples) noexcept
+        {
+            phasor.skip(numSamples);
+        }
+
         /* samples, wavetables,
         phase[-.5, .5], width[0, .5], wtPos[0,1],
         numChannels, numSamples */
@@ -117,13 +123,14 @@ namespace dsp
             double* const* samples, const PRMInfoD& wtPosInfo,
             int numChannels, int numSamples) noexcept
         {
+            const auto& tables = wavetables.getTable();
             if (wtPosInfo.smoothing)
                 for (auto ch = 0; ch < numChannels; ++ch)
                 {
                     auto smpls = samples[ch];
                     for (auto s = 0; s < numSamples; ++s)
                     {
-                        smpls[s] = wavetables(wtPosInfo[s], smpls[s]);
+                        smpls[s] = tables(wtPosInfo[s], smpls[s]);
                     }
                 }
             else
@@ -132,7 +139,7 @@ namespace dsp
                     auto smpls = samples[ch];
                     for (auto s = 0; s < numSamples; ++s)
                     {
-                        smpls[s] = wavetables(wtPosInfo.val, smpls[s]);
+                        smpls[s] = tables(wtPosInfo.val, smpls[s]);
                     }
                 }
         }
@@ -155,10 +162,11 @@ namespace dsp
             latency(0.), sampleRate(1.), sampleRateInv(1.),
             quarterNoteLength(0.), bps(1.),
             rateHz(0.), rateSync(0.), bpm(0.), inc(0.),
-            posEstimate(0), oversamplingFactor(1)
+            posEstimate(0), oversamplingFactor(1.)
         {}
 
-        void prepare(double _sampleRate, int blockSize, double _latency, int _oversamplingFactor)
+        /* sampleRate, blockSize, latency in host samples, oversamplingFactor (samples per host sample) */
+        void prepare(double _sampleRate, int blockSize, double _latency, double _oversamplingFactor)
         {
             inc = 0.;
             latency = _latency;
@@ -239,6 +247,18 @@ namespace dsp
             }
         }
 
+        /* numSamples, transport, rateHz, rateSync, temposync
+        keeps position and crossfades going while the output isn't needed */
+        void skip(int numSamples, const PosInfo& transport, double _rateHz, double _rateSync,
+            bool temposync) noexcept
+        {
+            updateLFO(transport, _rateHz, _rateSync, numSamples, temposync);
+            for (auto i = 0; i < NumLFOs; ++i)
+                if (mixer[i].isEnabled())
+                    lfos[i].skip(numSamples);
+            mixer.skip(numSamples);
+        }
+
     protected:
         Mixer mixer;
         const Wavetables& wavetables;
@@ -247,12 +267,13 @@ namespace dsp
         double latency, sampleRate, sampleRateInv, quarterNoteLength, bps;
         double rateHz, rateSync, bpm, inc;
         Int64 posEstimate;
-        int oversamplingFactor;
+        double oversamplingFactor;
         
         const bool isLooping(Int64 timeInSamples) const noexcept
         {
-            const auto error = std::abs(timeInSamples - posEstimate);
-            return error > 1;
+            // below the host rate the estimate is only as precise as one sample at this rate
+            const auto error = static_cast<double>(std::abs(timeInSamples - posEstimate));
+            return error > std::max(1., std::ceil(1. / oversamplingFactor));
         }
 
         const bool keepsSpeed(double nBpm, double nInc) const noexcept
@@ -273,7 +294,7 @@ namespace dsp
             if (transport.isPlaying)
             {
                 updatePosition(lfos[mixer.idx], transport.ppqPosition, temposync);
-                posEstimate = transport.timeInSamples + numSamples / oversamplingFactor;
+                posEstimate = transport.timeInSamples + static_cast<Int64>(std::round(static_cast<double>(numSamples) / oversamplingFactor));
             }
             else
 				posEstimate = transport.timeInSamples;
@@ -319,7 +340,7 @@ namespace dsp
             auto lfoPhase = 0.;
             if (temposync)
             {
-                const auto latencyLengthInQuarterNotes = latency / quarterNoteLength;
+                const auto latencyLengthInQuarterNotes = latency * oversamplingFactor / quarterNoteLength;
                 const auto ppq = (ppqPosition - latencyLengthInQuarterNotes) * .25;
                 lfoPhase = ppq / rateSync;
             }
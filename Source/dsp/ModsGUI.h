@@ -12,18 +12,26 @@ namespace gui
         public Comp
     {
         using Tables = dsp::Wavetable3D<double, WTSize, NumTables>;
+        using Samples = std::array<float, NumRects>;
+
+        // the table position is quantised, so that modulating it cycles through a few cached images
+        static constexpr float NumPositions = 64.f;
 
         WavetableView(Utils& u, juce::String&& _tooltip, const Tables& _tables) :
             Comp(u, std::move(_tooltip), CursorType::Default),
             tables(_tables),
-            tablesPhase(0.f)
+            tablesPhase(0.f),
+            tablesVersion(_tables.getVersion())
         {}
             
         void update(float _tablesPhase)
         {
-            if (tablesPhase != _tablesPhase)
+            const auto phase = std::round(_tablesPhase * NumPositions) / NumPositions;
+            const auto version = tables.getVersion();
+            if (tablesPhase != phase || tablesVersion != version)
             {
-                tablesPhase = _tablesPhase;
+                tablesPhase = phase;
+                tablesVersion = version;
                 repaint();
             }
         }
@@ -31,29 +39,72 @@ namespace gui
     protected:
         const Tables& tables;
         float tablesPhase;
+        juce::uint32 tablesVersion;
 
         void paint(Graphics& g) override
         {
             const auto thicc = utils.thicc;
             const auto bounds = getLocalBounds().toFloat().reduced(thicc);
+            const auto col = Shared::shared.colour(ColourID::Mod);
+            const auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+            const auto w = static_cast<int>(std::ceil(bounds.getWidth() * scale));
+            const auto h = static_cast<int>(std::ceil(bounds.getHeight() * scale));
+
+            // the version changes with every table set, even one with the name or the address of an earlier one
+            auto key = hashCombine(static_cast<juce::int64>(RenderKey::Wavetable), static_cast<juce::int64>(tables.getVersion()));
+            key = hashCombine(key, tablesPhase);
+            key = hashCombine(key, static_cast<juce::int64>(w));
+            key = hashCombine(key, static_cast<juce::int64>(h));
+            key = hashCombine(key, col);
+
+            const auto img = utils.renderCache.find(key);
+            if (img.isValid())
+            {
+                const BoundsF boundsImg(bounds.getX(), bounds.getY(), static_cast<float>(w) / scale, static_cast<float>(h) / scale);
+                g.drawImage(img, boundsImg, juce::RectanglePlacement::stretchToFit);
+                return;
+            }
+
+            const auto samples = makeSamples();
+            const BoundsF boundsImg(0.f, 0.f, static_cast<float>(w) / scale, static_cast<float>(h) / scale);
+            utils.renderCache.render(key, w, h, [samples, boundsImg, scale, col](Graphics& gImg)
+            {
+                gImg.addTransform(juce::AffineTransform::scale(scale));
+                paintWaveform(gImg, boundsImg, samples, col);
+            }, *this);
+            paintWaveform(g, bounds, samples, col);
+        }
+
+        Samples makeSamples() const noexcept
+        {
+            static constexpr float NumRectsInv = 1.f / static_cast<float>(NumRects);
+            static constexpr float NumWaveCyclesF = static_cast<float>(NumWaveCycles);
+            Samples samples;
+            for (auto i = 0; i < NumRects; ++i)
+            {
+                const auto iX = static_cast<float>(i) * NumRectsInv;
+                auto tablePhase = iX * NumWaveCyclesF;
+                while (tablePhase >= 1.f)
+                    --tablePhase;
+                samples[i] = static_cast<float>(tables(tablesPhase, tablePhase)) * -1.f;
+            }
+            return samples;
+        }
+
+        /* graphics, bounds, samples, colour */
+        static void paintWaveform(Graphics& g, const BoundsF& bounds, const Samples& samples, Colour col)
+        {
             const auto rad = bounds.getHeight() * .5f;
             const auto midY = bounds.getY() + rad;
             static constexpr float NumRectsInv = 1.f / static_cast<float>(NumRects);
-            static constexpr float NumWaveCyclesF = static_cast<float>(NumWaveCycles);
             const auto WRatio = bounds.getWidth() * NumRectsInv;
             for (auto i = 0; i < NumRects; ++i)
             {
-                const auto iF = static_cast<float>(i);
-                const auto iX = iF * NumRectsInv;
+                const auto iX = static_cast<float>(i) * NumRectsInv;
                 auto window = std::sin(iX * Pi);
                 window *= window; window *= window;
-                auto tablePhase = iX * NumWaveCyclesF;
-                while (tablePhase >= 1.f)
-                    --tablePhase;
-                const auto smpl = static_cast<float>(tables(tablesPhase, tablePhase)) * -1.f;
-                const auto col = juce::Colours::transparentBlack
-                    .interpolatedWith(Shared::shared.colour(ColourID::Mod), window);
-                g.setColour(col);
+                const auto smpl = samples[i];
+                g.setColour(juce::Colours::transparentBlack.interpolatedWith(col, window));
                 {
                     const auto x = bounds.getX() + iX * bounds.getWidth();
                     const auto w = WRatio;
@@ -65,7 +116,6 @@ namespace gui
                     g.fillRect(x, y, w, h);
                 }
             }
-            //g.drawRoundedRectangle(bounds, thicc, thicc);
         }
     };
 
@@ -107,7 +157,8 @@ namespace gui
                 Paramtr(u, "Lerp", "Lerp linearly interpolates between the values of the noise.", withOffset(PID::Perlin0Shape, mOff), modulatables, ParameterType::RadioButton),
                 Paramtr(u, "Round", "The round shape creates smooth perlin noise.", withOffset(PID::Perlin0Shape, mOff), modulatables, ParameterType::RadioButton),
 				Paramtr(u, "Bias", "Dial it in to make higher values less likely.", withOffset(PID::Perlin0Bias, mOff), modulatables)
-            }
+            },
+            rateTypeGeneration()
         {
             for (auto& p : params)
                 addAndMakeVisible(p);
@@ -216,9 +267,13 @@ namespace gui
 
         void updateTimer() override
         {
-            bool isTempoSync = utils.getParam(params[RateType].getPID()).getValueSum() > .5f;
-            params[RateBeats].setVisible(isTempoSync);
-            params[RateHz].setVisible(!isTempoSync);
+            const auto& rateType = utils.getParam(params[RateType].getPID());
+            if (rateTypeGeneration(sumGenerations(rateType)))
+            {
+                bool isTempoSync = rateType.getValueSum() > .5f;
+                params[RateBeats].setVisible(isTempoSync);
+                params[RateHz].setVisible(!isTempoSync);
+            }
             
             for (auto& param : params)
                 param.updateTimer();
@@ -228,6 +283,7 @@ namespace gui
         Layout layout;
         int mOff;
         std::array<Paramtr, NumParams> params;
+        GenerationGate rateTypeGeneration;
     };
 
     class ModCompAudioRate :
@@ -358,8 +414,34 @@ namespace gui
             void paint(Graphics& g) override
             {
                 const auto thicc = utils.thicc;
-                g.setColour(Shared::shared.colour(ColourID::Interact));
-				Stroke stroke(thicc, Stroke::JointStyle::curved, Stroke::EndCapStyle::rounded);
+                const auto col = Shared::shared.colour(ColourID::Interact);
+				const Stroke stroke(thicc, Stroke::JointStyle::curved, Stroke::EndCapStyle::rounded);
+                const auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+                const auto w = static_cast<int>(std::ceil(static_cast<float>(getWidth()) * scale));
+                const auto h = static_cast<int>(std::ceil(static_cast<float>(getHeight()) * scale));
+
+                auto key = hashCombine(static_cast<juce::int64>(RenderKey::ADSRRel), static_cast<juce::int64>(w));
+                key = hashCombine(key, static_cast<juce::int64>(h));
+                key = hashCombine(key, thicc);
+                key = hashCombine(key, col);
+                for (const auto v : vals)
+                    key = hashCombine(key, v);
+
+                const auto img = utils.renderCache.find(key);
+                if (img.isValid())
+                {
+                    const BoundsF boundsImg(0.f, 0.f, static_cast<float>(w) / scale, static_cast<float>(h) / scale);
+                    g.drawImage(img, boundsImg, juce::RectanglePlacement::stretchToFit);
+                    return;
+                }
+
+                utils.renderCache.render(key, w, h, [p = path, stroke, scale, col](Graphics& gImg)
+                {
+                    gImg.addTransform(juce::AffineTransform::scale(scale));
+                    gImg.setColour(col);
+                    gImg.strokePath(p, stroke);
+                }, *this);
+                g.setColour(col);
                 g.strokePath(path, stroke);
             }
         };
@@ -379,7 +461,7 @@ namespace gui
                     &u.getParam(_r)
                 },
                 vals{ -1.f, -1.f, -1.f, -1.f },
-                img(Image::ARGB, 1, 1, false)
+                img()
             {
             }
 
@@ -395,37 +477,30 @@ namespace gui
                     vals[D] = dcy;
                     vals[S] = sus;
                     vals[R] = rls;
-                    updateImg();
+                    repaint();
                 }
             }
 
-            void updateImg()
+            /* graphics, bounds, vals, colour of background, colour of envelope */
+            static void paintEnvelope(Graphics& g, const BoundsF& bounds, const std::array<float, 4>& vals,
+                Colour bgCol, Colour col)
             {
-                const auto thicc = utils.thicc;
-                const auto bounds = getLocalBounds().toFloat().reduced(thicc);
                 const auto bY = bounds.getY();
                 const auto bW = bounds.getWidth();
                 const auto bH = bounds.getHeight();
-                //const auto bX = bounds.getX();
-
-                juce::Graphics g{ img };
-                const auto bgCol = Shared::shared.colour(ColourID::Bg);
-                g.fillAll(bgCol);
 
-                const auto col = Shared::shared.colour(ColourID::Interact);
+                g.setColour(bgCol);
+                g.fillRect(bounds);
                 g.setColour(col);
 
-                const auto atk = vals[A];
-                const auto dcy = vals[D];
                 const auto sus = vals[S];
-                const auto rls = vals[R];
 
                 vibrato::EnvGen envGen;
 
-                envGen.attack = atk;
-                envGen.decay = dcy;
+                envGen.attack = vals[A];
+                envGen.decay = vals[D];
                 envGen.sustain = sus;
-                envGen.release = rls;
+                envGen.release = vals[R];
 
                 envGen.prepare(100.f);
 
@@ -438,30 +513,51 @@ namespace gui
                             noteOn = false;
                     const auto hVal = bH * val;
                     const auto y = bY + bH - hVal;
-                    g.fillRect(x, y, 1.f, hVal);
+                    g.fillRect(bounds.getX() + x, y, 1.f, hVal);
                 }
-                    
-                repaint();
             }
         protected:
             std::array<Param*, 4> params;
             std::array<float, 4> vals;
 
+            // last finished image, drawn while the next one renders
             Image img;
 
             void resized() override
             {
-                const auto thicc = utils.thicc;
-                const auto b = getLocalBounds().toFloat().reduced(thicc).toNearestInt();
-
-                img = Image(Image::ARGB, b.getWidth(), b.getHeight(), true);
                 update(true);
             }
 
             void paint(Graphics& g) override
             {
-                const auto thicc = static_cast<int>(utils.thicc);
-                g.drawImageAt(img, thicc, thicc, false);
+                const auto thicc = utils.thicc;
+                const auto bounds = getLocalBounds().toFloat().reduced(thicc);
+                const auto bgCol = Shared::shared.colour(ColourID::Bg);
+                const auto col = Shared::shared.colour(ColourID::Interact);
+                const auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+                const auto w = static_cast<int>(std::ceil(bounds.getWidth() * scale));
+                const auto h = static_cast<int>(std::ceil(bounds.getHeight() * scale));
+                const BoundsF boundsImg(bounds.getX(), bounds.getY(), static_cast<float>(w) / scale, static_cast<float>(h) / scale);
+
+                auto key = hashCombine(static_cast<juce::int64>(RenderKey::ADSRAbs), static_cast<juce::int64>(w));
+                key = hashCombine(key, static_cast<juce::int64>(h));
+                key = hashCombine(key, bgCol);
+                key = hashCombine(key, col);
+                for (const auto v : vals)
+                    key = hashCombine(key, v);
+
+                const auto cached = utils.renderCache.find(key);
+                if (cached.isValid())
+                    img = cached;
+                else
+                    utils.renderCache.render(key, w, h, [v = vals, boundsImg, scale, bgCol, col](Graphics& gImg)
+                    {
+                        gImg.addTransform(juce::AffineTransform::scale(scale));
+                        paintEnvelope(gImg, boundsImg.withPosition(0.f, 0.f), v, bgCol, col);
+                    }, *this);
+
+                if (img.isValid())
+                    g.drawImage(img, boundsImg, juce::RectanglePlacement::stretchToFit);
             }
         };
 
@@ -486,6 +582,7 @@ namespace gui
                 Paramtr(u, "R", "Defines the envelope's release value.", withOffset(PID::AudioRate0Rls, mOff), modulatables)
             },
             adsr(nullptr),
+            adsrGeneration(),
             wantsToReplaceADSR(false)
         {
             adsr = std::make_unique<ADSRRel>(u, params[Atk].getPID(), params[Dcy].getPID(), params[Sus].getPID(), params[Rls].getPID());
@@ -515,7 +612,11 @@ namespace gui
             for (auto& param : params)
                 param.updateTimer();
 			
-            adsr->update(false);
+            const auto& u = utils;
+            const auto gen = sumGenerations(u.getParam(params[Atk].getPID()), u.getParam(params[Dcy].getPID()),
+                u.getParam(params[Sus].getPID()), u.getParam(params[Rls].getPID()));
+            if (adsrGeneration(gen))
+                adsr->update(false);
             if (wantsToReplaceADSR)
             {
                 removeChildComponent(adsr.get());
@@ -529,6 +630,7 @@ namespace gui
                 };
                 layout.place(*adsr, 0, 0, 4, 1, 0.f, false);
                 addAndMakeVisible(*adsr);
+                adsrGeneration.invalidate();
                 wantsToReplaceADSR = false;
             }
         }
@@ -713,7 +815,7 @@ namespace gui
 
         enum { IsSync, RateFree, RateSync, Waveform, Phase, Width, NumParams };
 
-        ModCompLFO(Utils& u, std::vector<Paramtr*>& modulatables, dsp::LFOTables& _tables, int mOff = 0) :
+        ModCompLFO(Utils& u, std::vector<Paramtr*>& modulatables, vibrato::Modulator& _modulator, int mOff = 0) :
             Comp(u, "", CursorType::Default),
             layout
             (
@@ -730,11 +832,13 @@ namespace gui
                 Paramtr(u, "Wdth", "Add a phase offset to the right channel of the LFO.", withOffset(PID::LFO0Width, mOff), modulatables)
             },
             lfoWaveformParam(u.getParam(PID::LFO0Waveform, mOff)),
-            tables(_tables),
+            modulator(_modulator),
+            tables(_modulator.getTables()),
             tableView(u, "Here you can admire this LFO's current waveform.", tables),
             wavetableBrowser(u),
             browserButton(u, "Click here to explore the wavetable browser."),
-            slowIdx(0),
+            fileChooser(),
+            isSyncGeneration(),
             isSync(false)
         {
             addAndMakeVisible(tableView);
@@ -768,6 +872,7 @@ namespace gui
                 case 2: tables.makeTablesWeierstrass(); break;
                 }
                 tableView.repaint();
+                utils.audioProcessor.markStateDirty();
             });
             setVisible(true);
         }
@@ -798,14 +903,12 @@ namespace gui
             for (auto& p : params)
                 p.updateTimer();
 
+            // the view checks the table version itself, tables change without a parameter
             tableView.update(lfoWaveformParam.getValueSum());
 
-            ++slowIdx;
-            if (slowIdx < 8)
-                return;
-            slowIdx = 0;
-
             const auto& isSyncParam = utils.getParam(params[IsSync].getPID());
+            if (!isSyncGeneration(sumGenerations(isSyncParam)))
+                return;
             isSync = isSyncParam.getValueSum() > .5f;
             params[RateSync].setVisible(isSync);
             params[RateFree].setVisible(!isSync);
@@ -815,14 +918,63 @@ namespace gui
         Layout layout;
         std::array<Paramtr, NumParams> params;
         const Param& lfoWaveformParam;
+        vibrato::Modulator& modulator;
         dsp::LFOTables& tables;
         WTView tableView;
         Browser wavetableBrowser;
         Button browserButton;
-        int slowIdx;
+        std::unique_ptr<juce::FileChooser> fileChooser;
+        GenerationGate isSyncGeneration;
         bool isSync;
         
     private:
+        void onTablesChanged()
+        {
+            tableView.repaint();
+            wavetableBrowser.setVisible(false);
+            utils.audioProcessor.markStateDirty();
+        }
+
+        /* source, see dsp::WavetableLibrary */
+        void importTables(const String& source)
+        {
+            modulator.importTables(source, [safe = juce::Component::SafePointer<ModCompLFO>(this)](const String& error)
+            {
+                if (safe == nullptr)
+                    return;
+                if (error.isNotEmpty())
+                    return juce::AlertWindow::showMessageBoxAsync(juce::AlertWindow::WarningIcon, "Wavetable Import", error);
+                safe->onTablesChanged();
+            });
+        }
+
+        void browseFile()
+        {
+            fileChooser = std::make_unique<juce::FileChooser>("Import Wavetable", juce::File(), "*.wav;*.aif;*.aiff;*.flac");
+            fileChooser->launchAsync(juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles,
+                [this](const juce::FileChooser& chooser)
+            {
+                const auto file = chooser.getResult();
+                if (file.existsAsFile())
+                    importTables(dsp::WavetableLibrary::makeSourceFile(file));
+            });
+        }
+
+        void enterFormula()
+        {
+            auto window = new juce::AlertWindow("Wavetable Formula",
+                "Enter a formula of x[-1, 1] per frame, separated by ';'.", juce::AlertWindow::NoIcon, this);
+            window->addTextEditor("formula", "sin(x * 3.1416); sin(x * 3.1416) * abs(x)");
+            window->addButton("Import", 1, juce::KeyPress(juce::KeyPress::returnKey));
+            window->addButton("Cancel", 0, juce::KeyPress(juce::KeyPress::escapeKey));
+            window->enterModalState(true, juce::ModalCallbackFunction::create(
+                [safe = juce::Component::SafePointer<ModCompLFO>(this), window](int result)
+            {
+                if (safe != nullptr && result == 1)
+                    safe->importTables(dsp::WavetableLibrary::makeSourceFormula(window->getTextEditorContents("formula")));
+            }), true);
+        }
+
         void initWavetableBrowser()
         {
             addChildComponent(wavetableBrowser);
@@ -834,8 +986,7 @@ namespace gui
                 [this]()
                 {
                     tables.makeTablesWeierstrass();
-                    tableView.repaint();
-                    wavetableBrowser.setVisible(false);
+                    onTablesChanged();
                 }
             );
             wavetableBrowser.addEntry
@@ -845,8 +996,7 @@ namespace gui
                 [this]()
                 {
                     tables.makeTablesTriangles();
-                    tableView.repaint();
-                    wavetableBrowser.setVisible(false);
+                    onTablesChanged();
                 }
             );
             wavetableBrowser.addEntry
@@ -856,8 +1006,7 @@ namespace gui
                 [this]()
                 {
                     tables.makeTablesSinc();
-                    tableView.repaint();
-                    wavetableBrowser.setVisible(false);
+                    onTablesChanged();
                 }
             );
             wavetableBrowser.addEntry
@@ -867,8 +1016,7 @@ namespace gui
                 [this]()
                 {
                     tables.makeTablesPWMSine();
-                    tableView.repaint();
-                    wavetableBrowser.setVisible(false);
+                    onTablesChanged();
                 }
             );
 			wavetableBrowser.addEntry
@@ -878,10 +1026,27 @@ namespace gui
 				[this]()
 				{
 					tables.makeSqueeze();
-					tableView.repaint();
-					wavetableBrowser.setVisible(false);
+					onTablesChanged();
 				}
 			);
+            wavetableBrowser.addEntry
+            (
+                "Import File",
+                "Load a wavetable from an audio file, that consists of single cycles of 2048 samples each, or of only one cycle.",
+                [this]()
+                {
+                    browseFile();
+                }
+            );
+            wavetableBrowser.addEntry
+            (
+                "Formula",
+                "Make a wavetable from formulas. Each one is a waveform and the wavetable morphs between them.",
+                [this]()
+                {
+                    enterFormula();
+                }
+            );
         }
     };
 
@@ -992,7 +1157,7 @@ namespace gui
 
     public:
         ModComp(Utils& u, std::vector<Paramtr*>& modulatables,
-            dsp::LFOTables& _tables, int _mOff = 0) :
+            vibrato::Modulator& _modulator, int _mOff = 0) :
             Comp(u, makeNotify(*this), "", CursorType::Default),
             layout
             (
@@ -1012,11 +1177,13 @@ namespace gui
             envFol(u, modulatables, mOff),
             macro(u, modulatables, mOff),
             pitchbend(u, modulatables, mOff),
-            lfo(u, modulatables, _tables, mOff),
+            lfo(u, modulatables, _modulator, mOff),
 
             randomizer(u),
             selectorButton(u, "Select another modulator for this slot."),
-            selector(u, *this)
+            selector(u, *this),
+            stateGeneration(),
+            mixGeneration()
         {
             label.font = Shared::shared.font;
             label.just = Just::left;
@@ -1159,9 +1326,11 @@ namespace gui
             }
         }
 
+        /* the mod type and the mix are only reread when the state or the mix moved */
         void updateTimer() override
         {
-			setMod(getModType());
+            if (stateGeneration(utils.audioProcessor.stateGeneration.load(std::memory_order_acquire)))
+                setMod(getModType());
 
             switch (modType)
             {
@@ -1186,6 +1355,8 @@ namespace gui
             }
 
             const auto& param = utils.getParam(PID::ModsMix);
+            if (!mixGeneration(sumGenerations(param)))
+                return;
             const auto valSum = param.getValueSum();
             const auto v = mOff == 0 ? 1.f - valSum : valSum;
             if (modDepth == v)
@@ -1213,6 +1384,7 @@ namespace gui
         Button selectorButton;
 
         Selector selector;
+        GenerationGate stateGeneration, mixGeneration;
     };
 }
 
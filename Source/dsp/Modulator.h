@@ -6,9 +6,13 @@
 #include "Smooth.h"
 #include "Perlin2.h"
 #include "Wavetable.h"
+#include "WavetableLibrary.h"
 #include "LFO2.h"
 #include "Macro.h"
 #include "EnvelopeFollower.h"
+#include "ControlRate.h"
+#include "Channels.h"
+#include "CurveCache.h"
 
 #define DebugAudioRateEnv false
 
@@ -146,6 +150,13 @@ namespace vibrato
 			return phase;
 		}
 
+		/* numSamples, advances the phase without synthesizing it */
+		void skip(int numSamples) noexcept
+		{
+			phase += inc * static_cast<Float>(numSamples);
+			phase -= std::floor(phase);
+		}
+
 		Float phase, inc;
 	protected:
 		Float fs, fsInv;
@@ -265,7 +276,11 @@ namespace vibrato
 			using PlayHeadPos = perlin2::PlayHeadPos;
 			using Shape = perlin2::Shape;
 
+			// 40hz with 7 octaves reaches higher, but those octaves are 30db down
+			static constexpr double BandwidthHz = 1000.;
+
 			Perlin() :
+				controlRate(),
 				perlin(),
 				rateHz(1.), rateBeats(1.),
 				octaves(1.), width(0.), phs(0.), bias(0.),
@@ -276,7 +291,17 @@ namespace vibrato
 
 			void prepare(double sampleRate, int blockSize, int latency, int osFactor)
 			{
-				perlin.prepare(sampleRate, blockSize, latency, osFactor);
+				controlRate.prepare(sampleRate, blockSize, BandwidthHz);
+				const auto decimation = controlRate.getDecimation();
+				// the expanded curve lags behind, so it syncs to the transport that much earlier
+				const auto lag = controlRate.getLag() / osFactor;
+				perlin.prepare
+				(
+					sampleRate / static_cast<double>(decimation),
+					controlRate.getMaxNumPoints(blockSize),
+					latency - lag,
+					static_cast<double>(osFactor) / static_cast<double>(decimation)
+				);
 			}
 
 			void setParameters(double _rateHz, double _rateBeats,
@@ -297,22 +322,21 @@ namespace vibrato
 				const PosInfo& transport) noexcept
 			{
 				double* samples[2] = { buffer[0].data(), buffer[1].data() };
-				
-				perlin
-				(
-					samples,
-					numChannels,
-					numSamples,
-					transport,
-					rateHz,
-					rateBeats,
-					octaves,
-					width,
-					phs,
-					bias,
-					shape,
-					temposync
-				);
+				if (!controlRate.isDecimating())
+					return synthesize(samples, numChannels, numSamples, transport);
+
+				const auto numPoints = controlRate.getNumPoints(numSamples);
+				if (numPoints != 0)
+					synthesize(controlRate.getPoints(), numChannels, numPoints, controlRate.shift(transport));
+				controlRate.expand(samples, numChannels, numSamples);
+			}
+
+			void skip(int numSamples, const PosInfo& transport) noexcept
+			{
+				const auto numPoints = controlRate.getNumPoints(numSamples);
+				if (numPoints != 0)
+					perlin.skip(numPoints, controlRate.shift(transport), rateHz, rateBeats, temposync);
+				controlRate.skip(numSamples);
 			}
 		
 			const int getSeed() const noexcept
@@ -320,17 +344,55 @@ namespace vibrato
 				return perlin.seed.load();
 			}
 
+			/* transport, numChannels, everything the curve depends on besides the position.
+			the noise is brought up to date first, so the key has the seed the curve is made of */
+			dsp::CurveCache::Key getKey(const PosInfo& transport, int numChannels) noexcept
+			{
+				perlin.updateNoise();
+				return dsp::CurveCache::makeKey
+				({
+					static_cast<double>(ModType::Perlin),
+					rateHz, rateBeats, octaves, width, phs, bias,
+					static_cast<double>(shape),
+					temposync ? 1. : 0.,
+					static_cast<double>(perlin.getNoiseSeed()),
+					transport.bpm,
+					static_cast<double>(numChannels)
+				});
+			}
+
 			void setSeed(int s) noexcept
 			{
 				perlin.setSeed(s);
 			}
 
 		protected:
+			dsp::ControlRate controlRate;
 			perlin2::Perlin2 perlin;
 			double rateHz, rateBeats;
 			double octaves, width, phs, bias;
 			Shape shape;
 			bool temposync;
+
+			void synthesize(double* const* samples, int numChannels, int numSamples,
+				const PosInfo& transport) noexcept
+			{
+				perlin
+				(
+					samples,
+					numChannels,
+					numSamples,
+					transport,
+					rateHz,
+					rateBeats,
+					octaves,
+					width,
+					phs,
+					bias,
+					shape,
+					temposync
+				);
+			}
 		};
 
 		class AudioRate
@@ -423,79 +485,14 @@ namespace vibrato
 			{
 				auto bufEnv = buffer[2].data();
 
-				{ // SYNTHESIZE MIDI NOTE VALUES (0-127), PITCHBEND AND ENVELOPE
-					auto bufNotes = buffer[1].data();
-					auto currentValue = noteValue + pitchbendValue;
-					if (midi.isEmpty())
-					{
-						for (auto s = 0; s < numSamples; ++s)
-						{
-							bufNotes[s] = currentValue;
-							bufEnv[s] = env();
-						}
-					}	
-					else
-					{
-						auto evt = midi.begin();
-						auto ref = *evt;
-						auto ts = ref.samplePosition;
-						for (auto s = 0; s < numSamples; ++s)
-						{
-							if (ts > s)
-							{
-								bufNotes[s] = currentValue;
-								bufEnv[s] = env();
-							}
-							else
-							{
-								bool noteOn = env.noteOn;
-								while (ts == s)
-								{
-									auto msg = ref.getMessage();
-									if (msg.isNoteOn())
-									{
-										noteValue = static_cast<double>(msg.getNoteNumber());
-										currentValue = noteValue + pitchbendValue;
-										noteOn = true;
-										env.retrig();
-									}
-									else if (msg.isNoteOff())
-									{
-										if(static_cast<int>(noteValue) == msg.getNoteNumber())
-											noteOn = false;
-									}
-									else if (msg.isPitchWheel())
-									{
-										const auto pwv = msg.getPitchWheelValue();
-										pitchbendValue = static_cast<double>(pwv) * PBGain - 1.;
-										currentValue = noteValue + pitchbendValue;
-									}
-									++evt;
-									if (evt == midi.end())
- 										ts = numSamples;
-									else
-									{
-										ref = *evt;
-										ts = ref.samplePosition;
-									}
-								}
-								bufNotes[s] = currentValue;
-								bufEnv[s] = env(noteOn);
-							}
-						}
-					}
-				}
+				synthesizeNotes(buffer, midi, numSamples);
 				{ // ADD OCT+SEMI+FINE SHIFT TO MIDI NOTE VALUE
 					for (auto s = 0; s < numSamples; ++s)
 						buffer[1][s] += noteOffset;
 				}
 				{ // CONVERT MIDI NOTE VALUES TO FREQUENCIES HZ
 					for (auto s = 0; s < numSamples; ++s)
-					{
-						const auto midiN = buffer[1][s];
-						const auto freq = 440. * std::pow(2., (midiN - 69.) * .083333333333);
-						buffer[1][s] = juce::jlimit(1., 22049., freq);
-					}
+						buffer[1][s] = noteToFreq(buffer[1][s]);
 				}
 				// PROCESS RETUNE SPEED OF OSC (FILTER CUTOFF)
 				auto retuningNow = retuneSpeedSmooth(buffer[1].data(), numSamples);
@@ -574,10 +571,28 @@ namespace vibrato
 				}
 #endif
 			}
+
+			/* number of a midi note, incl. pitchbend and offset */
+			static double noteToFreq(double midiN) noexcept
+			{
+				const auto freq = 440. * std::pow(2., (midiN - 69.) * .083333333333);
+				return juce::jlimit(1., 22049., freq);
+			}
+
+			/* buffer, midi, numSamples
+			advances the oscillator to where it would be at the pitch of the current note,
+			notes and envelope are still processed so that they don't miss any midi events */
+			void skip(Buffer& buffer, const juce::MidiBuffer& midi, int numSamples) noexcept
+			{
+				synthesizeNotes(buffer, midi, numSamples);
+				auto& osci = osc[0];
+				osci.setFrequencyHz(noteToFreq(noteValue + pitchbendValue + noteOffset));
+				osci.phasor.skip(numSamples);
+			}
 			
 		protected:
 			SmoothD retuneSpeedSmooth, widthSmooth;
-			std::vector<double> widthBuf;
+			dsp::Scratch<double> widthBuf;
 			
 			std::vector<Osc> osc;
 			EnvGen env;
@@ -585,6 +600,72 @@ namespace vibrato
 
 			double noteOffset, width, retuneSpeed, attack, decay, sustain, release;
 			double Fs;
+
+			// SYNTHESIZE MIDI NOTE VALUES (0-127), PITCHBEND AND ENVELOPE
+			void synthesizeNotes(Buffer& buffer, const juce::MidiBuffer& midi, int numSamples) noexcept
+			{
+				auto bufEnv = buffer[2].data();
+				auto bufNotes = buffer[1].data();
+				auto currentValue = noteValue + pitchbendValue;
+				if (midi.isEmpty())
+				{
+					for (auto s = 0; s < numSamples; ++s)
+					{
+						bufNotes[s] = currentValue;
+						bufEnv[s] = env();
+					}
+				}	
+				else
+				{
+					auto evt = midi.begin();
+					auto ref = *evt;
+					auto ts = ref.samplePosition;
+					for (auto s = 0; s < numSamples; ++s)
+					{
+						if (ts > s)
+						{
+							bufNotes[s] = currentValue;
+							bufEnv[s] = env();
+						}
+						else
+						{
+							bool noteOn = env.noteOn;
+							while (ts == s)
+							{
+								auto msg = ref.getMessage();
+								if (msg.isNoteOn())
+								{
+									noteValue = static_cast<double>(msg.getNoteNumber());
+									currentValue = noteValue + pitchbendValue;
+									noteOn = true;
+									env.retrig();
+								}
+								else if (msg.isNoteOff())
+								{
+									if(static_cast<int>(noteValue) == msg.getNoteNumber())
+										noteOn = false;
+								}
+								else if (msg.isPitchWheel())
+								{
+									const auto pwv = msg.getPitchWheelValue();
+									pitchbendValue = static_cast<double>(pwv) * PBGain - 1.;
+									currentValue = noteValue + pitchbendValue;
+								}
+								++evt;
+								if (evt == midi.end())
+ 										ts = numSamples;
+								else
+								{
+									ref = *evt;
+									ts = ref.samplePosition;
+								}
+							}
+							bufNotes[s] = currentValue;
+							bufEnv[s] = env(noteOn);
+						}
+					}
+				}
+			}
 		};
 
 		struct EnvFol
@@ -728,7 +809,11 @@ namespace vibrato
 		
 		struct LFO
 		{
+			// 40hz with the first 25 harmonics of the wavetables
+			static constexpr double BandwidthHz = 1000.;
+
 			LFO(const Tables& _tables) :
+				controlRate(),
 				lfo(_tables),
 				rateHz(0.),
 				rateSync(0.),
@@ -741,12 +826,16 @@ namespace vibrato
 			/* fs, blockSize, latency, oversamplingFactor */
 			void prepare(double fs, int blockSize, double latency, int oversamplingFactor)
 			{
+				controlRate.prepare(fs, blockSize, BandwidthHz);
+				const auto decimation = static_cast<double>(controlRate.getDecimation());
+				// the expanded curve lags behind, so it syncs to the transport that much earlier
+				const auto lag = static_cast<double>(controlRate.getLag()) / static_cast<double>(oversamplingFactor);
 				lfo.prepare
 				(
-					fs,
-					blockSize,
-					latency,
-					oversamplingFactor
+					fs / decimation,
+					controlRate.getMaxNumPoints(blockSize),
+					latency - lag,
+					static_cast<double>(oversamplingFactor) / decimation
 				);
 			}
 			
@@ -766,7 +855,47 @@ namespace vibrato
 				const PosInfo& transport) noexcept
 			{
 				double* samples[] = { buffer[0].data(), buffer[1].data() };
+				if (!controlRate.isDecimating())
+					return synthesize(samples, numChannels, numSamples, transport);
+
+				const auto numPoints = controlRate.getNumPoints(numSamples);
+				if (numPoints != 0)
+					synthesize(controlRate.getPoints(), numChannels, numPoints, controlRate.shift(transport));
+				controlRate.expand(samples, numChannels, numSamples);
+			}
 
+			void skip(int numSamples, const PosInfo& transport) noexcept
+			{
+				const auto numPoints = controlRate.getNumPoints(numSamples);
+				if (numPoints != 0)
+					lfo.skip(numPoints, controlRate.shift(transport), rateHz, rateSync, temposync);
+				controlRate.skip(numSamples);
+			}
+
+			/* transport, tables, numChannels, everything the curve depends on besides the position */
+			dsp::CurveCache::Key getKey(const PosInfo& transport, const Tables& tables, int numChannels) const noexcept
+			{
+				return dsp::CurveCache::makeKey
+				({
+					static_cast<double>(ModType::LFO),
+					rateHz, rateSync, phase, width, wtPos,
+					temposync ? 1. : 0.,
+					static_cast<double>(tables.getVersion()),
+					transport.bpm,
+					static_cast<double>(numChannels)
+				});
+			}
+		
+		protected:
+			dsp::ControlRate controlRate;
+			dsp::LFO_Procedural lfo;
+			double rateHz, rateSync;
+			double phase, width, wtPos;
+			bool temposync;
+
+			void synthesize(double* const* samples, int numChannels, int numSamples,
+				const PosInfo& transport) noexcept
+			{
 				lfo
 				(
 					samples,
@@ -781,12 +910,6 @@ namespace vibrato
 					temposync
 				);
 			}
-		
-		protected:
-			dsp::LFO_Procedural lfo;
-			double rateHz, rateSync;
-			double phase, width, wtPos;
-			bool temposync;
 		};
 
 	public:
@@ -799,8 +922,10 @@ namespace vibrato
 			macro(),
 			pitchbend(),
 			lfo(tables),
-			
-			type(ModType::Perlin)
+			library(),
+			cache(),
+			type(ModType::Perlin),
+			cacheEnabled(false)
 		{
 			tables.makeTablesWeierstrass();
 		}
@@ -816,6 +941,10 @@ namespace vibrato
 					state.appendChild(child, nullptr);
 				}
 				child.setProperty(id, tables.name, nullptr);
+				if (tables.source.isNotEmpty())
+					child.setProperty("source", tables.source, nullptr);
+				else
+					child.removeProperty("source", nullptr);
 			}
 			const auto firstTime = static_cast<bool>(state.getProperty("firstTimeUwU", true));
 			if(firstTime)
@@ -831,12 +960,16 @@ namespace vibrato
 			}
 		}
 
-		void loadPatch(ValueTree& state, int mIdx)
+		/* state, mIdx, synchronous. synchronous imports wavetables right away, see importTables */
+		void loadPatch(ValueTree& state, int mIdx, bool synchronous = false)
 		{
 			{
 				const Identifier id(toString(ObjType::Wavetable) + String(mIdx));
 				const auto child = state.getChildWithName(id);
-				if (child.isValid())
+				const auto source = child.getProperty("source").toString();
+				if (source.isNotEmpty())
+					importTables(source, nullptr, synchronous);
+				else if (child.isValid())
 				{
 					const auto tableType = child.getProperty(id).toString();
 					if (tableType == toString(dsp::TableType::Weierstrass))
@@ -862,10 +995,41 @@ namespace vibrato
 			}
 		}
 
+		/* source, onDone(error), synchronous
+		switches to an imported wavetable, see dsp::WavetableLibrary.
+		if it wasn't imported before, that happens in the background and the tables switch on the message thread
+		once it's done, unless another table was picked in the meantime. so name and source are only ever written
+		by the message thread, or by the thread that loads the patch while it's synchronous, f.ex. offline */
+		void importTables(const String& source, std::function<void(const String&)>&& onDone = nullptr, bool synchronous = false)
+		{
+			const auto versionBefore = tables.getVersion();
+			library->load(source, [ref = juce::WeakReference<Modulator>(this), versionBefore, source, done = std::move(onDone)]
+				(const Tables::Table* table, const String& error)
+			{
+				if (ref == nullptr)
+					return;
+				if (table != nullptr && ref->tables.getVersion() == versionBefore)
+					ref->tables.setTable(*table, dsp::WavetableLibrary::getName(source), source);
+				if (done)
+					done(error);
+			}, synchronous);
+		}
+
 		void setType(ModType t) noexcept
 		{
 			type = t;
 		}
+
+		/* lfo and perlin remember their curves for looped playback, see dsp::CurveCache. takes effect on prepare */
+		void setCacheEnabled(bool e) noexcept
+		{
+			cacheEnabled = e;
+		}
+
+		bool isCacheEnabled() const noexcept
+		{
+			return cache.isEnabled();
+		}
 		
 		void prepare(double sampleRate, int maxBlockSize, int latency, int oversamplingFactor)
 		{
@@ -877,6 +1041,7 @@ namespace vibrato
 			macro.prepare(sampleRate, maxBlockSize);
 			pitchbend.prepare(sampleRate);
 			lfo.prepare(sampleRate, maxBlockSize, static_cast<double>(latency), oversamplingFactor);
+			cache.prepare(sampleRate, static_cast<double>(oversamplingFactor), cacheEnabled);
 		}
 
 		int getSeed() const noexcept
@@ -923,14 +1088,51 @@ namespace vibrato
 			const juce::MidiBuffer& midi, const PosInfo& transport,
 			int numChannels, int numSamples) noexcept
 		{
+			// the other channels of a bigger layout are spread in between, see dsp::spread
+			numChannels = std::min(numChannels, dsp::NumModChannels);
+			double* curves[] = { buffer[0].data(), buffer[1].data() };
 			switch (type)
 			{
-			case ModType::Perlin: return perlin(buffer, numChannels, numSamples, transport);
+			case ModType::Perlin: return cache
+			(
+				curves, numChannels, numSamples, transport,
+				perlin.getKey(transport, numChannels),
+				[&]() { perlin(buffer, numChannels, numSamples, transport); },
+				[&]() { perlin.skip(numSamples, transport); }
+			);
 			case ModType::AudioRate: return audioRate(buffer, midi, numChannels, numSamples);
 			case ModType::EnvFol: return envFol(buffer, samples, samplesSC, numChannels, numSamples);
 			case ModType::Macro: return macro(buffer, samplesSC, numChannels, numSamples);
 			case ModType::Pitchwheel: return pitchbend(buffer, numChannels, numSamples, midi);
-			case ModType::LFO: return lfo(buffer, numChannels, numSamples, transport);
+			case ModType::LFO: return cache
+			(
+				curves, numChannels, numSamples, transport,
+				lfo.getKey(transport, tables, numChannels),
+				[&]() { lfo(buffer, numChannels, numSamples, transport); },
+				[&]() { lfo.skip(numSamples, transport); }
+			);
+			}
+		}
+
+		/* samples, samplesSC, midi, transport, numChannels, numSamples
+		for when the output isn't needed: the expensive modulators only advance their phase,
+		so that they carry on seamlessly once they're needed again.
+		the cheap ones depend on every sample of their input, so they are processed anyway.
+		buffer doesn't contain the modulation afterwards */
+		void skip(const double* const* samples, const double* const* samplesSC,
+			const juce::MidiBuffer& midi, const PosInfo& transport,
+			int numChannels, int numSamples) noexcept
+		{
+			switch (type)
+			{
+			case ModType::Perlin:
+				cache.skip();
+				return perlin.skip(numSamples, transport);
+			case ModType::AudioRate: return audioRate.skip(buffer, midi, numSamples);
+			case ModType::LFO:
+				cache.skip();
+				return lfo.skip(numSamples, transport);
+			default: return processBlock(samples, samplesSC, midi, transport, numChannels, numSamples);
 			}
 		}
 		
@@ -954,8 +1156,13 @@ namespace vibrato
 		Macro macro;
 		Pitchbend pitchbend;
 		LFO lfo;
+		juce::SharedResourcePointer<dsp::WavetableLibrary> library;
+		dsp::CurveCache cache;
 
 		ModType type;
+		bool cacheEnabled;
+
+		JUCE_DECLARE_WEAK_REFERENCEABLE(Modulator)
 	};
 }
 
@@ -1,6 +1,6 @@
 #pragma once
 #include "Smooth.h"
-#include <vector>
+#include "Arena.h"
 
 namespace dsp
 {
@@ -64,7 +64,7 @@ namespace dsp
 
 	protected:
 		smooth::Smooth<Float> smooth;
-		std::vector<Float> buf;
+		Scratch<Float> buf;
 		Float value;
 	};
 
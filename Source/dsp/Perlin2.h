@@ -1,6 +1,8 @@
 #pragma once
 #include <array>
+#include <atomic>
 #include <random>
+#include <thread>
 #include "../Interpolation.h"
 #include "PRM.h"
 #include "Phasor.h"
@@ -65,8 +67,8 @@ namespace perlin2
 
 	inline void generateProceduralNoise(double* noise, int size, unsigned int seed)
 	{
-		std::random_device rd;
-		std::mt19937 mt(rd());
+		// reseeded for every sample anyway, so no need for std::random_device
+		std::mt19937 mt;
 		std::uniform_real_distribution<float> dist(-.8f, .8f); // compensate spline overshoot
 
 		for (auto s = 0; s < size; ++s, ++seed)
@@ -145,6 +147,12 @@ namespace perlin2
 			phasor.inc = rateHzInv;
 		}
 
+		/* numSamples, advances phase and noise index without synthesizing */
+		void skip(int numSamples) noexcept
+		{
+			noiseIdx = (noiseIdx + phasor.skip(numSamples)) & NoiseSizeMax;
+		}
+
 		/* samples, noise, gainBuffer,
 		octavesInfo, phsInfo, widthInfo,
 		shape, numChannels, numSamples */
@@ -166,7 +174,7 @@ namespace perlin2
 
 		// phase
 		PhasorD phasor;
-		std::vector<double> phaseBuffer;
+		dsp::Scratch<double> phaseBuffer;
 		int noiseIdx;
 
 	protected:
@@ -348,6 +356,17 @@ namespace perlin2
 	using Mixer = dsp::XFadeMixer<NumPerlins, true>;
 	using Perlins = std::array<Perlin, NumPerlins>;
 	using Int64 = juce::int64;
+	// one more than tracks, so a new noise never has to overwrite one that is still audible
+	static constexpr int NumNoises = NumPerlins + 1;
+	using Noises = std::array<Perlin::NoiseArray, NumNoises>;
+
+	/* noise, seed. the noise of a seed and the overshoot the interpolators read past its end */
+	inline void generateNoise(Perlin::NoiseArray& noise, int seed)
+	{
+		generateProceduralNoise(noise.data(), Perlin::NoiseSize, static_cast<unsigned int>(seed));
+		for (auto i = 0; i < Perlin::NoiseOvershoot; ++i)
+			noise[Perlin::NoiseSize + i] = noise[i];
+	}
 
 	struct Perlin2
 	{
@@ -358,7 +377,9 @@ namespace perlin2
 			// misc
 			sampleRateInv(1.),
 			// perlin / noise
-			noise(),
+			noises(),
+			noiseSeeds(),
+			trackNoise(),
 			gainBuffer(),
 			perlins(),
 			// parameters
@@ -371,29 +392,71 @@ namespace perlin2
 			bpm(1.), bps(1.),
 			// noise seed
 			seed(),
+			noisePending(),
+			seedPending(0),
+			mail(MailEmpty),
+			noiseGenerated(false),
 			// project position
 			posEstimate(-1),
-			oversamplingFactor(1),
+			oversamplingFactor(1.),
 			latency(0)
 		{
+			// the noise itself is generated on prepare, unless setSeed did it before,
+			// because a loaded patch usually replaces the seed anyway
 			juce::Random rand;
-			setSeed(rand.nextInt());
-
-			for (auto s = 0; s < Perlin::NoiseOvershoot; ++s)
-				noise[Perlin::NoiseSize + s] = noise[s];
+			seed.store(rand.nextInt());
 
 			for (auto o = 0; o < gainBuffer.size(); ++o)
 				gainBuffer[o] = 1. / static_cast<double>(1 << o);
 		}
 
+		/* _seed, any thread but the audio thread. generates the noise of the seed right here,
+		reseeding for each point of it takes some tens of microseconds. the audio thread crossfades to it, see updateNoise */
 		void setSeed(int _seed)
 		{
 			seed.store(_seed);
-			generateProceduralNoise(noise.data(), Perlin::NoiseSize, static_cast<unsigned int>(_seed));
+			while (true)
+			{
+				auto state = mail.load(std::memory_order_relaxed);
+				if (state == MailEmpty || state == MailFull)
+				{
+					if (mail.compare_exchange_weak(state, MailWriting, std::memory_order_acquire))
+						break;
+				}
+				else
+					// the audio thread only takes as long as copying the noise
+					std::this_thread::yield();
+			}
+			generateNoise(noisePending, _seed);
+			seedPending = _seed;
+			mail.store(MailFull, std::memory_order_release);
+		}
+
+		/* audio thread. takes the noise setSeed generated and crossfades to it, like to a new rate */
+		void updateNoise() noexcept
+		{
+			receiveNoise(true);
+		}
+
+		/* the seed the noise of the newest track was generated from, audio thread */
+		int getNoiseSeed() const noexcept
+		{
+			return noiseSeeds[trackNoise[mixer.idx]];
 		}
 
-		void prepare(double fs, int blockSize, int _latency, int _oversamplingFactor)
+		/* fs, blockSize, latency in host samples, oversamplingFactor (samples per host sample) */
+		void prepare(double fs, int blockSize, int _latency, double _oversamplingFactor)
 		{
+			receiveNoise(false);
+			if (!noiseGenerated)
+			{
+				const auto s = seed.load();
+				generateNoise(noises[0], s);
+				noiseSeeds[0] = s;
+				trackNoise.fill(0);
+				noiseGenerated = true;
+			}
+
 			latency = _latency;
 
 			oversamplingFactor = _oversamplingFactor;
@@ -416,6 +479,7 @@ namespace perlin2
 			double octaves, double width, double phs, double bias,
 			Shape shape, bool temposync) noexcept
 		{
+			updateNoise();
 			const auto octavesInfo = octavesPRM(octaves, numSamples);
 			const auto phsInfo = phsPRM(phs, numSamples);
 			const auto widthInfo = widthPRM(width, numSamples);
@@ -433,7 +497,7 @@ namespace perlin2
 					perlins[0]
 					(
 						xSamples,
-						noise.data(),
+						noises[trackNoise[0]].data(),
 						gainBuffer.data(),
 						octavesInfo,
 						phsInfo,
@@ -463,7 +527,7 @@ namespace perlin2
 					perlins[i]
 					(
 						xSamples,
-						noise.data(),
+						noises[trackNoise[i]].data(),
 						gainBuffer.data(),
 						octavesInfo,
 						phsInfo,
@@ -480,22 +544,43 @@ namespace perlin2
 			processBias(samples, bias, numChannels, numSamples);
 		}
 
+		/* numSamples, playHeadPos, rateHz, rateBeats, temposync
+		keeps position and crossfades going while the output isn't needed,
+		so that it resumes where it would have been */
+		void skip(int numSamples, const PlayHeadPos& transport,
+			double _rateHz, double _rateBeats, bool temposync) noexcept
+		{
+			updatePerlin(transport, _rateBeats, _rateHz, numSamples, temposync);
+			for (auto i = 0; i < NumPerlins; ++i)
+				if (mixer[i].isEnabled())
+					perlins[i].skip(numSamples);
+			mixer.skip(numSamples);
+		}
+
 		Mixer mixer;
 		// misc
 		double sampleRateInv;
-		// noise
-		Perlin::NoiseArray noise;
+		// noise, the tables and their seeds, and the table each track reads
+		Noises noises;
+		std::array<int, NumNoises> noiseSeeds;
+		std::array<int, NumPerlins> trackNoise;
 		Perlin::GainBuffer gainBuffer;
 		Perlins perlins;
 		// parameters
 		PRM octavesPRM, widthPRM, phsPRM;
 		double rateBeats, rateHz;
 		double inc, bpm, bps, rateInv;
-		// seed
+		// seed, the requested one. its noise waits in the mailbox until the audio thread takes it
+		enum { MailEmpty, MailWriting, MailFull, MailReading };
 		std::atomic<int> seed;
+		Perlin::NoiseArray noisePending;
+		int seedPending;
+		std::atomic<int> mail;
+		bool noiseGenerated;
 		// project position
 		Int64 posEstimate;
-		int oversamplingFactor, latency;
+		double oversamplingFactor;
+		int latency;
 
 		void updatePerlin(const PlayHeadPos& transport,
 			double _rateBeats, double _rateHz, int numSamples, bool temposync) noexcept
@@ -505,7 +590,7 @@ namespace perlin2
 			if (transport.isPlaying)
 			{
 				updatePosition(perlins[mixer.idx], transport.ppqPosition, transport.timeInSeconds, temposync);
-				posEstimate = transport.timeInSamples + numSamples / oversamplingFactor;
+				posEstimate = transport.timeInSamples + static_cast<Int64>(std::round(static_cast<double>(numSamples) / oversamplingFactor));
 			}
 			else
 				posEstimate = transport.timeInSamples;
@@ -533,7 +618,7 @@ namespace perlin2
 		{
 			if (temposync)
 			{
-				const auto latencyInPPQ = latency * bps * sampleRateInv;
+				const auto latencyInPPQ = latency * bps * sampleRateInv * oversamplingFactor;
 				const auto ppq = ppqPosition - latencyInPPQ;
 				const auto nPhase = ppq * rateInv + .5;
 				perlin.updatePosition(nPhase);
@@ -548,8 +633,9 @@ namespace perlin2
 		// CROSSFADE FUNCS
 		bool isLooping(Int64 timeInSamples) noexcept
 		{
-			const auto error = std::abs(timeInSamples - posEstimate);
-			return error > 1;
+			// below the host rate the estimate is only as precise as one sample at this rate
+			const auto error = static_cast<double>(std::abs(timeInSamples - posEstimate));
+			return error > std::max(1., std::ceil(1. / oversamplingFactor));
 		}
 
 		const bool keepsSpeed(double nBpm, double nInc) const noexcept
@@ -571,10 +657,51 @@ namespace perlin2
 			rateInv = nRateInv;
 			rateHz = _rateHz;
 			rateBeats = _rateBeats;
+			const auto table = trackNoise[mixer.idx];
 			mixer.init();
+			trackNoise[mixer.idx] = table;
 			perlins[mixer.idx].updateSpeed(inc);
 		}
 
+		/* xfade. takes the noise out of the mailbox into a table no other track reads.
+		with xfade the next track plays it from where the current one is, otherwise every track does */
+		void receiveNoise(bool xfade) noexcept
+		{
+			auto expected = static_cast<int>(MailFull);
+			if (!mail.compare_exchange_strong(expected, MailReading, std::memory_order_acquire))
+				return;
+
+			const auto nextIdx = (mixer.idx + 1) % NumPerlins;
+			auto table = 0;
+			for (; table < NumNoises; ++table)
+			{
+				bool used = false;
+				for (auto i = 0; i < NumPerlins; ++i)
+					used = used || (i != nextIdx && trackNoise[i] == table);
+				if (!used)
+					break;
+			}
+			noises[table] = noisePending;
+			noiseSeeds[table] = seedPending;
+			mail.store(MailEmpty, std::memory_order_release);
+
+			if (!xfade || !noiseGenerated)
+			{
+				trackNoise.fill(table);
+				noiseGenerated = true;
+				return;
+			}
+			if (noiseSeeds[trackNoise[mixer.idx]] == noiseSeeds[table])
+				return;
+
+			const auto& prev = perlins[mixer.idx];
+			mixer.init();
+			auto& next = perlins[mixer.idx];
+			next.phasor = prev.phasor;
+			next.noiseIdx = prev.noiseIdx;
+			trackNoise[mixer.idx] = table;
+		}
+
 		void processBias(double* const* samples, double bias,
 			int numChannels, int numSamples) noexcept
 		{
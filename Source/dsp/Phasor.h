@@ -1,4 +1,5 @@
 #pragma once
+#include <cmath>
 
 namespace dsp
 {
@@ -57,6 +58,16 @@ namespace dsp
 			return phase;
 		}
 
+		/* numSamples, advances the phase without synthesizing it, returns the number of wraps */
+		int skip(int numSamples) noexcept
+		{
+			phase.phase += inc * static_cast<Float>(numSamples);
+			const auto wraps = std::floor(phase.phase);
+			phase.phase -= wraps;
+			phase.retrig = wraps != static_cast<Float>(0);
+			return static_cast<int>(wraps);
+		}
+
 		Phase phase;
 		Float inc, fsInv;
 	};
@@ -0,0 +1,338 @@
+#include "RealtimeSanitizer.h"
+
+#if NEL_REALTIME_SANITIZER
+
+#if defined(__linux__)
+#define NEL_REALTIME_INTERPOSE 1
+// the fortified open and fopen are inline wrappers, which can't be interposed
+#undef _FORTIFY_SOURCE
+#else
+#define NEL_REALTIME_INTERPOSE 0
+#endif
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if NEL_REALTIME_INTERPOSE
+#include <cerrno>
+#include <cstdarg>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <pthread.h>
+// a dlopened library gets its thread locals allocated on first use, which would be an allocation in the middle of a check
+#define NEL_REALTIME_TLS __attribute__((tls_model("initial-exec")))
+extern "C"
+{
+	void* __libc_malloc(size_t) noexcept;
+	void* __libc_calloc(size_t, size_t) noexcept;
+	void* __libc_realloc(void*, size_t) noexcept;
+	void* __libc_memalign(size_t, size_t) noexcept;
+	void __libc_free(void*) noexcept;
+}
+#else
+#include <juce_core/juce_core.h>
+#define NEL_REALTIME_TLS
+#endif
+
+namespace dsp
+{
+	namespace realtime
+	{
+		static thread_local NEL_REALTIME_TLS int depth = 0;
+		// whatever the report itself does is no violation
+		static thread_local NEL_REALTIME_TLS bool reporting = false;
+		static std::atomic<int> numViolations { 0 };
+		static std::atomic<bool> failFast { false };
+
+		static void printStack() noexcept
+		{
+#if NEL_REALTIME_INTERPOSE
+			void* frames[64];
+			const auto numFrames = backtrace(frames, 64);
+			backtrace_symbols_fd(frames, numFrames, 2);
+#else
+			std::fputs(juce::SystemStats::getStackBacktrace().toRawUTF8(), stderr);
+#endif
+		}
+
+		Scope::Scope(bool _active) noexcept :
+			active(_active)
+		{
+			if (active)
+				++depth;
+		}
+
+		Scope::~Scope()
+		{
+			if (active)
+				--depth;
+		}
+
+		int getNumViolations() noexcept
+		{
+			return numViolations.load();
+		}
+
+		void resetViolations() noexcept
+		{
+			numViolations.store(0);
+		}
+
+		void setFailFast(bool e) noexcept
+		{
+			failFast.store(e);
+		}
+
+		void check(const char* what) noexcept
+		{
+			if (depth == 0 || reporting)
+				return;
+			reporting = true;
+			++numViolations;
+			std::fprintf(stderr, "realtime violation: %s\n", what);
+			printStack();
+			std::fflush(stderr);
+			reporting = false;
+			if (failFast.load())
+				std::abort();
+		}
+
+		// ALLOCATE WITHOUT BEING INTERPOSED AGAIN
+
+		static void* allocate(size_t size) noexcept
+		{
+#if NEL_REALTIME_INTERPOSE
+			return __libc_malloc(size == 0 ? 1 : size);
+#else
+			return std::malloc(size == 0 ? 1 : size);
+#endif
+		}
+
+		static void* allocateAligned(size_t size, size_t alignment) noexcept
+		{
+			size = (size + alignment - 1) / alignment * alignment;
+#if NEL_REALTIME_INTERPOSE
+			return __libc_memalign(alignment, size == 0 ? alignment : size);
+#elif JUCE_MSVC
+			return _aligned_malloc(size == 0 ? alignment : size, alignment);
+#else
+			return std::aligned_alloc(alignment, size == 0 ? alignment : size);
+#endif
+		}
+
+		static void deallocate(void* ptr) noexcept
+		{
+#if NEL_REALTIME_INTERPOSE
+			__libc_free(ptr);
+#else
+			std::free(ptr);
+#endif
+		}
+
+		static void deallocateAligned(void* ptr) noexcept
+		{
+#if NEL_REALTIME_INTERPOSE
+			__libc_free(ptr);
+#elif JUCE_MSVC
+			_aligned_free(ptr);
+#else
+			std::free(ptr);
+#endif
+		}
+
+#if NEL_REALTIME_INTERPOSE
+		/* real, name, the function this one hides. dlsym only allocates through the interposed calloc */
+		template<typename Func>
+		static Func next(std::atomic<void*>& real, const char* name) noexcept
+		{
+			auto func = real.load(std::memory_order_relaxed);
+			if (func == nullptr)
+			{
+				func = dlsym(RTLD_NEXT, name);
+				real.store(func, std::memory_order_relaxed);
+			}
+			return reinterpret_cast<Func>(func);
+		}
+
+		static std::atomic<void*> realMutexLock { nullptr }, realOpen { nullptr }, realFopen { nullptr };
+#endif
+	}
+}
+
+// OPERATOR NEW AND DELETE
+
+void* operator new(std::size_t size)
+{
+	dsp::realtime::check("operator new");
+	if (const auto ptr = dsp::realtime::allocate(size))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+	dsp::realtime::check("operator new[]");
+	if (const auto ptr = dsp::realtime::allocate(size))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	dsp::realtime::check("operator new");
+	return dsp::realtime::allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	dsp::realtime::check("operator new[]");
+	return dsp::realtime::allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	dsp::realtime::check("operator new");
+	if (const auto ptr = dsp::realtime::allocateAligned(size, static_cast<size_t>(alignment)))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	dsp::realtime::check("operator new[]");
+	if (const auto ptr = dsp::realtime::allocateAligned(size, static_cast<size_t>(alignment)))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+	if (ptr != nullptr)
+		dsp::realtime::check("operator delete");
+	dsp::realtime::deallocate(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	if (ptr != nullptr)
+		dsp::realtime::check("operator delete[]");
+	dsp::realtime::deallocate(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+	operator delete(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+	operator delete[](ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t) noexcept
+{
+	if (ptr != nullptr)
+		dsp::realtime::check("operator delete");
+	dsp::realtime::deallocateAligned(ptr);
+}
+
+void operator delete[](void* ptr, std::align_val_t) noexcept
+{
+	if (ptr != nullptr)
+		dsp::realtime::check("operator delete[]");
+	dsp::realtime::deallocateAligned(ptr);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t alignment) noexcept
+{
+	operator delete(ptr, alignment);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t alignment) noexcept
+{
+	operator delete[](ptr, alignment);
+}
+
+#if NEL_REALTIME_INTERPOSE
+
+// LIBC
+
+extern "C"
+{
+	void* malloc(size_t size) noexcept
+	{
+		dsp::realtime::check("malloc");
+		return __libc_malloc(size);
+	}
+
+	void* calloc(size_t num, size_t size) noexcept
+	{
+		dsp::realtime::check("calloc");
+		return __libc_calloc(num, size);
+	}
+
+	void* realloc(void* ptr, size_t size) noexcept
+	{
+		dsp::realtime::check("realloc");
+		return __libc_realloc(ptr, size);
+	}
+
+	void free(void* ptr) noexcept
+	{
+		if (ptr != nullptr)
+			dsp::realtime::check("free");
+		__libc_free(ptr);
+	}
+
+	int posix_memalign(void** ptr, size_t alignment, size_t size) noexcept
+	{
+		dsp::realtime::check("posix_memalign");
+		*ptr = __libc_memalign(alignment, size);
+		return *ptr != nullptr ? 0 : ENOMEM;
+	}
+
+	void* aligned_alloc(size_t alignment, size_t size) noexcept
+	{
+		dsp::realtime::check("aligned_alloc");
+		return __libc_memalign(alignment, size);
+	}
+
+	int pthread_mutex_lock(pthread_mutex_t* mutex) noexcept
+	{
+		dsp::realtime::check("pthread_mutex_lock");
+		using Func = int(*)(pthread_mutex_t*);
+		return dsp::realtime::next<Func>(dsp::realtime::realMutexLock, "pthread_mutex_lock")(mutex);
+	}
+
+	int open(const char* path, int flags, ...)
+	{
+		dsp::realtime::check("open");
+		mode_t mode = 0;
+		if ((flags & O_CREAT) != 0
+#ifdef O_TMPFILE
+			|| (flags & O_TMPFILE) == O_TMPFILE
+#endif
+			)
+		{
+			va_list args;
+			va_start(args, flags);
+			mode = static_cast<mode_t>(va_arg(args, int));
+			va_end(args);
+		}
+		using Func = int(*)(const char*, int, ...);
+		return dsp::realtime::next<Func>(dsp::realtime::realOpen, "open")(path, flags, mode);
+	}
+
+	FILE* fopen(const char* __restrict path, const char* __restrict modes)
+	{
+		dsp::realtime::check("fopen");
+		using Func = FILE*(*)(const char*, const char*);
+		return dsp::realtime::next<Func>(dsp::realtime::realFopen, "fopen")(path, modes);
+	}
+}
+
+#endif
+#endif
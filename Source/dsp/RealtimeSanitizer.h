@@ -0,0 +1,61 @@
+#pragma once
+
+// 1 reports everything the audio thread must not do while it processes a block.
+// for debug and benchmark builds only, f.ex. as a preprocessor definition of their exporter configuration
+#ifndef NEL_REALTIME_SANITIZER
+#define NEL_REALTIME_SANITIZER 0
+#endif
+
+namespace dsp
+{
+	/*
+	while a thread is flagged realtime, allocating, locking a mutex and opening a file are violations.
+	global operator new and delete are replaced on every platform. on linux malloc, free, pthread_mutex_lock,
+	open and fopen are interposed as well, which only takes over where this is part of the executable,
+	f.ex. the standalone or the batch renderer, because a plugin's symbols don't come before the host's.
+	every violation is counted and printed to stderr, together with the stack of the offending call.
+	*/
+	namespace realtime
+	{
+#if NEL_REALTIME_SANITIZER
+		/* flags the thread realtime while it exists, if active. nests */
+		struct Scope
+		{
+			Scope(bool = true) noexcept;
+
+			~Scope();
+
+			Scope(const Scope&) = delete;
+			Scope& operator=(const Scope&) = delete;
+
+		private:
+			bool active;
+		};
+
+		/* violations of all threads so far */
+		int getNumViolations() noexcept;
+
+		void resetViolations() noexcept;
+
+		/* aborts on the next violation, so that a debugger stops right at it */
+		void setFailFast(bool) noexcept;
+
+		/* what, reports a violation if the thread is flagged realtime.
+		for calls the sanitizer can't intercept itself */
+		void check(const char*) noexcept;
+#else
+		struct Scope
+		{
+			Scope(bool = true) noexcept {}
+		};
+
+		inline int getNumViolations() noexcept { return 0; }
+
+		inline void resetViolations() noexcept {}
+
+		inline void setFailFast(bool) noexcept {}
+
+		inline void check(const char*) noexcept {}
+#endif
+	}
+}
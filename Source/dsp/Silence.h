@@ -0,0 +1,85 @@
+#pragma once
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <limits>
+
+namespace dsp
+{
+	// -120db, anything quieter than that counts as digital silence
+	static constexpr double SilenceThreshold = 1e-6;
+
+	/* samples, numChannels, numSamples */
+	inline bool isSilent(const double* const* samples, int numChannels, int numSamples) noexcept
+	{
+		for (auto ch = 0; ch < numChannels; ++ch)
+		{
+			const auto range = juce::FloatVectorOperations::findMinAndMax(samples[ch], numSamples);
+			if (range.getEnd() > SilenceThreshold || range.getStart() < -SilenceThreshold)
+				return false;
+		}
+		return true;
+	}
+
+	/*
+	tells when the input has been silent for longer than the engine rings,
+	so that the block can be skipped until the input comes back.
+	*/
+	struct SilenceDetector
+	{
+		SilenceDetector() :
+			silentSamples(0),
+			tailSamples(0.),
+			sleeping(false),
+			fellAsleep(false)
+		{}
+
+		void reset() noexcept
+		{
+			silentSamples = 0;
+			sleeping = false;
+			fellAsleep = false;
+		}
+
+		/* tailSamples, incl. latency. infinity if the engine never decays */
+		void setTail(double _tailSamples) noexcept
+		{
+			tailSamples = _tailSamples;
+		}
+
+		/* samples, numChannels, numSamples
+		returns true if the output of this block would be silent */
+		bool operator()(const double* const* samples, int numChannels, int numSamples) noexcept
+		{
+			const auto wasSleeping = sleeping;
+			if (isSilent(samples, numChannels, numSamples))
+			{
+				if (silentSamples < std::numeric_limits<juce::int64>::max() / 2)
+					silentSamples += numSamples;
+				sleeping = static_cast<double>(silentSamples) > tailSamples;
+			}
+			else
+			{
+				silentSamples = 0;
+				sleeping = false;
+			}
+			fellAsleep = sleeping && !wasSleeping;
+			return sleeping;
+		}
+
+		/* true while the wet chain sleeps */
+		bool isSleeping() const noexcept
+		{
+			return sleeping;
+		}
+
+		/* true for the first block of a sleep, which is when the remains of the tail can be cleared */
+		bool justFellAsleep() const noexcept
+		{
+			return fellAsleep;
+		}
+
+	protected:
+		juce::int64 silentSamples;
+		double tailSamples;
+		bool sleeping, fellAsleep;
+	};
+}
@@ -0,0 +1,317 @@
+#include "Simd.h"
+#include <atomic>
+#include <cmath>
+
+#if JUCE_INTEL
+#include <immintrin.h>
+#endif
+
+#if JUCE_ARM && (defined(__aarch64__) || defined(_M_ARM64))
+#define NEL_SIMD_NEON 1
+#include <arm_neon.h>
+#else
+#define NEL_SIMD_NEON 0
+#endif
+
+// msvc emits any instruction set anywhere, gcc and clang need to be told per function
+#if JUCE_MSVC
+#define NEL_SIMD_TARGET_ISA(isa)
+#else
+#define NEL_SIMD_TARGET_ISA(isa) __attribute__((target(isa)))
+#endif
+
+namespace simd
+{
+	namespace scalar
+	{
+		template<typename F>
+		struct Batch
+		{
+			using Float = F;
+			using Reg = F;
+			static constexpr int Size = 1;
+
+			static Reg load(const Float* p) noexcept { return *p; }
+			static void store(Float* p, Reg a) noexcept { *p = a; }
+			static Reg broadcast(Float x) noexcept { return x; }
+			static Reg add(Reg a, Reg b) noexcept { return a + b; }
+			static Reg sub(Reg a, Reg b) noexcept { return a - b; }
+			static Reg mul(Reg a, Reg b) noexcept { return a * b; }
+			/* a * b + c */
+			static Reg fma(Reg a, Reg b, Reg c) noexcept { return a * b + c; }
+			static Reg sqrt(Reg a) noexcept { return std::sqrt(a); }
+			static Float sum(Reg a) noexcept { return a; }
+		};
+
+		using Double = Batch<double>;
+		using Single = Batch<float>;
+
+#define NEL_SIMD_TARGET
+#include "SimdKernels.h"
+#undef NEL_SIMD_TARGET
+	}
+
+#if JUCE_INTEL
+	namespace sse2
+	{
+#define NEL_SIMD_TARGET NEL_SIMD_TARGET_ISA("sse2")
+		struct Double
+		{
+			using Float = double;
+			using Reg = __m128d;
+			static constexpr int Size = 2;
+
+			NEL_SIMD_TARGET static Reg load(const Float* p) noexcept { return _mm_loadu_pd(p); }
+			NEL_SIMD_TARGET static void store(Float* p, Reg a) noexcept { _mm_storeu_pd(p, a); }
+			NEL_SIMD_TARGET static Reg broadcast(Float x) noexcept { return _mm_set1_pd(x); }
+			NEL_SIMD_TARGET static Reg add(Reg a, Reg b) noexcept { return _mm_add_pd(a, b); }
+			NEL_SIMD_TARGET static Reg sub(Reg a, Reg b) noexcept { return _mm_sub_pd(a, b); }
+			NEL_SIMD_TARGET static Reg mul(Reg a, Reg b) noexcept { return _mm_mul_pd(a, b); }
+			NEL_SIMD_TARGET static Reg fma(Reg a, Reg b, Reg c) noexcept { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+			NEL_SIMD_TARGET static Reg sqrt(Reg a) noexcept { return _mm_sqrt_pd(a); }
+			NEL_SIMD_TARGET static Float sum(Reg a) noexcept
+			{
+				return _mm_cvtsd_f64(_mm_add_sd(a, _mm_unpackhi_pd(a, a)));
+			}
+		};
+
+		struct Single
+		{
+			using Float = float;
+			using Reg = __m128;
+			static constexpr int Size = 4;
+
+			NEL_SIMD_TARGET static Reg load(const Float* p) noexcept { return _mm_loadu_ps(p); }
+			NEL_SIMD_TARGET static void store(Float* p, Reg a) noexcept { _mm_storeu_ps(p, a); }
+			NEL_SIMD_TARGET static Reg broadcast(Float x) noexcept { return _mm_set1_ps(x); }
+			NEL_SIMD_TARGET static Reg add(Reg a, Reg b) noexcept { return _mm_add_ps(a, b); }
+			NEL_SIMD_TARGET static Reg sub(Reg a, Reg b) noexcept { return _mm_sub_ps(a, b); }
+			NEL_SIMD_TARGET static Reg mul(Reg a, Reg b) noexcept { return _mm_mul_ps(a, b); }
+			NEL_SIMD_TARGET static Reg fma(Reg a, Reg b, Reg c) noexcept { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+			NEL_SIMD_TARGET static Reg sqrt(Reg a) noexcept { return _mm_sqrt_ps(a); }
+			NEL_SIMD_TARGET static Float sum(Reg a) noexcept
+			{
+				const auto pairs = _mm_add_ps(a, _mm_movehl_ps(a, a));
+				return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1)));
+			}
+		};
+
+#include "SimdKernels.h"
+#undef NEL_SIMD_TARGET
+	}
+
+	namespace avx2
+	{
+#define NEL_SIMD_TARGET NEL_SIMD_TARGET_ISA("avx2,fma")
+		struct Double
+		{
+			using Float = double;
+			using Reg = __m256d;
+			static constexpr int Size = 4;
+
+			NEL_SIMD_TARGET static Reg load(const Float* p) noexcept { return _mm256_loadu_pd(p); }
+			NEL_SIMD_TARGET static void store(Float* p, Reg a) noexcept { _mm256_storeu_pd(p, a); }
+			NEL_SIMD_TARGET static Reg broadcast(Float x) noexcept { return _mm256_set1_pd(x); }
+			NEL_SIMD_TARGET static Reg add(Reg a, Reg b) noexcept { return _mm256_add_pd(a, b); }
+			NEL_SIMD_TARGET static Reg sub(Reg a, Reg b) noexcept { return _mm256_sub_pd(a, b); }
+			NEL_SIMD_TARGET static Reg mul(Reg a, Reg b) noexcept { return _mm256_mul_pd(a, b); }
+			NEL_SIMD_TARGET static Reg fma(Reg a, Reg b, Reg c) noexcept { return _mm256_fmadd_pd(a, b, c); }
+			NEL_SIMD_TARGET static Reg sqrt(Reg a) noexcept { return _mm256_sqrt_pd(a); }
+			NEL_SIMD_TARGET static Float sum(Reg a) noexcept
+			{
+				const auto halves = _mm_add_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+				return _mm_cvtsd_f64(_mm_add_sd(halves, _mm_unpackhi_pd(halves, halves)));
+			}
+		};
+
+		struct Single
+		{
+			using Float = float;
+			using Reg = __m256;
+			static constexpr int Size = 8;
+
+			NEL_SIMD_TARGET static Reg load(const Float* p) noexcept { return _mm256_loadu_ps(p); }
+			NEL_SIMD_TARGET static void store(Float* p, Reg a) noexcept { _mm256_storeu_ps(p, a); }
+			NEL_SIMD_TARGET static Reg broadcast(Float x) noexcept { return _mm256_set1_ps(x); }
+			NEL_SIMD_TARGET static Reg add(Reg a, Reg b) noexcept { return _mm256_add_ps(a, b); }
+			NEL_SIMD_TARGET static Reg sub(Reg a, Reg b) noexcept { return _mm256_sub_ps(a, b); }
+			NEL_SIMD_TARGET static Reg mul(Reg a, Reg b) noexcept { return _mm256_mul_ps(a, b); }
+			NEL_SIMD_TARGET static Reg fma(Reg a, Reg b, Reg c) noexcept { return _mm256_fmadd_ps(a, b, c); }
+			NEL_SIMD_TARGET static Reg sqrt(Reg a) noexcept { return _mm256_sqrt_ps(a); }
+			NEL_SIMD_TARGET static Float sum(Reg a) noexcept
+			{
+				const auto halves = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+				const auto pairs = _mm_add_ps(halves, _mm_movehl_ps(halves, halves));
+				return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, 1)));
+			}
+		};
+
+#include "SimdKernels.h"
+#undef NEL_SIMD_TARGET
+	}
+
+	namespace avx512
+	{
+#define NEL_SIMD_TARGET NEL_SIMD_TARGET_ISA("avx512f")
+		struct Double
+		{
+			using Float = double;
+			using Reg = __m512d;
+			static constexpr int Size = 8;
+
+			NEL_SIMD_TARGET static Reg load(const Float* p) noexcept { return _mm512_loadu_pd(p); }
+			NEL_SIMD_TARGET static void store(Float* p, Reg a) noexcept { _mm512_storeu_pd(p, a); }
+			NEL_SIMD_TARGET static Reg broadcast(Float x) noexcept { return _mm512_set1_pd(x); }
+			NEL_SIMD_TARGET static Reg add(Reg a, Reg b) noexcept { return _mm512_add_pd(a, b); }
+			NEL_SIMD_TARGET static Reg sub(Reg a, Reg b) noexcept { return _mm512_sub_pd(a, b); }
+			NEL_SIMD_TARGET static Reg mul(Reg a, Reg b) noexcept { return _mm512_mul_pd(a, b); }
+			NEL_SIMD_TARGET static Reg fma(Reg a, Reg b, Reg c) noexcept { return _mm512_fmadd_pd(a, b, c); }
+			NEL_SIMD_TARGET static Reg sqrt(Reg a) noexcept { return _mm512_sqrt_pd(a); }
+			NEL_SIMD_TARGET static Float sum(Reg a) noexcept { return _mm512_reduce_add_pd(a); }
+		};
+
+		struct Single
+		{
+			using Float = float;
+			using Reg = __m512;
+			static constexpr int Size = 16;
+
+			NEL_SIMD_TARGET static Reg load(const Float* p) noexcept { return _mm512_loadu_ps(p); }
+			NEL_SIMD_TARGET static void store(Float* p, Reg a) noexcept { _mm512_storeu_ps(p, a); }
+			NEL_SIMD_TARGET static Reg broadcast(Float x) noexcept { return _mm512_set1_ps(x); }
+			NEL_SIMD_TARGET static Reg add(Reg a, Reg b) noexcept { return _mm512_add_ps(a, b); }
+			NEL_SIMD_TARGET static Reg sub(Reg a, Reg b) noexcept { return _mm512_sub_ps(a, b); }
+			NEL_SIMD_TARGET static Reg mul(Reg a, Reg b) noexcept { return _mm512_mul_ps(a, b); }
+			NEL_SIMD_TARGET static Reg fma(Reg a, Reg b, Reg c) noexcept { return _mm512_fmadd_ps(a, b, c); }
+			NEL_SIMD_TARGET static Reg sqrt(Reg a) noexcept { return _mm512_sqrt_ps(a); }
+			NEL_SIMD_TARGET static Float sum(Reg a) noexcept { return _mm512_reduce_add_ps(a); }
+		};
+
+#include "SimdKernels.h"
+#undef NEL_SIMD_TARGET
+	}
+#endif
+
+#if NEL_SIMD_NEON
+	namespace neon
+	{
+		// neon is part of the baseline on arm64
+#define NEL_SIMD_TARGET
+		struct Double
+		{
+			using Float = double;
+			using Reg = float64x2_t;
+			static constexpr int Size = 2;
+
+			static Reg load(const Float* p) noexcept { return vld1q_f64(p); }
+			static void store(Float* p, Reg a) noexcept { vst1q_f64(p, a); }
+			static Reg broadcast(Float x) noexcept { return vdupq_n_f64(x); }
+			static Reg add(Reg a, Reg b) noexcept { return vaddq_f64(a, b); }
+			static Reg sub(Reg a, Reg b) noexcept { return vsubq_f64(a, b); }
+			static Reg mul(Reg a, Reg b) noexcept { return vmulq_f64(a, b); }
+			static Reg fma(Reg a, Reg b, Reg c) noexcept { return vfmaq_f64(c, a, b); }
+			static Reg sqrt(Reg a) noexcept { return vsqrtq_f64(a); }
+			static Float sum(Reg a) noexcept { return vaddvq_f64(a); }
+		};
+
+		struct Single
+		{
+			using Float = float;
+			using Reg = float32x4_t;
+			static constexpr int Size = 4;
+
+			static Reg load(const Float* p) noexcept { return vld1q_f32(p); }
+			static void store(Float* p, Reg a) noexcept { vst1q_f32(p, a); }
+			static Reg broadcast(Float x) noexcept { return vdupq_n_f32(x); }
+			static Reg add(Reg a, Reg b) noexcept { return vaddq_f32(a, b); }
+			static Reg sub(Reg a, Reg b) noexcept { return vsubq_f32(a, b); }
+			static Reg mul(Reg a, Reg b) noexcept { return vmulq_f32(a, b); }
+			static Reg fma(Reg a, Reg b, Reg c) noexcept { return vfmaq_f32(c, a, b); }
+			static Reg sqrt(Reg a) noexcept { return vsqrtq_f32(a); }
+			static Float sum(Reg a) noexcept { return vaddvq_f32(a); }
+		};
+
+#include "SimdKernels.h"
+#undef NEL_SIMD_TARGET
+	}
+#endif
+
+	static const Kernels& getKernels(ISA isa) noexcept
+	{
+		static const Kernels scalarKernels = scalar::makeKernels(ISA::Scalar);
+#if JUCE_INTEL
+		static const Kernels sse2Kernels = sse2::makeKernels(ISA::SSE2);
+		static const Kernels avx2Kernels = avx2::makeKernels(ISA::AVX2);
+		static const Kernels avx512Kernels = avx512::makeKernels(ISA::AVX512);
+		switch (isa)
+		{
+		case ISA::SSE2: return sse2Kernels;
+		case ISA::AVX2: return avx2Kernels;
+		case ISA::AVX512: return avx512Kernels;
+		default: break;
+		}
+#endif
+#if NEL_SIMD_NEON
+		static const Kernels neonKernels = neon::makeKernels(ISA::NEON);
+		if (isa == ISA::NEON)
+			return neonKernels;
+#endif
+		return scalarKernels;
+	}
+
+	ISA getBestISA() noexcept
+	{
+		using SystemStats = juce::SystemStats;
+#if JUCE_INTEL
+		if (SystemStats::hasAVX512F())
+			return ISA::AVX512;
+		if (SystemStats::hasAVX2() && SystemStats::hasFMA3())
+			return ISA::AVX2;
+		if (SystemStats::hasSSE2())
+			return ISA::SSE2;
+#elif NEL_SIMD_NEON
+		return ISA::NEON;
+#endif
+		return ISA::Scalar;
+	}
+
+	bool isSupported(ISA isa) noexcept
+	{
+		if (isa == ISA::Scalar)
+			return true;
+		const auto best = getBestISA();
+		if (isa == ISA::NEON || best == ISA::NEON)
+			return isa == best;
+		// every x86 level includes the ones below it
+		return isa != ISA::NumISAs && static_cast<int>(isa) <= static_cast<int>(best);
+	}
+
+	static std::atomic<const Kernels*>& getCurrent() noexcept
+	{
+		static std::atomic<const Kernels*> current = []()
+		{
+			const auto forced = toISA(juce::SystemStats::getEnvironmentVariable("NEL_SIMD", {}));
+			const auto isa = forced != ISA::NumISAs && isSupported(forced) ? forced : getBestISA();
+			return &getKernels(isa);
+		}();
+		return current;
+	}
+
+	ISA getISA() noexcept
+	{
+		return getKernels().isa;
+	}
+
+	bool force(ISA isa) noexcept
+	{
+		if (!isSupported(isa))
+			return false;
+		getCurrent().store(&getKernels(isa));
+		return true;
+	}
+
+	const Kernels& getKernels() noexcept
+	{
+		return *getCurrent().load(std::memory_order_relaxed);
+	}
+}
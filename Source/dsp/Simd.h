@@ -0,0 +1,83 @@
+#pragma once
+#include <juce_core/juce_core.h>
+
+/*
+runtime dispatch for the vectorized dsp kernels.
+the kernels are compiled once per instruction set (see Simd.cpp and SimdKernels.h)
+and the best one the cpu supports is picked on first use.
+set the environment variable NEL_SIMD (scalar, sse2, avx2, avx512, neon) or call force
+to run a lower instruction set for testing.
+*/
+
+namespace simd
+{
+	enum class ISA
+	{
+		Scalar, SSE2, AVX2, AVX512, NEON,
+		NumISAs
+	};
+
+	inline juce::String toString(ISA isa)
+	{
+		switch (isa)
+		{
+		case ISA::Scalar: return "scalar";
+		case ISA::SSE2: return "sse2";
+		case ISA::AVX2: return "avx2";
+		case ISA::AVX512: return "avx512";
+		case ISA::NEON: return "neon";
+		default: return "";
+		}
+	}
+
+	inline ISA toISA(const juce::String& isa)
+	{
+		const auto numISAs = static_cast<int>(ISA::NumISAs);
+		for (auto i = 0; i < numISAs; ++i)
+		{
+			const auto type = static_cast<ISA>(i);
+			if (isa.equalsIgnoreCase(toString(type)))
+				return type;
+		}
+		return ISA::NumISAs;
+	}
+
+	struct Kernels
+	{
+		using DotD = double(*)(const double*, const double*, int) noexcept;
+		using DotF = float(*)(const float*, const float*, int) noexcept;
+		using Mix = void(*)(double*, const double*, const double*, const double*, const double*, int) noexcept;
+		using EqualPower = void(*)(double*, double*, const double*, int) noexcept;
+
+		/* a, b, n */
+		double dot(const double* a, const double* b, int n) const noexcept { return dotD(a, b, n); }
+		/* a, b, n */
+		float dot(const float* a, const float* b, int n) const noexcept { return dotF(a, b, n); }
+
+		ISA isa;
+		DotD dotD;
+		DotF dotF;
+		/* wet, dry, mixDry, mixWet, gainWet, n
+		wet = dry * mixDry + wet * mixWet * gainWet */
+		Mix mix;
+		/* mixDry, mixWet, mix, n
+		mixDry = sqrt(1 - mix), mixWet = sqrt(mix) */
+		EqualPower equalPower;
+	};
+
+	/* the instruction set that is used right now */
+	ISA getISA() noexcept;
+
+	/* the best instruction set the cpu and this build support */
+	ISA getBestISA() noexcept;
+
+	bool isSupported(ISA) noexcept;
+
+	/* isa, returns false if it isn't supported, in which case nothing changes.
+	not meant to be called while processing */
+	bool force(ISA) noexcept;
+
+	/* the kernels of the current instruction set.
+	fetch them once per block, not per sample */
+	const Kernels& getKernels() noexcept;
+}
@@ -0,0 +1,71 @@
+// no pragma once: Simd.cpp includes this once per instruction set,
+// each time inside its own namespace with NEL_SIMD_TARGET and the batch types Double and Single defined.
+
+template<typename Batch>
+NEL_SIMD_TARGET typename Batch::Float dot(const typename Batch::Float* a,
+	const typename Batch::Float* b, int n) noexcept
+{
+	constexpr auto Size = Batch::Size;
+	auto sum0 = Batch::broadcast(0);
+	auto sum1 = Batch::broadcast(0);
+	auto i = 0;
+	for (; i + 2 * Size <= n; i += 2 * Size)
+	{
+		sum0 = Batch::fma(Batch::load(a + i), Batch::load(b + i), sum0);
+		sum1 = Batch::fma(Batch::load(a + i + Size), Batch::load(b + i + Size), sum1);
+	}
+	if (i + Size <= n)
+	{
+		sum0 = Batch::fma(Batch::load(a + i), Batch::load(b + i), sum0);
+		i += Size;
+	}
+	auto y = Batch::sum(Batch::add(sum0, sum1));
+	for (; i < n; ++i)
+		y += a[i] * b[i];
+	return y;
+}
+
+template<typename Batch>
+NEL_SIMD_TARGET void mix(double* wet, const double* dry, const double* mixDry,
+	const double* mixWet, const double* gainWet, int n) noexcept
+{
+	constexpr auto Size = Batch::Size;
+	auto s = 0;
+	for (; s + Size <= n; s += Size)
+	{
+		const auto w = Batch::mul(Batch::mul(Batch::load(wet + s), Batch::load(mixWet + s)), Batch::load(gainWet + s));
+		Batch::store(wet + s, Batch::fma(Batch::load(dry + s), Batch::load(mixDry + s), w));
+	}
+	for (; s < n; ++s)
+		wet[s] = dry[s] * mixDry[s] + wet[s] * mixWet[s] * gainWet[s];
+}
+
+template<typename Batch>
+NEL_SIMD_TARGET void equalPower(double* mixDry, double* mixWet, const double* mixBuf, int n) noexcept
+{
+	constexpr auto Size = Batch::Size;
+	const auto one = Batch::broadcast(1.);
+	auto s = 0;
+	for (; s + Size <= n; s += Size)
+	{
+		const auto m = Batch::load(mixBuf + s);
+		Batch::store(mixDry + s, Batch::sqrt(Batch::sub(one, m)));
+		Batch::store(mixWet + s, Batch::sqrt(m));
+	}
+	for (; s < n; ++s)
+	{
+		mixDry[s] = std::sqrt(1. - mixBuf[s]);
+		mixWet[s] = std::sqrt(mixBuf[s]);
+	}
+}
+
+inline Kernels makeKernels(ISA isa) noexcept
+{
+	Kernels k;
+	k.isa = isa;
+	k.dotD = &dot<Double>;
+	k.dotF = &dot<Single>;
+	k.mix = &mix<Double>;
+	k.equalPower = &equalPower<Double>;
+	return k;
+}
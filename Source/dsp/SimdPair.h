@@ -0,0 +1,112 @@
+#pragma once
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define NEL_SIMD_PAIR_SSE2 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define NEL_SIMD_PAIR_NEON 1
+#endif
+
+/*
+two channels of a recursive filter, f.ex. L and R, advancing together in one register.
+a recursion can't be vectorized along time, but across channels it can.
+sse2 and neon are part of the 64 bit baselines, so unlike the kernels in Simd.h this needs no dispatch.
+every operation is the one the scalar code does, in the same order, so both give the same result.
+*/
+
+namespace simd
+{
+	template<typename Float>
+	struct Pair
+	{
+		Pair() noexcept :
+			l(static_cast<Float>(0)),
+			r(static_cast<Float>(0))
+		{}
+
+		/* broadcast */
+		Pair(Float x) noexcept :
+			l(x),
+			r(x)
+		{}
+
+		Pair(Float _l, Float _r) noexcept :
+			l(_l),
+			r(_r)
+		{}
+
+		Float left() const noexcept { return l; }
+		Float right() const noexcept { return r; }
+
+		friend Pair operator+(const Pair& a, const Pair& b) noexcept { return { a.l + b.l, a.r + b.r }; }
+		friend Pair operator-(const Pair& a, const Pair& b) noexcept { return { a.l - b.l, a.r - b.r }; }
+		friend Pair operator*(const Pair& a, const Pair& b) noexcept { return { a.l * b.l, a.r * b.r }; }
+
+	protected:
+		Float l, r;
+	};
+
+#if NEL_SIMD_PAIR_SSE2
+	template<>
+	struct Pair<double>
+	{
+		Pair() noexcept :
+			v(_mm_setzero_pd())
+		{}
+
+		/* broadcast */
+		Pair(double x) noexcept :
+			v(_mm_set1_pd(x))
+		{}
+
+		Pair(double l, double r) noexcept :
+			v(_mm_set_pd(r, l))
+		{}
+
+		double left() const noexcept { return _mm_cvtsd_f64(v); }
+		double right() const noexcept { return _mm_cvtsd_f64(_mm_unpackhi_pd(v, v)); }
+
+		friend Pair operator+(const Pair& a, const Pair& b) noexcept { return Pair(_mm_add_pd(a.v, b.v)); }
+		friend Pair operator-(const Pair& a, const Pair& b) noexcept { return Pair(_mm_sub_pd(a.v, b.v)); }
+		friend Pair operator*(const Pair& a, const Pair& b) noexcept { return Pair(_mm_mul_pd(a.v, b.v)); }
+
+	protected:
+		__m128d v;
+
+		explicit Pair(__m128d _v) noexcept :
+			v(_v)
+		{}
+	};
+#elif NEL_SIMD_PAIR_NEON
+	template<>
+	struct Pair<double>
+	{
+		Pair() noexcept :
+			v(vdupq_n_f64(0.))
+		{}
+
+		/* broadcast */
+		Pair(double x) noexcept :
+			v(vdupq_n_f64(x))
+		{}
+
+		Pair(double l, double r) noexcept :
+			v(vcombine_f64(vdup_n_f64(l), vdup_n_f64(r)))
+		{}
+
+		double left() const noexcept { return vgetq_lane_f64(v, 0); }
+		double right() const noexcept { return vgetq_lane_f64(v, 1); }
+
+		friend Pair operator+(const Pair& a, const Pair& b) noexcept { return Pair(vaddq_f64(a.v, b.v)); }
+		friend Pair operator-(const Pair& a, const Pair& b) noexcept { return Pair(vsubq_f64(a.v, b.v)); }
+		friend Pair operator*(const Pair& a, const Pair& b) noexcept { return Pair(vmulq_f64(a.v, b.v)); }
+
+	protected:
+		float64x2_t v;
+
+		explicit Pair(float64x2_t _v) noexcept :
+			v(_v)
+		{}
+	};
+#endif
+}
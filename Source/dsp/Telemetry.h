@@ -0,0 +1,228 @@
+#pragma once
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <array>
+#include <atomic>
+
+namespace dsp
+{
+	/* single producer, single consumer ring buffer.
+	push and pop never block, if the consumer falls behind new items are dropped */
+	template<typename T, size_t Size>
+	struct SPSCQueue
+	{
+		static_assert((Size & (Size - 1)) == 0, "Size must be a power of 2");
+		static constexpr size_t Mask = Size - 1;
+
+		SPSCQueue() :
+			items(),
+			writeIdx(0),
+			readIdx(0)
+		{}
+
+		/* audio thread */
+		bool push(const T& item) noexcept
+		{
+			const auto w = writeIdx.load(std::memory_order_relaxed);
+			if (w - readIdx.load(std::memory_order_acquire) == Size)
+				return false;
+			items[w & Mask] = item;
+			writeIdx.store(w + 1, std::memory_order_release);
+			return true;
+		}
+
+		/* message thread */
+		bool pop(T& item) noexcept
+		{
+			const auto r = readIdx.load(std::memory_order_relaxed);
+			if (r == writeIdx.load(std::memory_order_acquire))
+				return false;
+			item = items[r & Mask];
+			readIdx.store(r + 1, std::memory_order_release);
+			return true;
+		}
+
+	private:
+		std::array<T, Size> items;
+		// separate cache lines, so that the threads don't invalidate each other's index
+		alignas(64) std::atomic<size_t> writeIdx;
+		alignas(64) std::atomic<size_t> readIdx;
+	};
+
+	/* what the editor gets to see of the audio thread, decimated to the display rate */
+	struct TelemetryFrame
+	{
+		// modulation [-1,1] and read head [0,1] (0 = write head, 1 = end of delay) per channel.
+		// min is above max if the wet chain didn't run
+		std::array<float, 2> modMin, modMax, readHead;
+		// peak levels of the block(s) this frame was taken from
+		float levelDry, levelWet;
+	};
+
+	/* collects min/max of the modulation per display frame on the audio thread
+	and hands complete frames to the editor through a wait-free queue.
+	frames that completed during a block wait for the block's wet level, so that dry and wet always share a frame */
+	struct Telemetry
+	{
+		static constexpr double FramesPerSec = 60.;
+		static constexpr size_t QueueSize = 64;
+
+		using Frame = TelemetryFrame;
+		using Queue = SPSCQueue<Frame, QueueSize>;
+
+		Telemetry() :
+			queue(),
+			frame(),
+			pending(),
+			numPending(0),
+			generation(0),
+			levelDry(0.f),
+			samplesPerFrame(1),
+			frameIdx(0)
+		{
+			reset();
+		}
+
+		/* Fs of the modulation signal */
+		void prepare(double Fs) noexcept
+		{
+			samplesPerFrame = std::max(1, static_cast<int>(Fs / FramesPerSec));
+			frameIdx = 0;
+			numPending = 0;
+			levelDry = 0.f;
+			reset();
+		}
+
+		/* mods[-1,1] are the shifted modulation buffers that go into the delay,
+		depth[0,1] the depth buffer that shifted them.
+		of more than two channels the first and the last one are shown, the others lie in between */
+		void pushModulation(const double* const* mods, const double* depth, int numChannels, int numSamples) noexcept
+		{
+			const double* edges[] = { mods[0], mods[numChannels - 1] };
+			if (numChannels > 2)
+			{
+				mods = edges;
+				numChannels = 2;
+			}
+			auto s = 0;
+			while (s < numSamples)
+			{
+				const auto end = std::min(numSamples, s + samplesPerFrame - frameIdx);
+
+				for (auto ch = 0; ch < numChannels; ++ch)
+				{
+					const auto mod = mods[ch];
+					auto mn = frame.modMin[ch];
+					auto mx = frame.modMax[ch];
+					for (auto i = s; i < end; ++i)
+					{
+						// undo the lookahead shift to get the modulation itself
+						const auto m = static_cast<float>(mod[i] + 1. - depth[i]);
+						mn = std::min(mn, m);
+						mx = std::max(mx, m);
+					}
+					frame.modMin[ch] = mn;
+					frame.modMax[ch] = mx;
+					frame.readHead[ch] = static_cast<float>(mod[end - 1] * .5 + .5);
+				}
+
+				if (numChannels == 1)
+				{
+					frame.modMin[1] = frame.modMin[0];
+					frame.modMax[1] = frame.modMax[0];
+					frame.readHead[1] = frame.readHead[0];
+				}
+				advance(end - s);
+				s = end;
+			}
+		}
+
+		/* numSamples of the modulation rate, while the wet chain doesn't run.
+		the frames go on without modulation, so the editor's history keeps scrolling */
+		void skipModulation(int numSamples) noexcept
+		{
+			auto s = 0;
+			while (s < numSamples)
+			{
+				const auto end = std::min(numSamples, s + samplesPerFrame - frameIdx);
+				advance(end - s);
+				s = end;
+			}
+		}
+
+		/* samples, numChannels, numSamples. before the wet chain changes them */
+		void pushLevelDry(const double* const* samples, int numChannels, int numSamples) noexcept
+		{
+			levelDry = getPeak(samples, numChannels, numSamples);
+		}
+
+		/* samples, numChannels, numSamples. the last call of a block, hands its complete frames to the editor */
+		void pushLevelWet(const double* const* samples, int numChannels, int numSamples) noexcept
+		{
+			const auto levelWet = getPeak(samples, numChannels, numSamples);
+			for (auto i = 0; i < numPending; ++i)
+			{
+				auto& f = pending[i];
+				f.levelDry = std::max(f.levelDry, levelDry);
+				f.levelWet = std::max(f.levelWet, levelWet);
+				queue.push(f);
+			}
+			if (numPending != 0)
+				generation.fetch_add(1, std::memory_order_release);
+			numPending = 0;
+			frame.levelDry = std::max(frame.levelDry, levelDry);
+			frame.levelWet = std::max(frame.levelWet, levelWet);
+		}
+
+		/* any thread, moves whenever new frames were handed to the editor */
+		unsigned getGeneration() const noexcept
+		{
+			return generation.load(std::memory_order_acquire);
+		}
+
+		/* message thread, returns false if no new frame arrived */
+		bool pop(Frame& f) noexcept
+		{
+			return queue.pop(f);
+		}
+
+	private:
+		Queue queue;
+		Frame frame;
+		// the frames that completed during the current block
+		std::array<Frame, QueueSize> pending;
+		int numPending;
+		std::atomic<unsigned> generation;
+		float levelDry;
+		int samplesPerFrame, frameIdx;
+
+		void advance(int numSamples) noexcept
+		{
+			frameIdx += numSamples;
+			if (frameIdx != samplesPerFrame)
+				return;
+			// more frames than the queue holds wouldn't be read in time anyway
+			if (numPending != static_cast<int>(pending.size()))
+				pending[numPending++] = frame;
+			frameIdx = 0;
+			reset();
+		}
+
+		void reset() noexcept
+		{
+			frame.modMin = { 1.f, 1.f };
+			frame.modMax = { -1.f, -1.f };
+			frame.levelDry = frame.levelWet = 0.f;
+		}
+
+		static float getPeak(const double* const* samples, int numChannels, int numSamples) noexcept
+		{
+			auto peak = 0.;
+			for (auto ch = 0; ch < numChannels; ++ch)
+			{
+				const auto range = juce::FloatVectorOperations::findMinAndMax(samples[ch], numSamples);
+				peak = std::max(peak, std::max(-range.getStart(), range.getEnd()));
+			}
+			return static_cast<float>(peak);
+		}
+	};
+}
@@ -4,6 +4,8 @@
 #include <limits>
 #include "WHead.h"
 #include "PRM.h"
+#include "SimdPair.h"
+#include "Channels.h"
 
 namespace vibrato
 {
@@ -71,6 +73,34 @@ namespace vibrato
 		return InterpolationType::NumInterpolationTypes;
 	}
 
+	enum class EngineType
+	{
+		Delay, Allpass,
+		NumEngineTypes
+	};
+
+	inline juce::String toString(EngineType t)
+	{
+		switch (t)
+		{
+		case EngineType::Delay: return "delay";
+		case EngineType::Allpass: return "allpass";
+		default: return "";
+		}
+	}
+
+	inline EngineType toEngineType(const juce::String& t)
+	{
+		const auto numTypes = static_cast<int>(EngineType::NumEngineTypes);
+		for (auto i = 0; i < numTypes; ++i)
+		{
+			const auto type = static_cast<EngineType>(i);
+			if (t == toString(type))
+				return type;
+		}
+		return EngineType::Delay;
+	}
+
 	inline double lerp(const double* buffer, double x, int size) noexcept
 	{
 		return interpolation::lerp(buffer, x, size);
@@ -88,11 +118,165 @@ namespace vibrato
 		lp.makeFromDecayInFc(dampFc);
 	}
 
-	inline double waveshape(double x) noexcept
+	template<typename Value>
+	inline Value waveshape(Value x) noexcept
+	{
+		return Value(-.405548) * x * x * x + Value(1.34908) * x;
+	}
+
+	/* delaySecs, feedback[0,1]
+	how long it takes until the feedback loop decayed to -120db after the input went silent.
+	the waveshaper is steepest around 0, so its slope is the loop gain of a quiet tail.
+	returns infinity if the loop doesn't decay at all */
+	inline double getTailSecs(double delaySecs, double feedback) noexcept
+	{
+		const auto loopGain = 1.34908 * std::abs(feedback);
+		if (loopGain >= 1.)
+			return std::numeric_limits<double>::infinity();
+		auto numPasses = 1.;
+		if (loopGain > 0.)
+			numPasses += std::log(1e-6) / std::log(loopGain);
+		return numPasses * delaySecs;
+	}
+
+	/* ring, rA, rB, size, spline
+	taps two voices of a chorus. the samples are loaded one by one, but interpolated side by side */
+	inline simd::Pair<double> tapPair(const double* ring, double rA, double rB, int size, bool spline) noexcept
 	{
-		return -.405548 * x * x * x + 1.34908 * x;
+		using Pair = simd::Pair<double>;
+		const auto wrap = [size](int i)
+		{
+			return i >= size ? i - size : i < 0 ? i + size : i;
+		};
+
+		const auto fA = std::floor(rA);
+		const auto fB = std::floor(rB);
+		const auto iA = static_cast<int>(fA);
+		const auto iB = static_cast<int>(fB);
+		const auto t = Pair(rA - fA, rB - fB);
+		const auto v1 = Pair(ring[iA], ring[iB]);
+		const auto v2 = Pair(ring[wrap(iA + 1)], ring[wrap(iB + 1)]);
+		if (!spline)
+			return v1 + t * (v2 - v1);
+
+		const auto v0 = Pair(ring[wrap(iA - 1)], ring[wrap(iB - 1)]);
+		const auto v3 = Pair(ring[wrap(iA + 2)], ring[wrap(iB + 2)]);
+		const auto c1 = Pair(.5) * (v2 - v0);
+		const auto c2 = v0 - Pair(2.5) * v1 + Pair(2.) * v2 - Pair(.5) * v3;
+		const auto c3 = Pair(1.5) * (v1 - v2) + Pair(.5) * (v3 - v0);
+		return ((c3 * t + c2) * t + c1) * t + v1;
 	}
 
+	/*
+	the modulation of the voices of the chorus. a voice follows the vibrato's modulation from a moment ago,
+	so it moves like the first voice, but at another phase. the history is kept at a fraction of the processing rate
+	and spans a second. all voices share it and spread evenly across it, so its size doesn't depend on their number.
+	*/
+	struct VoiceHistory
+	{
+		static constexpr int MaxNumChannels = dsp::MaxNumChannels;
+		static constexpr int Decimation = 32;
+		static constexpr double LengthSecs = 1.;
+
+		VoiceHistory() :
+			buffer(),
+			idx(),
+			phase(),
+			size(2)
+		{}
+
+		void prepare(double Fs, int numChannels)
+		{
+			size = static_cast<int>(std::ceil(Fs * LengthSecs / static_cast<double>(Decimation))) + 2;
+			buffer.setSize(numChannels, size, false, true, false);
+			reset();
+		}
+
+		void reset() noexcept
+		{
+			buffer.clear();
+			idx.fill(0);
+			phase.fill(0);
+		}
+
+		size_t getMemoryUsage() const noexcept
+		{
+			return static_cast<size_t>(buffer.getNumChannels() * buffer.getNumSamples()) * sizeof(double);
+		}
+
+		int getSize() const noexcept
+		{
+			return size;
+		}
+
+		/* ch, mod, advances the history of ch by one processing sample */
+		void push(int ch, double mod) noexcept
+		{
+			if (++phase[ch] != Decimation)
+				return;
+			phase[ch] = 0;
+			buffer.setSample(ch, idx[ch], mod);
+			if (++idx[ch] == size)
+				idx[ch] = 0;
+		}
+
+		/* ch, mod, numSamples, advances the history of ch by a block.
+		it keeps going while there is only one voice, so a chorus can start from where the vibrato is */
+		void push(int ch, const double* mod, int numSamples) noexcept
+		{
+			for (auto s = 0; s < numSamples; ++s)
+				push(ch, mod[s]);
+		}
+
+		/* ch, offset, the modulation offset history points ago.
+		moves in between the points, so the voices don't step */
+		double operator()(int ch, double offset) const noexcept
+		{
+			auto x = static_cast<double>(idx[ch] - 1) + static_cast<double>(phase[ch]) / static_cast<double>(Decimation) - offset;
+			if (x < 0.)
+				x += static_cast<double>(size);
+			return interpolation::lerp(buffer.getReadPointer(ch), x, size);
+		}
+
+	protected:
+		AudioBufferD buffer;
+		std::array<int, MaxNumChannels> idx, phase;
+		int size;
+	};
+
+	// voices of the chorus
+	static constexpr int MaxNumVoices = 6;
+
+	/* where the voices of the chorus tap the history and how loud they are.
+	voices are tapped in pairs. with an odd number of them the last pair has a silent lane */
+	struct VoiceTaps
+	{
+		VoiceTaps() :
+			offsets(),
+			gains(),
+			numVoices(1)
+		{
+			set(1, 2);
+		}
+
+		/* numVoices, historySize */
+		void set(int _numVoices, int historySize) noexcept
+		{
+			numVoices = _numVoices;
+			const auto gain = 1. / static_cast<double>(numVoices);
+			for (auto v = 0; v < numVoices; ++v)
+			{
+				offsets[v] = static_cast<double>(v * (historySize - 2)) / static_cast<double>(numVoices);
+				gains[v] = gain;
+			}
+			offsets[numVoices] = offsets[numVoices - 1];
+			gains[numVoices] = 0.;
+		}
+
+		std::array<double, MaxNumVoices + 1> offsets, gains;
+		int numVoices;
+	};
+
 	struct SamplePair
 	{
 		double sIn, sOut;
@@ -107,12 +291,6 @@ namespace vibrato
 		const auto sIn = smpls[s] + sFb;
 		return { sIn, sOut };
 	}
-	
-	inline SamplePair getAllpassPair(double*, const double*, const InterpolationFunc&,
-		double, double, int, int) noexcept
-	{
-		return { 0.f, 0.f };
-	}
 
 	struct Delay
 	{
@@ -120,134 +298,255 @@ namespace vibrato
 			interpolationFuncs{ &lerp, &cubic },
 			filterUpdateFuncs{ &noUpdate, &updateFilter },
 			ringBuffer(),
-			delaySize(0.), delayMid(0.), delayMax(0.),
+			delaySize(0.), delayMid(0.), delayMax(0.), delayCentre(0.),
 			delaySizeInt(0)
 		{
 		}
 
-		void prepare(int s)
+		/* size, numChannels */
+		void prepare(int s, int numChannels)
 		{
 			delaySizeInt = s;
-			ringBuffer.setSize(2, delaySizeInt, false, true, false);
+			ringBuffer.setSize(numChannels, delaySizeInt, false, true, false);
 			delaySize = static_cast<double>(delaySizeInt);
 			delayMax = delaySize - 4.;
 			delayMid = delaySize * .5;
+			delayCentre = delayMid;
+		}
+
+		void reset() noexcept
+		{
+			ringBuffer.clear();
+			for (auto& lp : lps)
+				lp.y1 = 0.;
+		}
+
+		/* bytes allocated for the ring buffer */
+		size_t getMemoryUsage() const noexcept
+		{
+			return static_cast<size_t>(ringBuffer.getNumChannels() * ringBuffer.getNumSamples()) * sizeof(double);
+		}
+
+		/* lookahead [0, delayMid] */
+		void setLookahead(double lookahead) noexcept
+		{
+			delayCentre = juce::jlimit(0., delayMid, lookahead);
 		}
 
 		void operator()(double* const* samples, int numChannels, int numSamples,
 			double* const* vibBuf, const int* wHead, const double* fbBuf, const PRMInfo& dampFcInfo,
 			InterpolationType interpolationType) noexcept
 		{
-			synthesizeReadHead(numChannels, numSamples, vibBuf, wHead);
-			
-			auto ringBuf = ringBuffer.getArrayOfWritePointers();
+			for (auto ch = 0; ch < numChannels; ++ch)
+				processChannel(samples[ch], ch, numSamples, vibBuf[ch], wHead, fbBuf, dampFcInfo, interpolationType);
+		}
+
+		/* smpls, ch, numSamples, vib, wHead, fbBuf, dampFcInfo, interpolationType
+		channels don't share any state, so they can be processed on different threads */
+		void processChannel(double* smpls, int ch, int numSamples,
+			double* vib, const int* wHead, const double* fbBuf, const PRMInfo& dampFcInfo,
+			InterpolationType interpolationType) noexcept
+		{
+			synthesizeReadHead(vib, numSamples, wHead);
+
+			auto ring = ringBuffer.getWritePointer(ch);
 			const auto& interpolate = interpolationFuncs[static_cast<int>(interpolationType)];
 			const auto& updateFilter = filterUpdateFuncs[dampFcInfo.smoothing ? 1 : 0];
+			auto& lp = lps[ch];
 
-			for (auto ch = 0; ch < numChannels; ++ch)
+			for (auto s = 0; s < numSamples; ++s)
 			{
-				auto ring = ringBuf[ch];
-				const auto rHead = vibBuf[ch];
-				auto smpls = samples[ch];
-				auto& lp = lps[ch];
+				updateFilter(lp, dampFcInfo[s]);
+				
+				const auto w = wHead[s];
+				const auto r = vib[s];
+				const auto fb = fbBuf[s];
 
-				for (auto s = 0; s < numSamples; ++s)
-				{
-					updateFilter(lp, dampFcInfo[s]);
-					
-					const auto w = wHead[s];
-					const auto r = rHead[s];
-					const auto fb = fbBuf[s];
+				const auto pair = getDelayPair(smpls, ring, interpolate, lp, r, -fb, delaySizeInt, s);
 
-					const auto pair = getDelayPair(smpls, ring, interpolate, lp, r, -fb, delaySizeInt, s);
+				ring[w] = pair.sIn;
+				smpls[s] = pair.sOut;
+			}
+		}
 
-					ring[w] = pair.sIn;
-					smpls[s] = pair.sOut;
-				}
+		/* smplsL, smplsR, ch, numSamples, vibL, vibR, wHead, fbBuf, dampFcInfo, interpolationType
+		processes the channels ch and ch + 1 together, their damping filters and waveshapers share a register */
+		void processPair(double* smplsL, double* smplsR, int ch, int numSamples,
+			double* vibL, double* vibR, const int* wHead, const double* fbBuf, const PRMInfo& dampFcInfo,
+			InterpolationType interpolationType) noexcept
+		{
+			using Pair = simd::Pair<double>;
+			synthesizeReadHead(vibL, numSamples, wHead);
+			synthesizeReadHead(vibR, numSamples, wHead);
+
+			auto ringL = ringBuffer.getWritePointer(ch);
+			auto ringR = ringBuffer.getWritePointer(ch + 1);
+			const auto& interpolate = interpolationFuncs[static_cast<int>(interpolationType)];
+			const auto& updateFilter = filterUpdateFuncs[dampFcInfo.smoothing ? 1 : 0];
+			auto& lp = lps[ch];
+			auto y1 = Pair(lps[ch].y1, lps[ch + 1].y1);
+
+			for (auto s = 0; s < numSamples; ++s)
+			{
+				updateFilter(lp, dampFcInfo[s]);
+
+				const auto w = wHead[s];
+				const auto fb = Pair(-fbBuf[s]);
+
+				const auto sOut = Pair(interpolate(ringL, vibL[s], delaySizeInt), interpolate(ringR, vibR[s], delaySizeInt));
+				y1 = sOut * lp.a0 + y1 * lp.b1;
+				const auto sIn = Pair(smplsL[s], smplsR[s]) + waveshape(fb * y1);
+
+				ringL[w] = sIn.left();
+				ringR[w] = sIn.right();
+				smplsL[s] = sOut.left();
+				smplsR[s] = sOut.right();
 			}
+
+			lps[ch + 1].copyCutoffFrom(lp);
+			lps[ch].y1 = y1.left();
+			lps[ch + 1].y1 = y1.right();
 		}
 
-		void processNoDepth(double* const* samples, int numChannels, int numSamples,
-			const int* wHead) noexcept
+		/* smpls, ch, numSamples, vib, history, wHead, fbBuf, dampFcInfo, interpolationType, taps, tapsPrev, fade, fadeInc
+		the chorus. every voice reads its own tap from the ring and the feedback takes their mix.
+		vib is the modulation of the first voice, the others follow it through the history.
+		while fade is below 1 the mix of tapsPrev crossfades into the one of taps, so that changing the number of voices doesn't click */
+		void processVoicesChannel(double* smpls, int ch, int numSamples,
+			const double* vib, VoiceHistory& history, const int* wHead, const double* fbBuf, const PRMInfo& dampFcInfo,
+			InterpolationType interpolationType, const VoiceTaps& taps, const VoiceTaps& tapsPrev,
+			double fade, double fadeInc) noexcept
 		{
-			auto ringBuf = ringBuffer.getArrayOfWritePointers();
+			using Pair = simd::Pair<double>;
+			static constexpr double Pi = 3.1415926535897932384626433832795;
+			auto ring = ringBuffer.getWritePointer(ch);
+			const auto& updateFilter = filterUpdateFuncs[dampFcInfo.smoothing ? 1 : 0];
+			auto& lp = lps[ch];
+			const auto spline = interpolationType == InterpolationType::Spline;
 
-			for (auto ch = 0; ch < numChannels; ++ch)
+			const auto mixVoices = [&](const VoiceTaps& t, double mod, int w)
 			{
-				auto ring = ringBuf[ch];
-				auto smpls = samples[ch];
+				std::array<double, MaxNumVoices + 1> heads;
+				heads[0] = getReadHead(mod, w);
+				for (auto v = 1; v <= t.numVoices; ++v)
+					heads[v] = getReadHead(history(ch, t.offsets[v]), w);
 
-				for (auto s = 0; s < numSamples; ++s)
-				{
-					const auto w = wHead[s];
-					const auto r = w;
+				auto mix = Pair(0.);
+				for (auto v = 0; v < t.numVoices; v += 2)
+					mix = mix + tapPair(ring, heads[v], heads[v + 1], delaySizeInt, spline) * Pair(t.gains[v], t.gains[v + 1]);
+				return mix.left() + mix.right();
+			};
 
-					ring[w] = smpls[s];
-					smpls[s] = ring[r];
+			for (auto s = 0; s < numSamples; ++s)
+			{
+				updateFilter(lp, dampFcInfo[s]);
+
+				const auto w = wHead[s];
+				history.push(ch, vib[s]);
+				auto sOut = mixVoices(taps, vib[s], w);
+				if (fade < 1.)
+				{
+					const auto sOutPrev = mixVoices(tapsPrev, vib[s], w);
+					const auto x = .5 - .5 * std::cos(fade * Pi);
+					sOut = sOutPrev + x * (sOut - sOutPrev);
+					fade = std::min(1., fade + fadeInc);
 				}
+
+				const auto sFb = waveshape(-fbBuf[s] * lp(sOut));
+				ring[w] = smpls[s] + sFb;
+				smpls[s] = sOut;
 			}
 		}
+
+		/* smpls, ch, numSamples, wHead */
+		void processNoDepthChannel(double* smpls, int ch, int numSamples,
+			const int* wHead) noexcept
+		{
+			auto ring = ringBuffer.getWritePointer(ch);
+
+			for (auto s = 0; s < numSamples; ++s)
+			{
+				const auto w = wHead[s];
+				const auto r = w;
+
+				ring[w] = smpls[s];
+				smpls[s] = ring[r];
+			}
+		}
+
+		/* smpls, ch, numSamples, wHead
+		only writes the input to the ring, nothing is read */
+		void writeChannel(const double* smpls, int ch, int numSamples, const int* wHead) noexcept
+		{
+			auto ring = ringBuffer.getWritePointer(ch);
+			for (auto s = 0; s < numSamples; ++s)
+				ring[wHead[s]] = smpls[s];
+		}
+
+		/* numSamples, depthBuf, wHead
+		turns the depth buffer into the read head of the lookahead delay, call before processFFChannel */
+		void prepareFF(int numSamples, double* depthBuf, const int* wHead) noexcept
+		{
+			synthesizeReadHeadFF(numSamples, depthBuf, wHead);
+		}
 		
-		void processFF(double* const* samples, int numChannels, int numSamples,
-			double* depthBuf, const int* wHead,
+		/* smpls, ch, numSamples, rHead, wHead, interpolationType */
+		void processFFChannel(double* smpls, int ch, int numSamples,
+			const double* rHead, const int* wHead,
 			InterpolationType interpolationType) noexcept
 		{
-			synthesizeReadHeadFF(numSamples, depthBuf, wHead);
-
-			auto ringBuf = ringBuffer.getArrayOfWritePointers();
+			auto ring = ringBuffer.getWritePointer(ch);
 			const auto& interpolate = interpolationFuncs[static_cast<int>(interpolationType)];
 
-			for (auto ch = 0; ch < numChannels; ++ch)
+			for (auto s = 0; s < numSamples; ++s)
 			{
-				auto ring = ringBuf[ch];
-				auto smpls = samples[ch];
-
-				for (auto s = 0; s < numSamples; ++s)
-				{
-					const auto w = wHead[s];
-					const auto r = depthBuf[s];
+				const auto w = wHead[s];
+				const auto r = rHead[s];
 
-					ring[w] = smpls[s];
-					smpls[s] = interpolate(ring, r, delaySizeInt);
-				}
+				ring[w] = smpls[s];
+				smpls[s] = interpolate(ring, r, delaySizeInt);
 			}
 		}
 
 	private:
 		std::array<InterpolationFunc, 2> interpolationFuncs;
 		std::array<FilterUpdateFunc, 2> filterUpdateFuncs;
-		std::array<LP, 2> lps;
+		std::array<LP, dsp::MaxNumChannels> lps;
 		AudioBufferD ringBuffer;
-		double delaySize, delayMid, delayMax;
+		double delaySize, delayMid, delayMax, delayCentre;
 		int delaySizeInt;
 
-		void synthesizeReadHead(int numChannels, int numSamples, double* const* vibBuf, const int* wHead) noexcept
+		void synthesizeReadHead(double* buf, int numSamples, const int* wHead) noexcept
+		{
+			// map buffer [-1, 1] to [-delayMax, delayMax]
+			juce::FloatVectorOperations::multiply(buf, delayMax, numSamples);
+			// map buffer [-delayMax, delayMax] to [0, delaySize]
+			juce::FloatVectorOperations::add(buf, delaySize, numSamples);
+			// map buffer [0, delayMax * 2] to [0, delayMax]
+			juce::FloatVectorOperations::multiply(buf, .5, numSamples);
+
+			synthesizeReadHeadAbs(buf, numSamples, wHead);
+		}
+
+		/* mod[-1,1], w, the read head synthesizeReadHead makes of a single sample */
+		double getReadHead(double mod, int w) const noexcept
 		{
-			for (auto ch = 0; ch < numChannels; ++ch)
-			{
-				auto buf = vibBuf[ch];
-				// map buffer [-1, 1] to [-delayMax, delayMax]
-				juce::FloatVectorOperations::multiply(buf, delayMax, numSamples);
-				// map buffer [-delayMax, delayMax] to [0, delaySize]
-				juce::FloatVectorOperations::add(buf, delaySize, numSamples);
-				// map buffer [0, delayMax * 2] to [0, delayMax]
-				juce::FloatVectorOperations::multiply(buf, .5, numSamples);
-
-				synthesizeReadHead(buf, numSamples, wHead);
-			}
+			auto rh = static_cast<double>(w) - (mod * delayMax + delaySize) * .5;
+			if (rh < 0.)
+				rh += delaySize;
+			return rh;
 		}
 
 		void synthesizeReadHeadFF(int numSamples, double* depthBuf, const int* wHead) noexcept
 		{
-			// map from [0, 1] to [1, 0]
+			// map from [0, 1] to [delayCentre, delayCentre - delayMid]
+			// if depth exceeds what the lookahead was made for the read head sticks to the write head
 			for (auto s = 0; s < numSamples; ++s)
-				depthBuf[s] = 1. - depthBuf[s];
-			// map from [1, 0] to [delayMid, 0]
-			juce::FloatVectorOperations::multiply(depthBuf, delayMid, numSamples);
-			synthesizeReadHead(depthBuf, numSamples, wHead);
+				depthBuf[s] = std::max(delayCentre - depthBuf[s] * delayMid, 0.);
+			synthesizeReadHeadAbs(depthBuf, numSamples, wHead);
 		}
 
-		void synthesizeReadHead(double* buf, int numSamples, const int* wHead) noexcept
+		void synthesizeReadHeadAbs(double* buf, int numSamples, const int* wHead) noexcept
 		{
 			for (auto s = 0; s < numSamples; ++s)
 			{
@@ -263,73 +562,211 @@ namespace vibrato
 
 	struct Processor
 	{
+		// how long a change of the number of voices crossfades
+		static constexpr double VoicesFadeMs = 20.;
+
 		Processor() :
 			feedbackPRM(0.f),
 			dampPRM(1.f),
+			fbInfo(nullptr, 0., false),
+			dampInfo(nullptr, 1., false),
 			wHead(),
 			vibrato(),
 			delayFF(),
+			history(),
+			taps(),
+			tapsPrev(),
 			fsInv(1.f),
-			size(0)
+			voicesFadeInc(1.),
+			voicesFade(1.),
+			voicesFadeStart(1.),
+			size(0),
+			lookahead(0),
+			numVoices(1),
+			numVoicesTarget(1),
+			isVibrating(false)
 		{
 		}
 		
-		void prepare(double Fs, int blockSize, int _delaySize)
+		/* Fs, blockSize, delaySize, lookahead [0, delaySize / 2], numChannels */
+		void prepare(double Fs, int blockSize, int _delaySize, int _lookahead, int numChannels)
 		{
 			size = _delaySize;
+			lookahead = _lookahead;
 			wHead.prepare(blockSize, size);
-			vibrato.prepare(size);
-			delayFF.prepare(size);
+			vibrato.prepare(size, numChannels);
+			delayFF.prepare(size, numChannels);
+			delayFF.setLookahead(static_cast<double>(lookahead));
+			history.prepare(Fs, numChannels);
 			feedbackPRM.prepare(Fs, blockSize, 8.);
 			dampPRM.prepare(Fs, blockSize, 13.);
 
 			fsInv = 1. / Fs;
+			voicesFadeInc = 1000. / (VoicesFadeMs * Fs);
+			numVoices = numVoicesTarget;
+			taps.set(numVoices, history.getSize());
+			tapsPrev = taps;
+			voicesFade = voicesFadeStart = 1.;
+		}
+
+		/* clears the delays, f.ex. after processing was skipped for a while */
+		void reset() noexcept
+		{
+			vibrato.reset();
+			delayFF.reset();
+			history.reset();
+		}
+
+		/* numVoices [1, MaxNumVoices]
+		more than one voice turns the vibrato into a chorus, that reads them all from the same ring.
+		the next block crossfades to the new voices, the memory stays the same */
+		void setNumVoices(int n) noexcept
+		{
+			numVoicesTarget = juce::jlimit(1, MaxNumVoices, n);
 		}
 
 		/* samples, numChannels, numSamples, vibBuf, depthBuf[0,1], feedback[-1,1], dampHz[1, N], lookaheadEnabled */
 		void operator()(double* const* samples, int numChannels, int numSamples,
 			double* const* vibBuf, double* depthBuf, double feedback, double dampHz, InterpolationType interpolationType,
 			bool lookaheadEnabled) noexcept
+		{
+			prepareBlock(numSamples, depthBuf, feedback, dampHz, lookaheadEnabled);
+			auto ch = 0;
+			// the voices of the chorus share the register instead
+			if (isChorus())
+				for (; ch < numChannels; ++ch)
+					processChannel(samples[ch], ch, numSamples, vibBuf[ch], depthBuf, interpolationType, lookaheadEnabled);
+			for (; ch + 1 < numChannels; ch += 2)
+				processPair(samples[ch], samples[ch + 1], ch, numSamples, vibBuf[ch], vibBuf[ch + 1], depthBuf, interpolationType, lookaheadEnabled);
+			if (ch < numChannels)
+				processChannel(samples[ch], ch, numSamples, vibBuf[ch], depthBuf, interpolationType, lookaheadEnabled);
+		}
+
+		/* samples, numChannels, numSamples, lookaheadEnabled
+		writes the input to the delays like a block without depth would, while the wet signal isn't needed.
+		the delays stay filled, so the wet signal can come back without waiting for them to fill up */
+		void feed(const double* const* samples, int numChannels, int numSamples, bool lookaheadEnabled) noexcept
+		{
+			wHead(numSamples);
+			for (auto ch = 0; ch < numChannels; ++ch)
+			{
+				vibrato.writeChannel(samples[ch], ch, numSamples, wHead.data());
+				if (lookaheadEnabled)
+					delayFF.writeChannel(samples[ch], ch, numSamples, wHead.data());
+			}
+		}
+
+		/* numSamples, depthBuf[0,1], feedback[-1,1], dampHz[1, N], lookaheadEnabled
+		advances everything the channels share, call once per block before processChannel */
+		void prepareBlock(int numSamples, double* depthBuf, double feedback, double dampHz,
+			bool lookaheadEnabled) noexcept
 		{
 			wHead(numSamples);
 			
-			const bool isVibrating = depthBuf[0] != 0.;
+			isVibrating = depthBuf[0] != 0.;
+
+			// a fade that is still going on finishes first, the voices change in the block after
+			voicesFadeStart = voicesFade;
+			if (voicesFade == 1. && numVoicesTarget != numVoices)
+			{
+				tapsPrev = taps;
+				numVoices = numVoicesTarget;
+				taps.set(numVoices, history.getSize());
+				voicesFadeStart = 0.;
+			}
+			voicesFade = std::min(1., voicesFadeStart + voicesFadeInc * static_cast<double>(numSamples));
 
 			if (isVibrating)
 			{
-				const auto fbInfo = feedbackPRM(feedback, numSamples);
+				fbInfo = feedbackPRM(feedback, numSamples);
 				if (!fbInfo.smoothing)
 					juce::FloatVectorOperations::fill(fbInfo.buf, feedback, numSamples);
 
 				const auto dampFc = dampHz * fsInv;
-				const auto dampInfo = dampPRM(dampFc, numSamples);
+				dampInfo = dampPRM(dampFc, numSamples);
+			}
+
+			if (lookaheadEnabled)
+				delayFF.prepareFF(numSamples, depthBuf, wHead.data());
+		}
 
-				vibrato
+		/* smpls, ch, numSamples, vib, depthBuf, interpolationType, lookaheadEnabled
+		can run on any thread, as long as every channel only runs once per block */
+		void processChannel(double* smpls, int ch, int numSamples,
+			double* vib, const double* depthBuf, InterpolationType interpolationType,
+			bool lookaheadEnabled) noexcept
+		{
+			if (isChorus())
+				vibrato.processVoicesChannel
 				(
-					samples, numChannels, numSamples,
-					vibBuf,
+					smpls, ch, numSamples,
+					vib, history,
 					wHead.data(),
 					fbInfo.buf, dampInfo,
-					interpolationType
+					interpolationType,
+					taps, tapsPrev,
+					voicesFadeStart, voicesFadeInc
 				);
-			}
 			else
-				vibrato.processNoDepth
-				(
-					samples, numChannels, numSamples,
-					wHead.data()
-				);
+			{
+				if (isVibrating)
+					vibrato.processChannel
+					(
+						smpls, ch, numSamples,
+						vib,
+						wHead.data(),
+						fbInfo.buf, dampInfo,
+						interpolationType
+					);
+				else
+					vibrato.processNoDepthChannel
+					(
+						smpls, ch, numSamples,
+						wHead.data()
+					);
+				history.push(ch, vib, numSamples);
+			}
 
 			if(lookaheadEnabled)
-				delayFF.processFF
+				delayFF.processFFChannel
 				(
-					samples, numChannels, numSamples,
+					smpls, ch, numSamples,
 					depthBuf,
 					wHead.data(),
 					interpolationType
 				);
 		}
 		
+		/* smplsL, smplsR, ch, numSamples, vibL, vibR, depthBuf, interpolationType, lookaheadEnabled
+		like processChannel, but for the channels ch and ch + 1 at once */
+		void processPair(double* smplsL, double* smplsR, int ch, int numSamples,
+			double* vibL, double* vibR, const double* depthBuf, InterpolationType interpolationType,
+			bool lookaheadEnabled) noexcept
+		{
+			if (isVibrating)
+				vibrato.processPair
+				(
+					smplsL, smplsR, ch, numSamples,
+					vibL, vibR,
+					wHead.data(),
+					fbInfo.buf, dampInfo,
+					interpolationType
+				);
+			else
+			{
+				vibrato.processNoDepthChannel(smplsL, ch, numSamples, wHead.data());
+				vibrato.processNoDepthChannel(smplsR, ch + 1, numSamples, wHead.data());
+			}
+			history.push(ch, vibL, numSamples);
+			history.push(ch + 1, vibR, numSamples);
+
+			if (lookaheadEnabled)
+			{
+				delayFF.processFFChannel(smplsL, ch, numSamples, depthBuf, wHead.data(), interpolationType);
+				delayFF.processFFChannel(smplsR, ch + 1, numSamples, depthBuf, wHead.data(), interpolationType);
+			}
+		}
+		
 		double getSizeInMs(double Fs) const noexcept
 		{
 			return 1000. * static_cast<double>(size) / Fs;
@@ -337,15 +774,34 @@ namespace vibrato
 		
 		int getLatency() const noexcept
 		{
-			return static_cast<int>(size) / 2;
+			return lookahead;
+		}
+
+		/* bytes of state, without the parameter smoothing buffers every engine has */
+		size_t getMemoryUsage() const noexcept
+		{
+			return sizeof(*this)
+				+ vibrato.getMemoryUsage() + delayFF.getMemoryUsage() + history.getMemoryUsage()
+				+ static_cast<size_t>(wHead.buf.size()) * sizeof(int);
 		}
 		
 	protected:
 		PRM feedbackPRM, dampPRM;
+		PRMInfo fbInfo, dampInfo;
 		WHead wHead;
 		Delay vibrato, delayFF;
-		double fsInv;
-		int size;
+		VoiceHistory history;
+		// the voices of this block and the ones they crossfade from
+		VoiceTaps taps, tapsPrev;
+		double fsInv, voicesFadeInc, voicesFade, voicesFadeStart;
+		int size, lookahead, numVoices, numVoicesTarget;
+		bool isVibrating;
+
+		/* the chorus also runs while it fades back to a single voice */
+		bool isChorus() const noexcept
+		{
+			return isVibrating && (numVoices > 1 || voicesFadeStart < 1.);
+		}
 		
 		const size_t ringBufferSize() const noexcept
 		{
@@ -357,6 +813,5 @@ namespace vibrato
 /*
 
 feature ideas:
-	allpass instead of delay
 
 */
\ No newline at end of file
@@ -1,5 +1,5 @@
 #pragma once
-#include <vector>
+#include "Arena.h"
 
 namespace dsp
 {
@@ -55,7 +55,7 @@ namespace dsp
 			wHead = buf[numSamples - 1];
 		}
 		
-		std::vector<int> buf;
+		Scratch<int> buf;
 		int wHead, delaySize;
 	};
 }
\ No newline at end of file
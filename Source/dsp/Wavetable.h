@@ -1,6 +1,9 @@
 #pragma once
 #include <juce_core/juce_core.h>
+#include <atomic>
 #include <functional>
+#include <memory>
+#include <mutex>
 
 namespace dsp
 {
@@ -376,84 +379,151 @@ namespace dsp
         using Func = typename Table::Func;
 		using Funcs = std::array<Func, NumTables>;
 
+		// the table sets are computed once per process and only pointed at from there
 		void makeTablesWeierstrass()
 		{
 			name = "Weierstrass";
-			auto wt = NumTablesInv * static_cast<Float>(.5);
-			for (auto n = 0; n < NumTables; ++n, wt += NumTablesInv)
+			copyFromCache(0, [](Table& t)
 			{
-				tables[n].makeTableWeierstrass(wt);
-			}
+				auto wt = NumTablesInv * static_cast<Float>(.5);
+				for (auto n = 0; n < NumTables; ++n, wt += NumTablesInv)
+					t[n].makeTableWeierstrass(wt);
+			});
 		}
 
 		void makeTablesTriangles()
 		{
 			name = "Triangle";
-			auto wt = NumTablesInv * static_cast<Float>(.5);
-			for (auto n = 0; n < NumTables; ++n, wt += NumTablesInv)
+			copyFromCache(1, [](Table& t)
 			{
-				tables[n].makeTableTriangle(wt);
-			}
+				auto wt = NumTablesInv * static_cast<Float>(.5);
+				for (auto n = 0; n < NumTables; ++n, wt += NumTablesInv)
+					t[n].makeTableTriangle(wt);
+			});
 		}
 
 		void makeTablesSinc()
 		{
 			name = "Sinc";
-			auto wt = NumTablesInv * static_cast<Float>(.5);
-			for (auto n = 0; n < NumTables; ++n, wt += NumTablesInv)
-				tables[n].makeTableSinc(wt);
+			copyFromCache(2, [](Table& t)
+			{
+				auto wt = NumTablesInv * static_cast<Float>(.5);
+				for (auto n = 0; n < NumTables; ++n, wt += NumTablesInv)
+					t[n].makeTableSinc(wt);
+			});
 		}
 
 		void makeTablesPWMSine()
 		{
 			name = "PWM Sine";
-			auto wt = NumTablesInv * static_cast<Float>(.5);
-			for (auto n = 0; n < NumTables; ++n, wt += NumTablesInv)
-				tables[n].makePWMSine(wt);
+			copyFromCache(3, [](Table& t)
+			{
+				auto wt = NumTablesInv * static_cast<Float>(.5);
+				for (auto n = 0; n < NumTables; ++n, wt += NumTablesInv)
+					t[n].makePWMSine(wt);
+			});
 		}
 
 		void makeSqueeze()
 		{
 			name = "Squeeze";
-			auto wt = NumTablesInv * static_cast<Float>(.5);
-			for (auto n = 0; n < NumTables; ++n, wt += NumTablesInv)
-				tables[n].makeSqueeze(wt);
+			copyFromCache(4, [](Table& t)
+			{
+				auto wt = NumTablesInv * static_cast<Float>(.5);
+				for (auto n = 0; n < NumTables; ++n, wt += NumTablesInv)
+					t[n].makeSqueeze(wt);
+			});
 		}
 
 		Wavetable3D() :
-			tables(),
-			name("empty table")
+			name("empty table"),
+			source(),
+			table(&getEmpty()),
+			version(0)
 		{}
 
-		void fill(const Funcs& funcs, bool removeDC, bool normalize)
+		/* _table, _name, _source
+		uses a table set that is kept alive elsewhere, f.ex. an imported one */
+		void setTable(const Table& _table, const String& _name, const String& _source) noexcept
+		{
+			name = _name;
+			source = _source;
+			store(_table);
+		}
+
+		/* the table set can be swapped any time, so the audio thread gets it once per block */
+		const Table& getTable() const noexcept
+		{
+			return *table.load();
+		}
+
+		/* changes whenever the table set is swapped, even to one at an address an earlier one had.
+		it's bumped after the swap, so a version read before getTable never belongs to a newer table set */
+		juce::uint32 getVersion() const noexcept
 		{
-			for (auto f = 0; f < NumTables; ++f)
-				tables.fill(funcs[f], f, removeDC, normalize);
-			tables.finishFills();
+			return version.load(std::memory_order_acquire);
 		}
 
 		Float operator()(Float tablesPhase, Float tablePhase) const noexcept
 		{
-			return tables(tablesPhase, tablePhase);
+			return getTable()(tablesPhase, tablePhase);
 		}
 
 		Float operator()(Float tablesPhase, int tableIdx) const noexcept
 		{
-			return tables(tablesPhase, tableIdx);
+			return getTable()(tablesPhase, tableIdx);
 		}
 
 		Float operator()(int tablesIdx, Float tablePhase) const noexcept
 		{
-			return tables(tablesIdx, tablePhase);
+			return getTable()(tablesIdx, tablePhase);
 		}
 
 		Float operator()(int tablesIdx, int tableIdx) const noexcept
 		{
-			return tables(tablesIdx, tableIdx);
+			return getTable()(tablesIdx, tableIdx);
 		}
 
-		Table tables;
 		String name;
+		// where an imported table set came from, empty for the built-in ones
+		String source;
+
+	private:
+		std::atomic<const Table*> table;
+		std::atomic<juce::uint32> version;
+
+		void store(const Table& t) noexcept
+		{
+			// unique across all instances, so a version never means two different table sets
+			static std::atomic<juce::uint32> counter { 0 };
+			table.store(&t);
+			version.store(++counter, std::memory_order_release);
+		}
+
+		static const Table& getEmpty()
+		{
+			static const Table empty;
+			return empty;
+		}
+
+		static constexpr int NumCachedTypes = 5;
+
+		/* cacheIdx, makeFunc(Table&) */
+		template<typename MakeFunc>
+		void copyFromCache(int cacheIdx, MakeFunc&& makeFunc)
+		{
+			static std::array<std::once_flag, NumCachedTypes> flags;
+			static std::array<std::unique_ptr<Table>, NumCachedTypes> cache;
+
+			std::call_once(flags[cacheIdx], [&]()
+			{
+				auto t = std::make_unique<Table>();
+				makeFunc(*t);
+				cache[cacheIdx] = std::move(t);
+			});
+			source = String();
+			store(*cache[cacheIdx]);
+		}
 	};
 
 	enum TableType { Weierstrass, Tri, Sinc, PWMSine, Squeeze, NumTypes };
@@ -0,0 +1,338 @@
+#include "WavetableLibrary.h"
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_events/juce_events.h>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+#include "../FormulaParser.h"
+#include "../Interpolation.h"
+
+namespace dsp
+{
+	using Table = WavetableLibrary::Table;
+	using Frames = std::vector<std::vector<double>>;
+
+	// the cache file is a header followed by the raw table, so the mapped file can be used as it is
+	static_assert(std::is_trivially_copyable<Table>::value, "tables are written to disk byte by byte");
+
+	static constexpr const char* FilePrefix = "file:";
+	static constexpr const char* FormulaPrefix = "formula:";
+
+	struct CacheHeader
+	{
+		char magic[4];
+		juce::int32 version, tableSize, numTables, tableBytes, reserved;
+		// tells apart byte orders and float formats
+		double one;
+		juce::int64 key;
+		char padding[24];
+	};
+	static_assert(sizeof(CacheHeader) == 64, "keeps the table behind the header aligned");
+
+	/* source, identifies the content, so that an edited file gets a new cache file */
+	static juce::int64 makeKey(const String& source)
+	{
+		if (!source.startsWith(FilePrefix))
+			return source.hashCode64();
+		const juce::File file(source.fromFirstOccurrenceOf(FilePrefix, false, false));
+		return (source
+			+ String(file.getSize())
+			+ String(file.getLastModificationTime().toMilliseconds())).hashCode64();
+	}
+
+	static CacheHeader makeHeader(juce::int64 key) noexcept
+	{
+		CacheHeader header;
+		std::memset(&header, 0, sizeof(CacheHeader));
+		header.magic[0] = 'N';
+		header.magic[1] = 'E';
+		header.magic[2] = 'L';
+		header.magic[3] = 'W';
+		header.version = WavetableLibrary::CacheVersion;
+		header.tableSize = LFOTableSize;
+		header.numTables = LFONumTables;
+		header.tableBytes = static_cast<juce::int32>(sizeof(Table));
+		header.one = 1.;
+		header.key = key;
+		return header;
+	}
+
+	static juce::File getCacheFile(juce::int64 key)
+	{
+		const auto slash = juce::File::getSeparatorString();
+		const auto specialLoc = juce::File::getSpecialLocation(juce::File::SpecialLocationType::userApplicationDataDirectory);
+		return juce::File(specialLoc.getFullPathName() + slash + "Mrugalla" + slash + "SharedState" + slash + "Wavetables"
+			+ slash + String::toHexString(key) + ".nelwt");
+	}
+
+	/* file, frames, returns an error or an empty string */
+	static String readFrames(const juce::File& file, Frames& frames)
+	{
+		juce::AudioFormatManager formats;
+		formats.registerBasicFormats();
+		std::unique_ptr<juce::AudioFormatReader> reader(formats.createReaderFor(file));
+		if (reader == nullptr)
+			return "Can't read " + file.getFileName() + ".";
+
+		const auto length = static_cast<int>(std::min(reader->lengthInSamples,
+			static_cast<juce::int64>(WavetableLibrary::FrameSize) * WavetableLibrary::MaxNumFrames));
+		if (length < 4)
+			return file.getFileName() + " is too short for a wavetable.";
+
+		const auto numChannels = static_cast<int>(reader->numChannels);
+		juce::AudioBuffer<float> buffer(numChannels, length);
+		reader->read(&buffer, 0, length, 0, true, true);
+
+		const auto frameSize = length % WavetableLibrary::FrameSize == 0 ? WavetableLibrary::FrameSize : length;
+		const auto gain = 1. / static_cast<double>(numChannels);
+		frames.resize(static_cast<size_t>(length / frameSize));
+		for (auto f = 0; f < static_cast<int>(frames.size()); ++f)
+		{
+			auto& frame = frames[f];
+			frame.assign(static_cast<size_t>(frameSize), 0.);
+			for (auto ch = 0; ch < numChannels; ++ch)
+			{
+				const auto samples = buffer.getReadPointer(ch, f * frameSize);
+				for (auto s = 0; s < frameSize; ++s)
+					frame[s] += gain * static_cast<double>(samples[s]);
+			}
+		}
+		return {};
+	}
+
+	/* formulas, frames, returns an error or an empty string */
+	static String parseFrames(const String& formulas, Frames& frames)
+	{
+		const auto terms = juce::StringArray::fromTokens(formulas, ";", "");
+		for (const auto& term : terms)
+		{
+			if (term.trim().isEmpty())
+				continue;
+			fx::Parser parse;
+			if (!parse(term.trim()))
+				return term.trim() + ": " + fx::toString(parse.errorType);
+
+			const auto frameSize = WavetableLibrary::FrameSize;
+			std::vector<double> frame(static_cast<size_t>(frameSize));
+			for (auto s = 0; s < frameSize; ++s)
+			{
+				const auto x = 2.f * static_cast<float>(s) / static_cast<float>(frameSize) - 1.f;
+				const auto y = static_cast<double>(parse(x));
+				frame[s] = std::isfinite(y) ? y : 0.;
+			}
+			frames.push_back(std::move(frame));
+			if (static_cast<int>(frames.size()) == WavetableLibrary::MaxNumFrames)
+				break;
+		}
+		if (frames.empty())
+			return "Enter at least one formula.";
+		return {};
+	}
+
+	/* frames, table
+	spreads the frames across the table positions, with crossfades in between.
+	every frame loses its dc offset and the whole set is normalized, so the frames keep their relative levels */
+	static String makeTable(Frames& frames, Table& table)
+	{
+		auto peak = 0.;
+		for (auto& frame : frames)
+		{
+			auto sum = 0.;
+			for (const auto s : frame)
+				sum += s;
+			const auto dc = sum / static_cast<double>(frame.size());
+			for (auto& s : frame)
+			{
+				s -= dc;
+				peak = std::max(peak, std::abs(s));
+			}
+		}
+		if (peak == 0.)
+			return "The wavetable is silent.";
+		const auto gain = 1. / peak;
+
+		const auto maxFrame = static_cast<double>(frames.size() - 1);
+		for (auto n = 0; n < LFONumTables; ++n)
+		{
+			const auto pos = maxFrame * static_cast<double>(n) / static_cast<double>(LFONumTables - 1);
+			const auto f0 = static_cast<int>(pos);
+			const auto f1 = std::min(f0 + 1, static_cast<int>(frames.size()) - 1);
+			const auto frac = pos - static_cast<double>(f0);
+			const auto& frame0 = frames[f0];
+			const auto& frame1 = frames[f1];
+
+			table.fill([&](double x)
+			{
+				// x[-1,1] to the frame's sample positions
+				const auto size0 = static_cast<int>(frame0.size());
+				const auto size1 = static_cast<int>(frame1.size());
+				const auto phase = (x + 1.) * .5;
+				const auto y0 = interpolation::cubicHermiteSpline(frame0.data(), phase * static_cast<double>(size0), size0);
+				const auto y1 = interpolation::cubicHermiteSpline(frame1.data(), phase * static_cast<double>(size1), size1);
+				return gain * (y0 + frac * (y1 - y0));
+			}, n, false, false);
+		}
+		table.finishFills();
+		return {};
+	}
+
+	/* source, table, returns an error or an empty string */
+	static String importSource(const String& source, Table& table)
+	{
+		Frames frames;
+		String error;
+		if (source.startsWith(FilePrefix))
+			error = readFrames(juce::File(source.fromFirstOccurrenceOf(FilePrefix, false, false)), frames);
+		else if (source.startsWith(FormulaPrefix))
+			error = parseFrames(source.fromFirstOccurrenceOf(FormulaPrefix, false, false), frames);
+		else
+			error = "Unknown wavetable source.";
+		if (error.isNotEmpty())
+			return error;
+		return makeTable(frames, table);
+	}
+
+	struct WavetableLibrary::Data
+	{
+		struct Entry
+		{
+			std::unique_ptr<juce::MemoryMappedFile> map;
+			// only if the cache file couldn't be written
+			std::unique_ptr<Table> owned;
+			const Table* table;
+		};
+
+		/* source, returns nullptr if it's neither loaded nor cached */
+		const Table* find(const String& source)
+		{
+			const std::lock_guard<std::mutex> lock(mutex);
+			const auto entry = entries.find(source);
+			if (entry != entries.end())
+				return entry->second.table;
+
+			const auto key = makeKey(source);
+			auto map = std::make_unique<juce::MemoryMappedFile>(getCacheFile(key), juce::MemoryMappedFile::readOnly);
+			if (map->getData() == nullptr || map->getSize() != sizeof(CacheHeader) + sizeof(Table))
+				return nullptr;
+			const auto header = static_cast<const CacheHeader*>(map->getData());
+			const auto expected = makeHeader(key);
+			if (std::memcmp(header, &expected, sizeof(CacheHeader)) != 0)
+				return nullptr;
+
+			const auto table = reinterpret_cast<const Table*>(static_cast<const char*>(map->getData()) + sizeof(CacheHeader));
+			entries[source] = { std::move(map), nullptr, table };
+			return table;
+		}
+
+		/* source, table, writes the cache file and maps it, or keeps the table in memory if that fails */
+		const Table* insert(const String& source, std::unique_ptr<Table>&& table)
+		{
+			const auto key = makeKey(source);
+			const auto file = getCacheFile(key);
+			const auto header = makeHeader(key);
+			file.getParentDirectory().createDirectory();
+			{
+				juce::TemporaryFile tmp(file);
+				juce::FileOutputStream stream(tmp.getFile());
+				if (stream.openedOk()
+					&& stream.write(&header, sizeof(CacheHeader))
+					&& stream.write(table.get(), sizeof(Table)))
+				{
+					stream.flush();
+					if (!stream.getStatus().failed())
+						tmp.overwriteTargetFileWithTemporary();
+				}
+			}
+
+			const std::lock_guard<std::mutex> lock(mutex);
+			const auto entry = entries.find(source);
+			if (entry != entries.end())
+				return entry->second.table;
+
+			auto map = std::make_unique<juce::MemoryMappedFile>(file, juce::MemoryMappedFile::readOnly);
+			if (map->getData() != nullptr && map->getSize() == sizeof(CacheHeader) + sizeof(Table))
+			{
+				const auto mapped = reinterpret_cast<const Table*>(static_cast<const char*>(map->getData()) + sizeof(CacheHeader));
+				entries[source] = { std::move(map), nullptr, mapped };
+				return mapped;
+			}
+			const auto owned = table.get();
+			entries[source] = { nullptr, std::move(table), owned };
+			return owned;
+		}
+
+		std::mutex mutex;
+		std::map<String, Entry> entries;
+	};
+
+	WavetableLibrary::WavetableLibrary() :
+		data(std::make_shared<Data>()),
+		thread(1)
+	{}
+
+	WavetableLibrary::~WavetableLibrary()
+	{
+		thread.removeAllJobs(true, 4000);
+	}
+
+	String WavetableLibrary::makeSourceFile(const juce::File& file)
+	{
+		return FilePrefix + file.getFullPathName();
+	}
+
+	String WavetableLibrary::makeSourceFormula(const String& formulas)
+	{
+		return FormulaPrefix + formulas;
+	}
+
+	String WavetableLibrary::getName(const String& source)
+	{
+		if (source.startsWith(FilePrefix))
+			return juce::File(source.fromFirstOccurrenceOf(FilePrefix, false, false)).getFileNameWithoutExtension();
+		return "Formula";
+	}
+
+	const Table* WavetableLibrary::find(const String& source)
+	{
+		return data->find(source);
+	}
+
+	void WavetableLibrary::load(const String& source, Callback&& callback, bool synchronous)
+	{
+		const auto mm = juce::MessageManager::getInstanceWithoutCreating();
+		if (synchronous || mm == nullptr)
+		{
+			if (const auto table = find(source))
+				return callback(table, {});
+			auto table = std::make_unique<Table>();
+			const auto error = importSource(source, *table);
+			return callback(error.isEmpty() ? data->insert(source, std::move(table)) : nullptr, error);
+		}
+
+		if (const auto table = find(source))
+		{
+			if (mm->isThisTheMessageThread())
+				return callback(table, {});
+			juce::MessageManager::callAsync([cb = std::move(callback), table]()
+			{
+				cb(table, {});
+			});
+			return;
+		}
+
+		thread.addJob([d = data, source, cb = std::move(callback)]()
+		{
+			auto table = std::make_unique<Table>();
+			const auto error = importSource(source, *table);
+			const auto result = error.isEmpty() ? d->insert(source, std::move(table)) : nullptr;
+
+			juce::MessageManager::callAsync([cb, result, error]()
+			{
+				cb(result, error);
+			});
+		});
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <juce_core/juce_core.h>
+#include <functional>
+#include <memory>
+#include "Wavetable.h"
+
+namespace dsp
+{
+	/*
+	user wavetables for the lfo, imported from audio files of single cycle frames or from formulas.
+	a source is resampled and normalized into the LFOTables layout on a background thread
+	and written to a binary cache file, that later sessions memory-map instead of importing it again.
+	tables stay loaded until the last plugin instance goes, so using one only swaps a pointer.
+	*/
+	struct WavetableLibrary
+	{
+		using Table = LFOTables::Table;
+		/* table, error. table is nullptr if the import failed */
+		using Callback = std::function<void(const Table*, const String&)>;
+
+		// bump this whenever the import or the table layout changes, older cache files are ignored then
+		static constexpr int CacheVersion = 1;
+		// samples per frame of a wavetable file. files of any other length are one single cycle
+		static constexpr int FrameSize = 2048;
+		static constexpr int MaxNumFrames = 256;
+
+		WavetableLibrary();
+
+		~WavetableLibrary();
+
+		/* file, wav, aiff or flac */
+		static String makeSourceFile(const juce::File&);
+
+		/* formulas of x[-1,1], separated by ';'. each one is a frame */
+		static String makeSourceFormula(const String&);
+
+		/* source, how the table is called in the browser */
+		static String getName(const String&);
+
+		/* source, returns the table if it was imported before, in this session or in an earlier one.
+		nullptr otherwise. any thread */
+		const Table* find(const String&);
+
+		/* source, callback, synchronous
+		imports the source on the background thread, unless find has it already.
+		the callback is called on the message thread, right away if there's nothing to import and this is it.
+		synchronous imports and calls back on the calling thread before returning, f.ex. while rendering offline
+		or in a command line tool, that never runs the message loop. it also does that without a message manager */
+		void load(const String&, Callback&&, bool = false);
+
+	private:
+		struct Data;
+		// jobs keep the data alive, so the library can go before they finish
+		std::shared_ptr<Data> data;
+		juce::ThreadPool thread;
+	};
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include <juce_audio_basics/juce_audio_basics.h>
 #include <array>
+#include "Arena.h"
 
 namespace dsp
 {
@@ -137,6 +138,17 @@ namespace dsp
 				return destGain != gain;
             }
 
+            /* numSamples, moves the gain like synthesizeGainValues would */
+            void skip(int numSamples) noexcept
+            {
+                const auto step = inc * static_cast<double>(numSamples);
+                if (destGain == 1.)
+                    gain = std::min(gain + step, 1.);
+                else
+                    gain = std::max(gain - step, 0.);
+                fading = false;
+            }
+
             void synthesizeGainValues(double* xBuf, int numSamples) noexcept
             {
                 if (!isFading())
@@ -231,7 +243,7 @@ namespace dsp
 
         void prepare(double sampleRate, double lengthMs, int blockSize)
         {
-            buffer.setSize(3 * NumTracks, blockSize, false, true, false);
+            buffer.setSize(3 * NumTracks, blockSize);
             const auto inc = msInInc(lengthMs, sampleRate);
             for (auto& track : tracks)
             {
@@ -277,8 +289,16 @@ namespace dsp
 			return tracks[idx].gain != 1.;
         }
 
+        /* numSamples, advances the crossfade of all enabled tracks */
+        void skip(int numSamples) noexcept
+        {
+            for (auto& track : tracks)
+                if (track.isEnabled())
+                    track.skip(numSamples);
+        }
+
     protected:
-		AudioBuffer buffer;
+		ScratchBuffer<double> buffer;
         std::array<Track, NumTracks> tracks;
     public:
         int idx;
@@ -0,0 +1,109 @@
+#pragma once
+#include <JuceHeader.h>
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace gui
+{
+    /*
+    process-wide cache of the images from BinaryData.
+    every image is decoded once and scaled once per target size, of which only the last few are kept per image,
+    mouse cursors are made once per colour.
+    editors hold it with a juce::SharedResourcePointer, so it lives as long as any editor does.
+    */
+    struct ImageResources
+    {
+        // sizes kept per image. enough for a few editors of different sizes, resizing replaces the oldest
+        static constexpr size_t NumSizes = 4;
+
+        using Image = juce::Image;
+        using MouseCursor = juce::MouseCursor;
+        using Colour = juce::Colour;
+        using CursorKey = std::tuple<std::intptr_t, juce::uint32, int>;
+
+        ImageResources() :
+            decoded(),
+            scaled(),
+            cursors(),
+            useCount(0)
+        {}
+
+        /* data, size */
+        Image get(const void* data, int size)
+        {
+            const auto key = reinterpret_cast<std::intptr_t>(data);
+            const auto it = decoded.find(key);
+            if (it != decoded.end())
+                return it->second;
+            auto img = juce::ImageFileFormat::loadFrom(data, static_cast<size_t>(size));
+            decoded[key] = img;
+            return img;
+        }
+
+        /* src, width, height in physical pixels */
+        Image getScaled(const Image& src, int width, int height)
+        {
+            if (!src.isValid() || width < 1 || height < 1)
+                return {};
+            if (src.getWidth() == width && src.getHeight() == height)
+                return src;
+
+            auto& sizes = scaled[reinterpret_cast<std::intptr_t>(src.getPixelData())];
+            ++useCount;
+            for (auto& size : sizes)
+                if (size.width == width && size.height == height)
+                {
+                    size.lastUsed = useCount;
+                    return size.img;
+                }
+
+            Scaled size{ src, src.rescaled(width, height, juce::Graphics::lowResamplingQuality), width, height, useCount };
+            if (sizes.size() < NumSizes)
+                sizes.push_back(size);
+            else
+                *std::min_element(sizes.begin(), sizes.end(), [](const Scaled& a, const Scaled& b)
+                {
+                    return a.lastUsed < b.lastUsed;
+                }) = size;
+            return size.img;
+        }
+
+        /* data, size, colour to replace, replacement colour, scale
+        tints and scales a cursor image the first time it's asked for */
+        MouseCursor getCursor(const void* data, int size, Colour tintOf, Colour col, int scale)
+        {
+            const CursorKey key{ reinterpret_cast<std::intptr_t>(data), col.getARGB(), scale };
+            const auto it = cursors.find(key);
+            if (it != cursors.end())
+                return it->second;
+
+            auto img = juce::SoftwareImageType().convert(get(data, size).createCopy());
+            for (auto y = 0; y < img.getHeight(); ++y)
+                for (auto x = 0; x < img.getWidth(); ++x)
+                    if (img.getPixelAt(x, y) == tintOf)
+                        img.setPixelAt(x, y, col);
+            img = img.rescaled(img.getWidth() * scale, img.getHeight() * scale, juce::Graphics::lowResamplingQuality);
+
+            MouseCursor cursor(img, 0, 0);
+            cursors.emplace(key, cursor);
+            return cursor;
+        }
+
+    private:
+        struct Scaled
+        {
+            // kept alive, so its pixel data can't be replaced by another image's
+            Image src, img;
+            int width, height;
+            juce::uint64 lastUsed;
+        };
+
+        std::map<std::intptr_t, Image> decoded;
+        std::map<std::intptr_t, std::vector<Scaled>> scaled;
+        std::map<CursorKey, MouseCursor> cursors;
+        juce::uint64 useCount;
+    };
+}
@@ -369,23 +369,28 @@ namespace modSys6
 			const auto maxValuesF = static_cast<float>(numValues) - .5f;
 			const auto maxValuesInv = 1.f / maxValuesF;
 
+			// the lambdas share one table instead of copying it with every copy of the range
+			const auto tablePtr = std::make_shared<const std::vector<float>>(std::move(table));
+
 			Range range
 			{
-				table.front(), table.back(),
-				[table, maxValuesF](float, float, float normalized)
+				tablePtr->front(), tablePtr->back(),
+				[tablePtr, maxValuesF](float, float, float normalized)
 				{
 					const auto valueIdx = normalized * maxValuesF;
-					return table[static_cast<int>(valueIdx)];
+					return (*tablePtr)[static_cast<int>(valueIdx)];
 				},
-				[table, maxValuesInv](float, float, float denormalized)
+				[tablePtr, maxValuesInv](float, float, float denormalized)
 				{
+					const auto& table = *tablePtr;
 					for (auto i = 0; i < table.size(); ++i)
 						if (denormalized <= table[i])
 							return static_cast<float>(i) * maxValuesInv;
 					return 0.f;
 				},
-				[table](float start, float end, float denormalized)
+				[tablePtr](float start, float end, float denormalized)
 				{
+					const auto& table = *tablePtr;
 					auto closest = table.front();
 					for (auto i = 0; i < table.size(); ++i)
 					{
@@ -440,23 +445,28 @@ namespace modSys6
 			const auto maxValueF = static_cast<float>(numValues) - .5f;
 			const auto maxValueInv = 1.f / maxValueF;
 
+			// the lambdas share one table instead of copying it with every copy of the range
+			const auto tablePtr = std::make_shared<const std::vector<float>>(std::move(table));
+
 			Range range
 			{
-				table.front(), table.back(),
-				[table, maxValueF](float, float, float normalized)
+				tablePtr->front(), tablePtr->back(),
+				[tablePtr, maxValueF](float, float, float normalized)
 				{
 					const auto valueIdx = normalized * maxValueF;
-					return table[static_cast<int>(valueIdx)];
+					return (*tablePtr)[static_cast<int>(valueIdx)];
 				},
-				[table, maxValueInv](float, float, float denormalized)
+				[tablePtr, maxValueInv](float, float, float denormalized)
 				{
+					const auto& table = *tablePtr;
 					for (auto i = 0; i < table.size(); ++i)
 						if (denormalized <= table[i])
 							return static_cast<float>(i) * maxValueInv;
 					return 0.f;
 				},
-				[table](float start, float end, float denormalized)
+				[tablePtr](float start, float end, float denormalized)
 				{
+					const auto& table = *tablePtr;
 					auto closest = table.front();
 					for (auto i = 0; i < table.size(); ++i)
 					{
@@ -545,6 +555,8 @@ namespace modSys6
 			unit(_unit),
 			valNormSum(0.f),
 			locked(false),
+			generation(0),
+			dirty(nullptr),
 			valMod(0.f)
 		{
 		}
@@ -563,14 +575,17 @@ namespace modSys6
 			}
 		}
 
-		void loadPatch(ValueTree& state)
+		/* returns true if the host has to be notified about the new value */
+		bool loadPatch(ValueTree& state)
 		{
 			if (locked.load())
-				return;
+				return false;
 
 			auto nVal = static_cast<float>(state.getProperty(stateID::value(), valDenormDefault));
 			nVal = range.convertTo0to1(range.snapToLegalValue(nVal));
-			setValueNotifyingHost(nVal);
+			const bool valChanged = nVal != valNorm.load();
+			if (valChanged)
+				setValue(nVal);
 
 			for (auto i = 0; i < NumMacros; ++i)
 			{
@@ -580,6 +595,9 @@ namespace modSys6
 				const auto mb = static_cast<float>(state.getProperty(stateID::modBias(i), .5f));
 				modBias[i].store(mb);
 			}
+			markDirty();
+
+			return valChanged;
 		}
 
 		float getValue() const override
@@ -598,6 +616,20 @@ namespace modSys6
 				return;
 			
 			valNorm.store(normalized);
+			markDirty();
+		}
+
+		// tells the gui that something it displays of this parameter changed
+		void bumpGeneration() noexcept
+		{
+			generation.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void markDirty() noexcept
+		{
+			bumpGeneration();
+			if (dirty != nullptr)
+				dirty->store(true);
 		}
 		
 		void setValueWithGesture(float norm)
@@ -670,7 +702,11 @@ namespace modSys6
 
 		void modulateEnd() noexcept
 		{
-			valNormSum.store(juce::jlimit(0.f, 1.f, valMod));
+			const auto sum = juce::jlimit(0.f, 1.f, valMod);
+			if (valNormSum.load() == sum)
+				return;
+			valNormSum.store(sum);
+			bumpGeneration();
 		}
 
 		float getValueSum() const noexcept
@@ -683,6 +719,19 @@ namespace modSys6
 			return range.snapToLegalValue(range.convertFrom0to1(valNormSum.load()));
 		}
 
+		// highest normalized value the macros can push this parameter to
+		float getValueMax() const noexcept
+		{
+			auto v = valNorm.load();
+			for (auto i = 0; i < NumMacros; ++i)
+			{
+				const auto md = modDepth[i].load();
+				if (md > 0.f)
+					v += md;
+			}
+			return juce::jlimit(0.f, 1.f, v);
+		}
+
 		String getDescription()
 		{
 			auto v = getValue();
@@ -699,6 +748,7 @@ namespace modSys6
 
 			b = juce::jlimit(BiasEps, 1.f - BiasEps, b);
 			modBias[mIdx].store(b);
+			markDirty();
 		}
 
 		/* start, end, bias[0,1], x */
@@ -740,6 +790,9 @@ namespace modSys6
 		Unit unit;
 		std::atomic<float> valNormSum;
 		std::atomic<bool> locked;
+		std::atomic<unsigned int> generation;
+		// owned by Params, set whenever the patch differs from the last saved state
+		std::atomic<bool>* dirty;
 		float valMod;
 	};
 
@@ -758,6 +811,7 @@ namespace modSys6
 
 		Params(juce::AudioProcessor& audioProcessor) :
 			state("state"),
+			dirty(true),
 			params()
 		{
 			const ValToStrFunc valToStrPercent = [](float v)
@@ -1221,7 +1275,10 @@ namespace modSys6
 			params.push_back(new Param(PID::BufferSize, makeRange::bufferSizes({1.f, 4.f, 12.f, 24.f, 69.f, 420.f, 2000.f}), 4.f, valToStrBufferSize, strToValBufferSize));
 
 			for (auto param : params)
+			{
+				param->dirty = &dirty;
 				audioProcessor.addParameter(param);
+			}
 		}
 		
 		void loadPatch()
@@ -1230,13 +1287,22 @@ namespace modSys6
 			if (!childParams.isValid())
 				return;
 
-			for (auto param : params)
+			std::array<bool, NumParams> changed;
+			changed.fill(false);
+			for (auto p = 0; p < params.size(); ++p)
 			{
+				auto param = params[p];
 				const auto id = param->getID();
 				auto childParam = childParams.getChildWithName(id);
 				if(childParam.isValid())
-					param->loadPatch(childParam);
+					changed[p] = param->loadPatch(childParam);
 			}
+
+			// notify the host in one go after the whole patch is in place,
+			// and only about the values that actually changed
+			for (auto p = 0; p < params.size(); ++p)
+				if (changed[p])
+					params[p]->sendValueChangedMessageToListeners(params[p]->getValue());
 		}
 		
 		void savePatch()
@@ -1285,6 +1351,7 @@ namespace modSys6
 			}
 
 			paramDest.modDepth[mIdx].store(md);
+			paramDest.markDirty();
 		}
 
 		void updatePatch(const ValueTree& other)
@@ -1364,6 +1431,7 @@ namespace modSys6
 		}
 
 		ValueTree state;
+		std::atomic<bool> dirty;
 	protected:
 		std::vector<Param*> params;
 	};
@@ -2,6 +2,9 @@
 #include "../PluginProcessor.h"
 #include "../NELG.h"
 #include "ModSys.h"
+#include "../presets/PresetIndex.h"
+#include "RenderCache.h"
+#include "ImageResources.h"
 #include <array>
 #include <cstdint>
 #include "../FormulaParser.h"
@@ -492,30 +495,20 @@ namespace gui
 
     inline void makeCursor(Component& c, CursorType t)
     {
-        juce::Image img;
-        if (t == CursorType::Cross)
-            img = juce::ImageCache::getFromMemory(BinaryData::cursorCross_png, BinaryData::cursorCross_pngSize).createCopy();
-        else
-            img = juce::ImageCache::getFromMemory(BinaryData::cursor_png, BinaryData::cursor_pngSize).createCopy();
-        img = juce::SoftwareImageType().convert(img);
-        {
-            const Colour imgCol(0xff37946e);
-            const auto col = t == CursorType::Default ?
-                Shared::shared.colour(gui::ColourID::Txt) :
-                t == CursorType::Mod ?
-                    Shared::shared.colour(gui::ColourID::Mod) :
-                    Shared::shared.colour(gui::ColourID::Interact);
-            for (auto y = 0; y < img.getHeight(); ++y)
-                for (auto x = 0; x < img.getWidth(); ++x)
-                    if (img.getPixelAt(x, y) == imgCol)
-                        img.setPixelAt(x, y, col);
-        }
+        const Colour imgCol(0xff37946e);
+        const auto col = t == CursorType::Default ?
+            Shared::shared.colour(gui::ColourID::Txt) :
+            t == CursorType::Mod ?
+                Shared::shared.colour(gui::ColourID::Mod) :
+                Shared::shared.colour(gui::ColourID::Interact);
 
         static constexpr int scale = 3;
-        img = img.rescaled(img.getWidth() * scale, img.getHeight() * scale, Graphics::ResamplingQuality::lowResamplingQuality);
 
-        juce::MouseCursor cursor(img, 0, 0);
-        c.setMouseCursor(cursor);
+        juce::SharedResourcePointer<ImageResources> resources;
+        if (t == CursorType::Cross)
+            c.setMouseCursor(resources->getCursor(BinaryData::cursorCross_png, BinaryData::cursorCross_pngSize, imgCol, col, scale));
+        else
+            c.setMouseCursor(resources->getCursor(BinaryData::cursor_png, BinaryData::cursor_pngSize, imgCol, col, scale));
     }
 
     struct Utils
@@ -526,6 +519,8 @@ namespace gui
             pluginTop(_pluginTop),
             audioProcessor(_processor),
             thicc(1.f), dragSpeed(1.f),
+            renderCache(),
+            imageResources(),
             tooltip(&Shared::shared.tooltipDefault),
             selectedMod(0),
             notify(events)
@@ -546,10 +541,21 @@ namespace gui
             
         void updatePatch(const ValueTree& state)
         {
-            audioProcessor.suspendProcessing(true);
-            audioProcessor.params.updatePatch(state);
-            audioProcessor.loadPatch();
-            audioProcessor.forcePrepare();
+            // glides to the preset while the audio keeps running. if its engine configuration differs, the rebuild drops out briefly
+            audioProcessor.switchPreset(state);
+        }
+
+        /* a, b. morphs between two patches, starting at a. see setPatchMorph */
+        void morphPatches(const ValueTree& a, const ValueTree& b)
+        {
+            audioProcessor.setPresetMorph(0.f);
+            audioProcessor.morphPresets(a, b);
+        }
+
+        /* x[0,1], 0 is a, 1 is b */
+        void setPatchMorph(float x) noexcept
+        {
+            audioProcessor.setPresetMorph(x);
         }
 
         void selectMod(int i) noexcept
@@ -663,12 +669,52 @@ namespace gui
         Component& pluginTop;
         Nel19AudioProcessor& audioProcessor;
         float thicc, dragSpeed;
+        RenderCache renderCache;
+        // keeps the image cache alive while this editor exists
+        juce::SharedResourcePointer<ImageResources> imageResources;
     protected:
         String* tooltip;
         int selectedMod;
         Events::Evt notify;
     };
 
+    /* what a component displayed last of a generation counter, see modSys6::Param::generation.
+    updateTimer returns early unless the generations it depends on moved */
+    struct GenerationGate
+    {
+        GenerationGate() :
+            last(0),
+            valid(false)
+        {}
+
+        /* gen, returns true once for every new generation */
+        bool operator()(unsigned int gen) noexcept
+        {
+            if (valid && gen == last)
+                return false;
+            last = gen;
+            valid = true;
+            return true;
+        }
+
+        /* the next call passes, whatever the generation is */
+        void invalidate() noexcept
+        {
+            valid = false;
+        }
+
+    private:
+        unsigned int last;
+        bool valid;
+    };
+
+    /* params, the sum of their generations. it moves whenever any of them does */
+    template<typename... Params>
+    inline unsigned int sumGenerations(const Params&... params) noexcept
+    {
+        return (0u + ... + params.generation.load(std::memory_order_relaxed));
+    }
+
     struct Comp :
         public Component
     {
@@ -761,14 +807,15 @@ namespace gui
         {
             return [c = comp](int type, const void*)
             {
+                // every comp listens for itself, so repainting the children too would be redundant
                 if (type == NotificationType::ColourChanged)
                 {
                     c->setMouseCursor();
-                    repaintWithChildren(c);
+                    c->repaint();
                 }
                 if (type == NotificationType::PatchUpdated)
                 {
-                    repaintWithChildren(c);
+                    c->repaint();
                 }
                 return false;
             };
@@ -839,26 +886,44 @@ namespace gui
     {
         ImageComp(Utils& u, String&& _tooltip, Image&& _img) :
             Comp(u, std::move(_tooltip), CursorType::Default),
-            img(_img)
+            img(_img),
+            imgScaled(),
+            scaledWidth(0),
+            scaledScale(0.f)
         {}
             
         ImageComp(Utils& u, String&& _tooltip, const char* data, const int size) :
             Comp(u, std::move(_tooltip), CursorType::Default),
-            img(juce::ImageCache::getFromMemory(data, size))
+            img(u.imageResources->get(data, size)),
+            imgScaled(),
+            scaledWidth(0),
+            scaledScale(0.f)
         {}
             
         Image img;
             
         void paint(Graphics& g) override
         {
-            const auto q = Graphics::lowResamplingQuality;
             const auto thicc = utils.thicc;
             const auto bounds = maxQuadIn(getBounds().toFloat()).reduced(thicc);
+            const auto w = static_cast<int>(bounds.getWidth());
+            const auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+            // only asks the cache again if the size or the display scale changed
+            if (w != scaledWidth || scale != scaledScale)
             {
-                const auto w = static_cast<int>(bounds.getWidth());
-                g.drawImageAt(img.rescaled(w, w, q), 0, 0, false);
+                const auto wPhysical = static_cast<int>(std::round(static_cast<float>(w) * scale));
+                imgScaled = utils.imageResources->getScaled(img, wPhysical, wPhysical);
+                scaledWidth = w;
+                scaledScale = scale;
             }
+            if (imgScaled.isValid())
+                g.drawImage(imgScaled, BoundsF(0.f, 0.f, static_cast<float>(w), static_cast<float>(w)));
         }
+
+    protected:
+        Image imgScaled;
+        int scaledWidth;
+        float scaledScale;
     };
     
     inline float getFontHeight(Comp* comp, const Font& font,
@@ -1712,6 +1777,7 @@ namespace gui
             auto& param = btn.utils.getParam(pID);
             auto state = !param.locked.load();
             param.locked.store(state);
+            param.bumpGeneration();
             btn.setState(state ? 1 : 0);
         };
     }
@@ -1859,6 +1925,7 @@ namespace gui
 
                 depth = juce::jlimit(-1.f, 1.f, prm.modDepth[mIdx].load() + dragY);
                 prm.modDepth[mIdx].store(depth);
+                prm.markDirty();
                 depth = prm.modDepth[mIdx].load();
                 notify(NotificationType::ModDialDragged, &paramtr.param.id);
             }
@@ -1889,11 +1956,13 @@ namespace gui
                 {
                     p.modDial.updateDepth();
                     p.modDial.repaint();
+                    p.invalidate();
                 }
                 if (t == NotificationType::ModDraggerDragged)
                 {
 					p.modDial.updateDepth();
 					p.modDial.repaint();
+                    p.invalidate();
                 }
                 return false;
             };
@@ -1912,7 +1981,8 @@ namespace gui
             lockr(u, toString(getPID())),
             attachedModSelected(u.getSelectedMod() == param.attachedMod),
             valNorm(0.f), valSum(0.f), modDepth(0.f),
-            dragY(0.f)
+            dragY(0.f),
+            generation()
         {
             init(modulatables);
         }
@@ -1922,10 +1992,17 @@ namespace gui
             return param.id;
         }
             
+        // forces a refresh on the next frame, f.ex. when the selected modulator changed
+        void invalidate() noexcept
+        {
+            generation.invalidate();
+        }
+
+        /* only does work if the parameter's generation moved since the last frame */
         void updateTimer() override
         {
-            modDial.updateTimer();
-            lockr.updateTimer();
+            if (!generation(param.generation.load(std::memory_order_relaxed)))
+                return;
 
             const auto locked = param.locked.load();
             const auto nAlpha = locked ? LockAlpha : 1.f;
@@ -1948,6 +2025,7 @@ namespace gui
         Button lockr;
         bool attachedModSelected;
         float valNorm, valSum, modDepth, modBias, dragY;
+        GenerationGate generation;
 
         void init(std::vector<Paramtr*>& modulatables)
         {
@@ -2013,6 +2091,33 @@ namespace gui
             }
         }
             
+        /* the static part of a knob, it's cached by the render cache */
+        static void paintKnobOutline(Graphics& g, PointF centre, float radius, float radiusInner,
+            const Stroke& strokeType, Colour col)
+        {
+            g.setColour(col);
+            Path outtaArc;
+
+            outtaArc.addCentredArc
+            (
+                centre.x, centre.y,
+                radius, radius,
+                0.f,
+                -AngleWidth, AngleWidth,
+                true
+            );
+            outtaArc.addCentredArc
+            (
+                centre.x, centre.y,
+                radiusInner, radiusInner,
+                0.f,
+                -AngleWidth, AngleWidth,
+                true
+            );
+
+            g.strokePath(outtaArc, strokeType);
+        }
+
         void paintKnob(Graphics& g)
         {
             const auto thicc = utils.thicc;
@@ -2030,27 +2135,32 @@ namespace gui
 
             //draw outline
             {
-                g.setColour(Shared::shared.colour(ColourID::Interact));
-                Path outtaArc;
+                const auto col = Shared::shared.colour(ColourID::Interact);
+                const auto scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+                const auto radiusImg = radius + thicc;
+                const auto sizeImg = static_cast<int>(std::ceil(radiusImg * 2.f * scale));
 
-                outtaArc.addCentredArc
-                (
-                    centre.x, centre.y,
-                    radius, radius,
-                    0.f,
-                    -AngleWidth, AngleWidth,
-                    true
-                );
-                outtaArc.addCentredArc
-                (
-                    centre.x, centre.y,
-                    radiusInner, radiusInner,
-                    0.f,
-                    -AngleWidth, AngleWidth,
-                    true
-                );
+                auto key = hashCombine(static_cast<juce::int64>(RenderKey::Knob), radius);
+                key = hashCombine(key, thicc);
+                key = hashCombine(key, scale);
+                key = hashCombine(key, col);
 
-                g.strokePath(outtaArc, strokeType);
+                const auto img = utils.renderCache.find(key);
+                if (img.isValid())
+                {
+                    const auto sizeImgF = static_cast<float>(sizeImg) / scale;
+                    const BoundsF boundsImg(centre.x - radiusImg, centre.y - radiusImg, sizeImgF, sizeImgF);
+                    g.drawImage(img, boundsImg, juce::RectanglePlacement::stretchToFit);
+                }
+                else
+                {
+                    utils.renderCache.render(key, sizeImg, sizeImg, [radiusImg, radius, radiusInner, strokeType, scale, col](Graphics& gImg)
+                    {
+                        gImg.addTransform(juce::AffineTransform::scale(scale));
+                        paintKnobOutline(gImg, { radiusImg, radiusImg }, radius, radiusInner, strokeType, col);
+                    }, *this);
+                    paintKnobOutline(g, centre, radius, radiusInner, strokeType, col);
+                }
             }
 
             const auto valNormAngle = valNorm * AngleRange;
@@ -2684,13 +2794,13 @@ namespace gui
             label.setBounds(getLocalBounds());
         }
 
+        /* counts down while the popup shows, does nothing once it's hidden */
         void updateTimer() override
         {
-            if (freezeIdx > FreezeTime)
-            {
-                label.setVisible(false);
+            if (!label.isVisible())
                 return;
-            }
+            if (freezeIdx > FreezeTime)
+                return label.setVisible(false);
             ++freezeIdx;
         }
 
@@ -3274,6 +3384,8 @@ namespace gui
 
             onPaint([](Graphics&, Visualizer&){}),
             onUpdate([](Buffer&) { return false; }),
+            getGeneration(nullptr),
+            generation(),
 
             buffer(),
             numChannels(_numChannels == 1 ? 1 : 2),
@@ -3285,6 +3397,9 @@ namespace gui
 
         std::function<void(Graphics&, Visualizer&)> onPaint;
         std::function<bool(Buffer&)> onUpdate;
+        // what onUpdate reads from, f.ex. dsp::Telemetry::getGeneration. without it onUpdate runs every frame
+        std::function<unsigned int()> getGeneration;
+        GenerationGate generation;
 
         Buffer buffer;
         const int numChannels, blockSize;
@@ -3296,6 +3411,8 @@ namespace gui
 
         void updateTimer() override
         {
+            if (getGeneration != nullptr && !generation(getGeneration()))
+                return;
             if (onUpdate(buffer))
                 repaint();
         }
@@ -3306,14 +3423,21 @@ namespace gui
     {
         using OnChange = std::function<void(float)>;
 
-        ScrollBar(Utils& u) :
-            Comp(u, "Drag or mousewheel this to scroll."),
+        ScrollBar(Utils& u, String&& _tooltip = "Drag or mousewheel this to scroll.") :
+            Comp(u, std::move(_tooltip)),
             onChange(),
             posY(0.f),
             dragY(0.f)
         {
             setBufferedToImage(false);
         }
+
+        /* y[0,1], without calling onChange */
+        void setPosY(float y)
+        {
+            posY = juce::jlimit(0.f, 1.f, y);
+            repaint();
+        }
             
         OnChange onChange;
     protected:
@@ -3524,39 +3648,70 @@ namespace gui
         int yOffset;
     };
 
+    /* the results are a virtualised list, that only paints the rows in view.
+    the index behind it is shared by all instances of the plugin */
     struct PresetBrowser :
-        public Comp
+        public Comp,
+        public juce::ListBoxModel,
+        public juce::ChangeListener
     {
         using SaveFunc = std::function<juce::ValueTree()>;
 		using LoadFunc = std::function<void(const juce::ValueTree&)>;
+        using MorphFunc = std::function<void(const juce::ValueTree&)>;
+        using OnMorph = std::function<void(float)>;
 
         PresetBrowser(Utils& u, const String& _extension, const String& subDirectory) :
             Comp(u, "", CursorType::Default),
             saveFunc(nullptr),
             loadFunc(nullptr),
+            morphFunc(nullptr),
+            onMorph(nullptr),
             //
             openCloseButton(u, "Click here to open or close the preset browser."),
             saveButton(u, "Click here to manifest the current preset into the browser."),
             pathButton(u, "This button will show you where your files are stored."),
-            browser(u),
+            list("presets", this),
+            morphBar(u, "Drag this to morph from the current patch (top) to the shift-clicked preset (bottom)."),
             presetNameEditor("Enter Name.."),
+            searchEditor("Search.."),
             //
             directory(u.audioProcessor.appProperties.getUserSettings()->getFile().getParentDirectory().getChildFile(subDirectory)),
             extension(_extension),
-            //
-            timerIdx(0),
-            timerRunning(false)
+            indices(),
+            index(indices->get(directory, extension)),
+            results(),
+            hoveredRow(-1)
         {
             if (!directory.exists())
                 directory.createDirectory();
             
             setInterceptsMouseClicks(false, true);
             setBufferedToImage(false);
-            addChildComponent(browser);
+            list.setRowHeight(Browser::MinEntryHeight);
+            list.setOutlineThickness(0);
+            list.setColour(juce::ListBox::backgroundColourId, juce::Colours::transparentBlack);
+            list.addMouseListener(this, true);
+            addChildComponent(list);
+            addChildComponent(morphBar);
+            morphBar.onChange = [&](float x)
+            {
+                if (onMorph != nullptr)
+                    onMorph(x);
+            };
             addChildComponent(presetNameEditor);
+            addChildComponent(searchEditor);
             addChildComponent(saveButton);
             addChildComponent(pathButton);
 
+            presetNameEditor.setTextToShowWhenEmpty("name #tag", Shared::shared.colour(ColourID::Hover));
+            searchEditor.setTextToShowWhenEmpty("search..", Shared::shared.colour(ColourID::Hover));
+            searchEditor.onTextChange = [&]()
+            {
+                refreshBrowser();
+            };
+
+            index.addChangeListener(this);
+
             openCloseButton.onPaint = makeButtonOnPaintBrowse();
             openCloseButton.onClick = [&]()
             {
@@ -3573,25 +3728,33 @@ namespace gui
             saveButton.onPaint = makeButtonOnPaintSave();
             saveButton.onClick = [&]()
             {
-                // save preset to list of presets
-                auto pName = presetNameEditor.getText();
+                // save preset to list of presets, words starting with # become tags
+                const auto tokens = juce::StringArray::fromTokens(presetNameEditor.getText(), true);
+                juce::StringArray nameTokens, tags;
+                for (const auto& token : tokens)
+                    if (token.startsWithChar('#'))
+                        tags.addIfNotAlreadyThere(token.substring(1));
+                    else
+                        nameTokens.add(token);
+                auto pName = nameTokens.joinIntoString(" ");
                 if (pName.isEmpty())
                     return;
                 if (!pName.endsWith(extension))
                     pName += extension;
                 auto pFile = directory.getChildFile(pName);
-                if (pFile.exists())
-                    pFile.deleteFile();
-                const auto state = saveFunc();
-                pFile.appendText
-                (
-                    state.toXmlString(),
-                    false,
-                    false
-                );
-                refreshBrowser();
+                auto state = saveFunc().createCopy();
+                state.setProperty("tags", tags.joinIntoString(","), nullptr);
+                pFile.replaceWithText(state.toXmlString(), false, false);
+                index.update(pFile, state);
             };
         }
+
+        ~PresetBrowser()
+        {
+            index.removeChangeListener(this);
+            if (list.isVisible())
+                index.stop();
+        }
         
         void init(Component& c)
         {
@@ -3609,52 +3772,136 @@ namespace gui
             return openCloseButton;
         }
 
-        void updateTimer() override
-        {
-            if (!timerRunning)
-                return;
-
-            ++timerIdx;
-            if (timerIdx < 15)
-                return;
-
-            timerIdx = 0;
-            
-            const auto numFiles = directory.getNumberOfChildFiles
-            (
-                File::TypesOfFileToFind::findFiles,
-                "*" + extension
-            );
-            if (numFiles != browser.getNumEntries())
-                refreshBrowser();
-        }
-
         SaveFunc saveFunc;
         LoadFunc loadFunc;
+        // shift-click, morphs from the current patch to the preset. onMorph moves between them
+        MorphFunc morphFunc;
+        OnMorph onMorph;
     protected:
         Button openCloseButton, saveButton, pathButton;
-        Browser browser;
-        juce::TextEditor presetNameEditor;
+        juce::ListBox list;
+        ScrollBar morphBar;
+        juce::TextEditor presetNameEditor, searchEditor;
         
         const File directory;
         String extension;
-        int timerIdx;
-        bool timerRunning;
+        juce::SharedResourcePointer<presets::Indices> indices;
+        presets::Index& index;
+        presets::Entries results;
+        int hoveredRow;
 
         void setBrowserOpen(bool e)
         {
-            browser.setVisible(e);
+            list.setVisible(e);
             presetNameEditor.setVisible(e);
+            searchEditor.setVisible(e);
             saveButton.setVisible(e);
             pathButton.setVisible(e);
             if (e)
-                initBrowser();
+            {
+                // the index watches the directory while the browser is open
+                refreshBrowser();
+                index.start();
+            }
             else
-                browser.clearEntries();
-            timerRunning = e;
+            {
+                index.stop();
+                morphBar.setVisible(false);
+                results.clear();
+                list.updateContent();
+            }
         }
     private:
-        void paint(Graphics&) override {}
+        void paint(Graphics& g) override
+        {
+            if (!list.isVisible())
+                return;
+            const auto bounds = list.getBounds().toFloat();
+            g.setColour(Shared::shared.colour(ColourID::Darken));
+            g.fillRoundedRectangle(bounds, utils.thicc);
+            if (!results.empty())
+                return;
+            g.setColour(Shared::shared.colour(ColourID::Abort));
+            g.setFont(Shared::shared.font);
+            g.drawFittedText("Browser empty.", bounds.toNearestInt(), Just::centred, 1);
+        }
+
+        int getNumRows() override
+        {
+            return static_cast<int>(results.size());
+        }
+
+        void paintListBoxItem(int row, Graphics& g, int w, int h, bool) override
+        {
+            if (row < 0 || row >= getNumRows())
+                return;
+            const auto thicc = utils.thicc;
+            const auto bounds = BoundsF(0.f, 0.f, static_cast<float>(w), static_cast<float>(h)).reduced(thicc);
+            g.setColour(Shared::shared.colour(ColourID::Bg));
+            g.fillRoundedRectangle(bounds, thicc);
+            if (row == hoveredRow)
+            {
+                g.setColour(Shared::shared.colour(ColourID::Hover));
+                g.fillRoundedRectangle(bounds, thicc);
+            }
+            g.setColour(Shared::shared.colour(ColourID::Interact));
+            visualizeGroup(g, bounds, thicc);
+            g.setFont(Shared::shared.font);
+            g.drawFittedText(results[row].name, bounds.toNearestInt(), Just::left, 1);
+        }
+
+        void listBoxItemClicked(int row, const Mouse& evt) override
+        {
+            if (row < 0 || row >= getNumRows())
+                return;
+            // presets are only parsed completely when they are chosen
+            const auto xml = juce::parseXML(results[row].file);
+            if (xml == nullptr)
+                return;
+            const auto morphing = evt.mods.isShiftDown() && morphFunc != nullptr;
+            morphBar.setVisible(morphing);
+            if (!morphing)
+                return loadFunc(ValueTree::fromXml(*xml));
+            morphBar.setPosY(0.f);
+            morphFunc(ValueTree::fromXml(*xml));
+        }
+
+        void changeListenerCallback(juce::ChangeBroadcaster*) override
+        {
+            if (list.isVisible())
+                refreshBrowser();
+        }
+
+        /* the rows of the list report their mouse here, so that the hovered row shows its tooltip */
+        void mouseMove(const Mouse& evt) override
+        {
+            const auto e = evt.getEventRelativeTo(&list);
+            setHoveredRow(list.getRowContainingPosition(e.x, e.y));
+        }
+
+        void mouseExit(const Mouse&) override
+        {
+            setHoveredRow(-1);
+        }
+
+        void setHoveredRow(int row)
+        {
+            if (row >= getNumRows())
+                row = -1;
+            if (hoveredRow == row)
+                return;
+            list.repaintRow(hoveredRow);
+            list.repaintRow(row);
+            hoveredRow = row;
+            if (row == -1)
+                return;
+            const auto& entry = results[row];
+            tooltip = "Click here to choose this preset. (" + entry.modTypes.joinIntoString(", ") + ")";
+            if (!entry.tags.isEmpty())
+                tooltip += " #" + entry.tags.joinIntoString(" #");
+            utils.setTooltip(&tooltip);
+            notify(NotificationType::TooltipUpdated);
+        }
         
         void resized() override
         {
@@ -3664,9 +3911,11 @@ namespace gui
             {
                 auto x = bounds.getX();
                 auto y = bounds.getY();
-                auto w = presetNameWidth;
+                auto w = presetNameWidth * .5f;
                 auto h = titleHeight;
                 presetNameEditor.setBounds(BoundsF(x, y, w, h).toNearestInt());
+                x += w;
+                searchEditor.setBounds(BoundsF(x, y, w, h).toNearestInt());
             }
             {
                 auto x = presetNameWidth;
@@ -3682,45 +3931,20 @@ namespace gui
                 auto y = titleHeight;
                 auto w = bounds.getWidth();
                 auto h = bounds.getHeight() - titleHeight;
-                browser.setBounds(BoundsF(x, y, w, h).toNearestInt());
-            }
-        }
-        
-        void initBrowser()
-        {
-            const auto fileTypes = File::TypesOfFileToFind::findFiles;
-            const auto wildCard = "*" + extension;
-            const juce::RangedDirectoryIterator files
-            (
-                directory,
-                true,
-                wildCard,
-                fileTypes
-            );
-            
-            for (const auto& it: files)
-            {
-                const auto file = it.getFile();
-                const auto fileName = file.getFileName();
-                const auto nameLen = fileName.length() - extension.length();
-                browser.addEntry
-                (
-                    fileName.substring(0, nameLen),
-                    "Click here to choose this preset.",
-                    [&, str = file.loadFileAsString()]()
-                    {
-						loadFunc(ValueTree::fromXml(str));
-                    },
-                    Just::left
-                );
+                const auto morphW = w * .05f;
+                list.setBounds(BoundsF(x, y, w - morphW, h).reduced(utils.thicc).toNearestInt());
+                morphBar.setBounds(BoundsF(x + w - morphW, y, morphW, h).toNearestInt());
             }
         }
 
+        /* a keystroke only swaps the results, the list repaints the rows in view */
         void refreshBrowser()
         {
-            browser.clearEntries();
-            initBrowser();
-            resized();
+            results = index.search(searchEditor.getText());
+            hoveredRow = -1;
+            list.updateContent();
+            list.repaint();
+            repaint();
         }
     };
     
@@ -3796,7 +4020,26 @@ namespace gui
                     g.drawRoundedRectangle(x0, y, x1 - x0 + w, h, thicc, thicc);
                 }
             }
-                
+            // the history scrolls down from the newest value at the top
+            if (v.blockSize > 1)
+            {
+                const auto rowH = h / static_cast<float>(v.blockSize - 1);
+                g.setColour(Shared::shared.colour(ColourID::Mod).withMultipliedAlpha(.5f));
+                for (auto ch = 0; ch < v.numChannels; ++ch)
+                {
+                    Path path;
+                    for (auto i = 0; i < v.blockSize; ++i)
+                    {
+                        const auto smpl = juce::jlimit(0., 1., v.buffer[ch][i] * .5 + .5);
+                        const PointF pt(bounds.getX() + static_cast<float>(smpl) * bounds.getWidth(), y + static_cast<float>(i) * rowH);
+                        if (i == 0)
+                            path.startNewSubPath(pt);
+                        else
+                            path.lineTo(pt);
+                    }
+                    g.strokePath(path, Stroke(tickThicc));
+                }
+            }
         };
     }
 }
@@ -3806,9 +4049,6 @@ namespace gui
 browser
     every entry has vector of optional additional buttons (like delete, rename)
 
-presetbrowser
-    tag system for presets
-
 ParamtrRandomizer
     should randomize?
         parameter-modulations
@@ -0,0 +1,322 @@
+#pragma once
+#include "ModSys.h"
+#include <array>
+#include <atomic>
+#include <cstring>
+
+namespace modSys6
+{
+	/*
+	a patch's parameters as flat normalized values, so the audio thread can switch to it without a ValueTree.
+	decoded on any thread but the audio thread.
+	*/
+	struct Snapshot
+	{
+		using Macros = std::array<float, NumMacros>;
+
+		Snapshot() :
+			values(),
+			modDepth(),
+			modBias()
+		{}
+
+		/* params, the values the parameters have right now */
+		void capture(const Params& params) noexcept
+		{
+			for (auto p = 0; p < NumParams; ++p)
+			{
+				const auto& param = params(p);
+				values[p] = param.getValue();
+				for (auto i = 0; i < NumMacros; ++i)
+				{
+					modDepth[p][i] = param.modDepth[i].load();
+					modBias[p][i] = param.modBias[i].load();
+				}
+			}
+		}
+
+		/* params, state, like Params::loadPatch. parameters the state doesn't contain keep their current values */
+		void decode(const Params& params, const ValueTree& state)
+		{
+			capture(params);
+			const auto childParams = state.getChildWithName(stateID::params());
+			if (!childParams.isValid())
+				return;
+
+			for (auto p = 0; p < NumParams; ++p)
+			{
+				const auto& param = params(p);
+				const auto childParam = childParams.getChildWithName(param.getID());
+				if (!childParam.isValid())
+					continue;
+
+				const auto& range = param.range;
+				const auto val = static_cast<float>(childParam.getProperty(stateID::value(), param.valDenormDefault));
+				values[p] = range.convertTo0to1(range.snapToLegalValue(val));
+				for (auto i = 0; i < NumMacros; ++i)
+				{
+					modDepth[p][i] = static_cast<float>(childParam.getProperty(stateID::modDepth(i), 0.f));
+					modBias[p][i] = static_cast<float>(childParam.getProperty(stateID::modBias(i), .5f));
+				}
+			}
+		}
+
+		std::array<float, NumParams> values;
+		std::array<Macros, NumParams> modDepth, modBias;
+	};
+
+	/*
+	glides the parameters from where they are to a snapshot, or morphs them between two snapshots a and b.
+	everything is posted from the message thread and interpolated on the audio thread, before the macros are processed.
+	stepped parameters (toggles, choices, tempo sync rates..) switch halfway, continuous ones glide.
+	a structural switch also changes what the audio thread can't, f.ex. the oversampling or the buffer size.
+	it fades the wet signal out over the first half, holds once the wet chain is quiet until the message thread
+	rebuilt the engine, and fades the new engine in over the second half.
+	the rebuild suspends processing and reallocates, so the host drops out for as long as it takes.
+	only a second engine, prepared off the audio thread and crossfaded with this one, would avoid that.
+	*/
+	struct Morph
+	{
+		// what a switch does with the wet signal
+		enum class Hold { None, Requested, Holding, Released };
+
+		Morph() :
+			mail(),
+			from(),
+			a(),
+			b(),
+			stepped(),
+			mailState(MailEmpty),
+			hold(Hold::None),
+			position(0.f),
+			settled(false),
+			sampleRate(1.),
+			lengthInv(1.f),
+			fade(1.f),
+			pos(0.f),
+			active(false),
+			morphing(false)
+		{}
+
+		/* params, sampleRate. doesn't interrupt a switch in progress, since the engine is rebuilt in the middle of one */
+		void prepare(const Params& params, double _sampleRate) noexcept
+		{
+			sampleRate = _sampleRate;
+			for (auto p = 0; p < NumParams; ++p)
+			{
+				const auto& range = params(p).range;
+				stepped[p] = range.interval > 0.f || range.snapToLegalValueFunction != nullptr;
+			}
+		}
+
+		/* _a, _b, lengthMs, structural. message thread.
+		the parameters glide to a morph between a and b at the current position, see setPosition.
+		for a plain switch a and b are the same */
+		void post(const Snapshot& _a, const Snapshot& _b, double lengthMs, bool structural)
+		{
+			// the audio thread only ever reads the mail, so this waits a few microseconds at most
+			auto state = mailState.load();
+			while (state == MailReading || !mailState.compare_exchange_weak(state, MailWriting))
+			{
+				juce::Thread::yield();
+				state = mailState.load();
+			}
+			mail.a = _a;
+			mail.b = _b;
+			mail.lengthMs = lengthMs;
+			// before the mail can be received, so the audio thread doesn't run ahead of the rebuild
+			if (structural)
+				hold.store(Hold::Requested);
+			else
+			{
+				auto released = Hold::Released;
+				hold.compare_exchange_strong(released, Hold::None);
+			}
+			mailState.store(MailFull, std::memory_order_release);
+		}
+
+		/* x[0,1], 0 is a, 1 is b. any thread */
+		void setPosition(float x) noexcept
+		{
+			position.store(juce::jlimit(0.f, 1.f, x));
+		}
+
+		float getPosition() const noexcept
+		{
+			return position.load();
+		}
+
+		/* true while a structural switch waits for the engine to be rebuilt or is about to */
+		bool isStructural() const noexcept
+		{
+			const auto h = hold.load();
+			return h == Hold::Requested || h == Hold::Holding;
+		}
+
+		/* true once the wet chain is quiet and the message thread may rebuild the engine */
+		bool isHolding() const noexcept
+		{
+			return hold.load() == Hold::Holding;
+		}
+
+		/* message thread, after the engine was rebuilt */
+		void release() noexcept
+		{
+			auto h = Hold::Holding;
+			hold.compare_exchange_strong(h, Hold::Released);
+		}
+
+		/* true while a switch waits for the audio thread */
+		bool isPending() const noexcept
+		{
+			return mailState.load() != MailEmpty || hold.load() == Hold::Requested;
+		}
+
+		/* forgets the switch in progress, while the audio thread is suspended */
+		void reset() noexcept
+		{
+			mailState.store(MailEmpty);
+			hold.store(Hold::None);
+			settled.store(false);
+			fade = 1.f;
+			active = false;
+		}
+
+		/* returns true once after the parameters arrived where they were heading, so the host can be told about them */
+		bool hasSettled() noexcept
+		{
+			return settled.exchange(false);
+		}
+
+		/* params, numSamples, quiet. audio thread. quiet if the wet chain was bypassed in the last block */
+		void operator()(Params& params, int numSamples, bool quiet) noexcept
+		{
+			receive(params);
+			// the position of an a/b morph can move on long after the glide to it ended
+			if (!active && morphing && position.load() != pos)
+				active = true;
+			if (!active)
+				return;
+
+			const auto inc = static_cast<float>(numSamples) * lengthInv;
+			const auto posTarget = position.load();
+			pos = pos < posTarget ? std::min(posTarget, pos + inc) : std::max(posTarget, pos - inc);
+
+			const auto h = hold.load();
+			if (h == Hold::Requested || h == Hold::Holding)
+			{
+				fade = std::min(.5f, fade + inc);
+				auto requested = Hold::Requested;
+				if (fade == .5f && quiet)
+					hold.compare_exchange_strong(requested, Hold::Holding);
+			}
+			else
+				fade = std::min(1.f, fade + inc);
+
+			apply(params);
+
+			if (fade == 1.f && pos == posTarget)
+			{
+				active = false;
+				auto released = Hold::Released;
+				hold.compare_exchange_strong(released, Hold::None);
+				settled.store(true);
+			}
+		}
+
+		/* audio thread, the gain of the wet signal during a structural switch */
+		float getWet() const noexcept
+		{
+			switch (hold.load())
+			{
+			case Hold::Requested:
+			case Hold::Holding: return std::max(0.f, 1.f - 2.f * fade);
+			case Hold::Released: return std::max(0.f, 2.f * fade - 1.f);
+			default: return 1.f;
+			}
+		}
+
+	private:
+		static constexpr int MailEmpty = 0, MailWriting = 1, MailFull = 2, MailReading = 3;
+
+		struct Mail
+		{
+			Snapshot a, b;
+			double lengthMs = 0.;
+		};
+
+		Mail mail;
+		Snapshot from, a, b;
+		std::array<bool, NumParams> stepped;
+		std::atomic<int> mailState;
+		std::atomic<Hold> hold;
+		std::atomic<float> position;
+		std::atomic<bool> settled;
+		double sampleRate;
+		float lengthInv, fade, pos;
+		bool active, morphing;
+
+		void receive(const Params& params) noexcept
+		{
+			auto state = MailFull;
+			if (!mailState.compare_exchange_strong(state, MailReading, std::memory_order_acquire))
+				return;
+			a = mail.a;
+			b = mail.b;
+			const auto lengthSamples = mail.lengthMs * sampleRate * .001;
+			mailState.store(MailEmpty, std::memory_order_release);
+
+			// glides from wherever the parameters are, even if that's the middle of the last glide
+			from.capture(params);
+			lengthInv = lengthSamples > 1. ? static_cast<float>(1. / lengthSamples) : 1.f;
+			fade = 0.f;
+			pos = position.load();
+			active = true;
+			morphing = std::memcmp(&a, &b, sizeof(Snapshot)) != 0;
+		}
+
+		float interpolate(float x0, float x1, float x) const noexcept
+		{
+			return x0 + x * (x1 - x0);
+		}
+
+		void apply(Params& params) noexcept
+		{
+			const auto bSide = pos >= .5f;
+			const auto arrived = fade >= .5f;
+			for (auto p = 0; p < NumParams; ++p)
+			{
+				auto& param = params(p);
+				if (param.locked.load())
+					continue;
+
+				if (stepped[p])
+				{
+					const auto dest = bSide ? b.values[p] : a.values[p];
+					const auto val = arrived ? dest : from.values[p];
+					if (param.getValue() != val)
+						param.setValue(val);
+				}
+				else
+				{
+					const auto dest = interpolate(a.values[p], b.values[p], pos);
+					const auto val = interpolate(from.values[p], dest, fade);
+					if (param.getValue() != val)
+						param.setValue(val);
+				}
+
+				auto modChanged = false;
+				for (auto i = 0; i < NumMacros; ++i)
+				{
+					const auto depth = interpolate(from.modDepth[p][i], interpolate(a.modDepth[p][i], b.modDepth[p][i], pos), fade);
+					const auto bias = interpolate(from.modBias[p][i], interpolate(a.modBias[p][i], b.modBias[p][i], pos), fade);
+					modChanged = modChanged || param.modDepth[i].load() != depth || param.modBias[i].load() != bias;
+					param.modDepth[i].store(depth);
+					param.modBias[i].store(bias);
+				}
+				if (modChanged)
+					param.markDirty();
+			}
+		}
+	};
+}
@@ -0,0 +1,170 @@
+#pragma once
+#include <JuceHeader.h>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <deque>
+#include <vector>
+
+namespace gui
+{
+    /* one background thread shared by all open editors, it goes away with the last one */
+    struct RenderThread :
+        public juce::ThreadPool
+    {
+        RenderThread() :
+            juce::ThreadPool(1)
+        {}
+    };
+
+    // first value of every render cache key, so that different pictures don't collide
+    enum class RenderKey { Knob, Wavetable, ADSRRel, ADSRAbs, NumKeys };
+
+    inline juce::int64 hashCombine(juce::int64 seed, juce::int64 v) noexcept
+    {
+        const auto s = static_cast<juce::uint64>(seed);
+        const auto x = static_cast<juce::uint64>(v) + 0x9e3779b97f4a7c15ull + (s << 6) + (s >> 2);
+        return static_cast<juce::int64>(s ^ x);
+    }
+
+    inline juce::int64 hashCombine(juce::int64 seed, float v) noexcept
+    {
+        return hashCombine(seed, static_cast<juce::int64>(juce::roundToInt(v * 1024.f)));
+    }
+
+    inline juce::int64 hashCombine(juce::int64 seed, juce::Colour c) noexcept
+    {
+        return hashCombine(seed, static_cast<juce::int64>(c.getARGB()));
+    }
+
+    /*
+    renders static geometry into images on a background thread.
+    the key must describe everything the picture depends on (size, scale, colours, data),
+    paint only blits what's already there and falls back to drawing directly while it renders.
+    render functions run on the background thread, so they must capture everything by value.
+    */
+    struct RenderCache
+    {
+        using Render = std::function<void(juce::Graphics&)>;
+        using Requesters = std::vector<juce::Component::SafePointer<juce::Component>>;
+
+        /* maxImages, the oldest images are dropped first */
+        RenderCache(size_t maxImages = 128) :
+            data(std::make_shared<Data>(maxImages)),
+            thread()
+        {}
+
+        ~RenderCache()
+        {
+            clear();
+        }
+
+        /* returns the image of key, or an invalid one if it wasn't rendered yet */
+        juce::Image find(juce::int64 key) const
+        {
+            const std::lock_guard<std::mutex> lock(data->mutex);
+            const auto img = data->images.find(key);
+            if (img != data->images.end())
+                return img->second;
+            return {};
+        }
+
+        /* key, width, height, renderFunc, requester
+        renders the image of key in the background unless it's already on its way.
+        the requester gets repainted once the image is ready */
+        void render(juce::int64 key, int width, int height, Render&& renderFunc, juce::Component& requester)
+        {
+            if (width < 1 || height < 1)
+                return;
+
+            int gen;
+            {
+                const std::lock_guard<std::mutex> lock(data->mutex);
+                if (data->images.find(key) != data->images.end())
+                    return;
+
+                auto& requesters = data->pending[key];
+                requesters.push_back(&requester);
+                if (requesters.size() > 1)
+                    return;
+                gen = data->generation;
+            }
+
+            thread->addJob([d = data, gen, key, width, height, r = std::move(renderFunc)]()
+            {
+                juce::Image img(juce::Image::ARGB, width, height, true, juce::SoftwareImageType());
+                {
+                    juce::Graphics g(img);
+                    r(g);
+                }
+
+                Requesters requesters;
+                {
+                    const std::lock_guard<std::mutex> lock(d->mutex);
+                    if (gen != d->generation)
+                        return;
+                    d->insert(key, img);
+                    auto pending = d->pending.find(key);
+                    if (pending != d->pending.end())
+                    {
+                        requesters = std::move(pending->second);
+                        d->pending.erase(pending);
+                    }
+                }
+
+                juce::MessageManager::callAsync([requesters]()
+                {
+                    for (auto& r : requesters)
+                        if (r != nullptr)
+                            r->repaint();
+                });
+            });
+        }
+
+        /* drops all images, f.ex. if the data behind a key changed without the key changing */
+        void clear()
+        {
+            const std::lock_guard<std::mutex> lock(data->mutex);
+            ++data->generation;
+            data->images.clear();
+            data->order.clear();
+            data->pending.clear();
+        }
+
+    private:
+        struct Data
+        {
+            Data(size_t _maxImages) :
+                mutex(),
+                images(),
+                order(),
+                pending(),
+                maxImages(_maxImages),
+                generation(0)
+            {}
+
+            void insert(juce::int64 key, const juce::Image& img)
+            {
+                images[key] = img;
+                order.push_back(key);
+                while (order.size() > maxImages)
+                {
+                    images.erase(order.front());
+                    order.pop_front();
+                }
+            }
+
+            std::mutex mutex;
+            std::map<juce::int64, juce::Image> images;
+            std::deque<juce::int64> order;
+            std::map<juce::int64, Requesters> pending;
+            const size_t maxImages;
+            int generation;
+        };
+
+        // jobs keep the data alive, so the cache can go before they finish
+        std::shared_ptr<Data> data;
+        juce::SharedResourcePointer<RenderThread> thread;
+    };
+}
@@ -1,5 +1,8 @@
 #pragma once
+#include <algorithm>
+#include <vector>
 #include "Filter.h"
+#include "../dsp/Simd.h"
 
 namespace oversampling
 {
@@ -24,6 +27,16 @@ namespace oversampling
 		Float operator[](int i) const noexcept { return data[i]; }
 		const size_t size() const noexcept { return data.size(); }
 
+		/* every other coefficient, starting at offset.
+		the phases of a zero-stuffed upsampling filter */
+		ImpulseResponse<Float> getPhase(int offset) const
+		{
+			std::vector<Float> phase;
+			for (auto i = offset; i < static_cast<int>(data.size()); i += 2)
+				phase.push_back(data[i]);
+			return phase;
+		}
+
 		std::vector<Float> data;
 		int latency;
 	};
@@ -81,6 +94,10 @@ namespace oversampling
 		return ir;
 	}
 
+	/*
+	the ring buffer is written twice, size samples apart and backwards,
+	so that the most recent samples are always one contiguous run for the dot product
+	*/
 	template<typename Float>
 	struct Convolution
 	{
@@ -90,83 +107,68 @@ namespace oversampling
 			buffer(),
 			wIdx(0)
 		{
-			buffer.resize(ir.size(), static_cast<Float>(0));
+			buffer.resize(ir.size() * 2, static_cast<Float>(0));
+		}
+
+		void reset() noexcept
+		{
+			std::fill(buffer.begin(), buffer.end(), static_cast<Float>(0));
+			wIdx = 0;
 		}
 
 		void processBlock(Float* audioBuffer, const IR& ir, const int numSamples) noexcept
 		{
+			const auto& kernels = simd::getKernels();
+			const auto irSize = static_cast<int>(ir.size());
 			for (auto s = 0; s < numSamples; ++s)
 			{
-				++wIdx;
-				if (wIdx == ir.size())
-					wIdx = 0;
-				buffer[wIdx] = audioBuffer[s];
-
-				auto y = 0.;
-				auto rIdx = wIdx;
-				for (auto i = 0; i < ir.size(); ++i)
-				{
-					y += buffer[rIdx] * ir[i];
-					--rIdx;
-					if (rIdx == -1)
-						rIdx = static_cast<int>(ir.size()) - 1;
-				}
-				audioBuffer[s] = y;
+				write(audioBuffer[s], irSize);
+				audioBuffer[s] = kernels.dot(buffer.data() + wIdx, ir.data.data(), irSize);
 			}
 		}
 		
-		void processBlockUp(Float* audioBuffer, const IR& ir, const int numSamples) noexcept
+		/* audioBuffer, irEven, irOdd, numSamples
+		audioBuffer is zero-stuffed, so only its even samples are read */
+		void processBlockUp(Float* audioBuffer, const IR& irEven, const IR& irOdd, const int numSamples) noexcept
 		{
+			const auto& kernels = simd::getKernels();
+			const auto evenSize = static_cast<int>(irEven.size());
+			const auto oddSize = static_cast<int>(irOdd.size());
 			for (auto s = 0; s < numSamples; s += 2)
 			{
-				audioBuffer[s] = processSampleUpEven(audioBuffer[s], ir);
-				audioBuffer[s + 1] = processSampleUpOdd(ir);
+				write(audioBuffer[s], evenSize);
+				const auto window = buffer.data() + wIdx;
+				audioBuffer[s] = kernels.dot(window, irEven.data.data(), evenSize);
+				audioBuffer[s + 1] = kernels.dot(window, irOdd.data.data(), oddSize);
 			}
 		}
 		
-		Float processSampleUpEven(const Float sample, const IR& ir) noexcept
+		/* sample, irEven, kernels. the caller fetches the kernels once per block */
+		Float processSampleUpEven(const Float sample, const IR& irEven, const simd::Kernels& kernels) noexcept
 		{
-			const auto irSize = static_cast<int>(ir.size());
-			buffer[wIdx] = sample;
-			auto y = 0.;
-			auto rIdx = wIdx;
-			for (auto i = 0; i < irSize; i += 2)
-			{
-				y += buffer[rIdx] * ir[i];
-				rIdx -= 2;
-				if (rIdx < 0)
-					rIdx += irSize;
-			}
-			++wIdx;
-			if (wIdx == irSize)
-				wIdx = 0;
-			return y;
+			const auto evenSize = static_cast<int>(irEven.size());
+			write(sample, evenSize);
+			return kernels.dot(buffer.data() + wIdx, irEven.data.data(), evenSize);
 		}
 		
-		Float processSampleUpOdd(const IR& ir) noexcept
+		/* irOdd, kernels. the zero in between, call after processSampleUpEven */
+		Float processSampleUpOdd(const IR& irOdd, const simd::Kernels& kernels) noexcept
 		{
-			const auto irSize = static_cast<int>(ir.size());
-			auto y = 0.;
-			auto rIdx = wIdx - 1;
-			if (rIdx == -1)
-				rIdx = irSize - 1;
-			buffer[wIdx] = 0.f;
-			for (auto i = 1; i < irSize; i += 2)
-			{
-				y += buffer[rIdx] * ir[i];
-				rIdx -= 2;
-				if (rIdx < 0)
-					rIdx += irSize;
-			}
-			++wIdx;
-			if (wIdx == irSize)
-				wIdx = 0;
-			return y;
+			const auto oddSize = static_cast<int>(irOdd.size());
+			return kernels.dot(buffer.data() + wIdx, irOdd.data.data(), oddSize);
 		}
 		
 	protected:
 		std::vector<Float> buffer;
 		int wIdx;
+
+		/* sample, size of the ring */
+		void write(Float sample, int size) noexcept
+		{
+			wIdx = (wIdx == 0 ? size : wIdx) - 1;
+			buffer[wIdx] = sample;
+			buffer[wIdx + size] = sample;
+		}
 	};
 
 	template<typename Float>
@@ -179,39 +181,67 @@ namespace oversampling
 			Float _cutoff = static_cast<Float>(.25), Float _bandwidth = static_cast<Float>(.25),
 				bool upsampling = false) :
 			ir(makeSincFilter2(_Fs, _cutoff, _bandwidth, upsampling)),
-			filters{ ir, ir, ir, ir }
+			irEven(ir.getPhase(0)),
+			irOdd(ir.getPhase(1)),
+			filters()
+		{
+		}
+
+		/* numChannels, every channel has its own ring */
+		void prepare(int numChannels)
 		{
+			filters.assign(static_cast<size_t>(numChannels), Convolver(ir));
 		}
 		
 		int getLatency() const noexcept
 		{
 			return ir.latency;
 		}
+
+		void reset() noexcept
+		{
+			for (auto& filter : filters)
+				filter.reset();
+		}
 		
 		void processBlockDown(Float* const* audioBuffer, int numChannels, int numSamples) noexcept
 		{
 			for (auto ch = 0; ch < numChannels; ++ch)
-				filters[ch].processBlock(audioBuffer[ch], ir, numSamples);
+				processChannelDown(audioBuffer[ch], ch, numSamples);
 		}
 		
 		void processBlockUp(Float* const* audioBuffer, int numChannels, int numSamples) noexcept
 		{
 			for (auto ch = 0; ch < numChannels; ++ch)
-				filters[ch].processBlockUp(audioBuffer[ch], ir, numSamples);
+				processChannelUp(audioBuffer[ch], ch, numSamples);
+		}
+
+		/* samples, ch, numSamples */
+		void processChannelDown(Float* samples, int ch, int numSamples) noexcept
+		{
+			filters[ch].processBlock(samples, ir, numSamples);
+		}
+
+		/* samples, ch, numSamples */
+		void processChannelUp(Float* samples, int ch, int numSamples) noexcept
+		{
+			filters[ch].processBlockUp(samples, irEven, irOdd, numSamples);
 		}
 		
-		Float processSampleUpEven(const Float sample, const int ch) noexcept
+		/* sample, ch, kernels, see simd::getKernels */
+		Float processSampleUpEven(const Float sample, const int ch, const simd::Kernels& kernels) noexcept
 		{
-			return filters[ch].processSampleUpEven(sample, ir);
+			return filters[ch].processSampleUpEven(sample, irEven, kernels);
 		}
 		
-		Float processSampleUpOdd(const int ch) noexcept
+		/* ch, kernels, see simd::getKernels */
+		Float processSampleUpOdd(const int ch, const simd::Kernels& kernels) noexcept
 		{
-			return filters[ch].processSampleUpOdd(ir);
+			return filters[ch].processSampleUpOdd(irOdd, kernels);
 		}
 		
 	protected:
-		IR ir;
-		std::array<Convolver, 4> filters;
+		IR ir, irEven, irOdd;
+		std::vector<Convolver> filters;
 	};
 }
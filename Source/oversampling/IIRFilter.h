@@ -1,9 +1,12 @@
 #pragma once
 #include "Filter.h"
+#include "../dsp/SimdPair.h"
 #include <array>
+#include <vector>
 
 namespace oversampling
 {
+	/* transposed direct form II, it only has to keep 4 states and they stay small */
 	template<typename Float>
 	struct IIR
 	{
@@ -23,20 +26,23 @@ namespace oversampling
 		IIR() :
 			a0(1.f), a1(0.f), a2(0.f), a3(0.f), a4(0.f),
 			b1(0.f), b2(0.f), b3(0.f), b4(0.f),
-			x1(0.f), x2(0.f), x3(0.f), x4(0.f),
-			y1(0.f), y2(0.f), y3(0.f), y4(0.f)
+			z()
 		{
-			
+			z.fill(static_cast<Float>(0));
 		}
 		
 		IIR(float _a0, float _a1, float _a2, float _a3, float _a4,
 			float _b1, float _b2, float _b3, float _b4) :
 			a0(_a0), a1(_a1), a2(_a2), a3(_a3), a4(_a4),
 			b1(_b1), b2(_b2), b3(_b3), b4(_b4),
-			x1(0.f), x2(0.f), x3(0.f), x4(0.f),
-			y1(0.f), y2(0.f), y3(0.f), y4(0.f)
+			z()
 		{
+			z.fill(static_cast<Float>(0));
+		}
 
+		void reset() noexcept
+		{
+			z.fill(static_cast<Float>(0));
 		}
 
 		void processBlock(Float* samples, int numSamples) noexcept
@@ -45,35 +51,130 @@ namespace oversampling
 				samples[s] = processSample(samples[s]);
 		}
 		
-		Float processSample(Float x0) noexcept
+		/* other, samplesL, samplesR, numSamples
+		runs this and another filter with the same coefficients side by side */
+		void processPair(IIR& other, Float* samplesL, Float* samplesR, int numSamples) noexcept
 		{
-			const auto y0 =
-				x0 * a0
-				+ x1 * a1
-				+ x2 * a2
-				+ x3 * a3
-				+ x4 * a4
-				+ y1 * b1
-				+ y2 * b2
-				+ y3 * b3
-				+ y4 * b4;
-
-			x4 = x3;
-			x3 = x2;
-			x2 = x1;
-			x1 = x0;
-
-			y4 = y3;
-			y3 = y2;
-			y2 = y1;
-			y1 = y0;
+			using Pair = simd::Pair<Float>;
+			std::array<Pair, 4> zPair;
+			for (auto i = 0; i < 4; ++i)
+				zPair[i] = Pair(z[i], other.z[i]);
 
-			return y0;
+			for (auto s = 0; s < numSamples; ++s)
+			{
+				const auto y0 = tick(Pair(samplesL[s], samplesR[s]), zPair);
+				samplesL[s] = y0.left();
+				samplesR[s] = y0.right();
+			}
+
+			for (auto i = 0; i < 4; ++i)
+			{
+				z[i] = zPair[i].left();
+				other.z[i] = zPair[i].right();
+			}
+		}
+		
+		Float processSample(Float x0) noexcept
+		{
+			return tick(x0, z);
 		}
 		
 	protected:
 		Float a0, a1, a2, a3, a4, b1, b2, b3, b4;
-		Float 	  x1, x2, x3, x4, y1, y2, y3, y4;
+		std::array<Float, 4> z;
+
+		/* x0, z */
+		template<typename Value>
+		Value tick(Value x0, std::array<Value, 4>& _z) const noexcept
+		{
+			const Value y0 = x0 * a0 + _z[0];
+			_z[0] = x0 * a1 + y0 * b1 + _z[1];
+			_z[1] = x0 * a2 + y0 * b2 + _z[2];
+			_z[2] = x0 * a3 + y0 * b3 + _z[3];
+			_z[3] = x0 * a4 + y0 * b4;
+			return y0;
+		}
+	};
+
+	/* transposed direct form II, like juce::dsp::IIR::Filter, but two channels can run side by side */
+	template<typename Float>
+	struct Biquad
+	{
+		Biquad() :
+			b0(static_cast<Float>(1)), b1(static_cast<Float>(0)), b2(static_cast<Float>(0)),
+			a1(static_cast<Float>(0)), a2(static_cast<Float>(0)),
+			z()
+		{
+			z.fill(static_cast<Float>(0));
+		}
+
+		/* coefs, normalized to a0 = 1 in the order b0, b1, b2, a1, a2 like juce::dsp::IIR::Coefficients */
+		void setCoefficients(const Float* coefs) noexcept
+		{
+			b0 = coefs[0];
+			b1 = coefs[1];
+			b2 = coefs[2];
+			a1 = coefs[3];
+			a2 = coefs[4];
+		}
+
+		void reset() noexcept
+		{
+			z.fill(static_cast<Float>(0));
+		}
+
+		/* samples, numSamples */
+		void processBlock(Float* samples, int numSamples) noexcept
+		{
+			for (auto s = 0; s < numSamples; ++s)
+				samples[s] = tick(samples[s], z);
+			snapToZero();
+		}
+
+		/* other, samplesL, samplesR, numSamples
+		runs this and another filter with the same coefficients side by side */
+		void processPair(Biquad& other, Float* samplesL, Float* samplesR, int numSamples) noexcept
+		{
+			using Pair = simd::Pair<Float>;
+			std::array<Pair, 2> zPair = { Pair(z[0], other.z[0]), Pair(z[1], other.z[1]) };
+
+			for (auto s = 0; s < numSamples; ++s)
+			{
+				const auto y0 = tick(Pair(samplesL[s], samplesR[s]), zPair);
+				samplesL[s] = y0.left();
+				samplesR[s] = y0.right();
+			}
+
+			for (auto i = 0; i < 2; ++i)
+			{
+				z[i] = zPair[i].left();
+				other.z[i] = zPair[i].right();
+			}
+			snapToZero();
+			other.snapToZero();
+		}
+
+	protected:
+		Float b0, b1, b2, a1, a2;
+		std::array<Float, 2> z;
+
+		/* x0, z */
+		template<typename Value>
+		Value tick(Value x0, std::array<Value, 2>& _z) const noexcept
+		{
+			const Value y0 = x0 * b0 + _z[0];
+			_z[0] = x0 * b1 - y0 * a1 + _z[1];
+			_z[1] = x0 * b2 - y0 * a2;
+			return y0;
+		}
+
+		// keeps denormals out of the states while the input is silent
+		void snapToZero() noexcept
+		{
+			for (auto& state : z)
+				if (!(state < static_cast<Float>(-1e-8) || state > static_cast<Float>(1e-8)))
+					state = static_cast<Float>(0);
+		}
 	};
 
 	// FC = fc [0, .5]
@@ -230,19 +331,47 @@ namespace oversampling
 		LowkeyChebyshevFilter() :
 			filters()
 		{
-			for (auto& filter : filters)
-				filter.makeChebyshev_lp_4pole_fc45_ripl5();
+		}
+
+		/* numChannels, every channel has its own states */
+		void prepare(int numChannels)
+		{
+			IIR<Float> filter;
+			filter.makeChebyshev_lp_4pole_fc45_ripl5();
+			filters.assign(static_cast<size_t>(numChannels), filter);
 		}
 		
 		int getLatency() const noexcept
 		{
 			return 0;
 		}
+
+		void reset() noexcept
+		{
+			for (auto& filter : filters)
+				filter.reset();
+		}
 		
 		void processBlock(Float* const* audioBuffer, int numChannels, const int numSamples) noexcept
 		{
-			for (auto ch = 0; ch < numChannels; ++ch)
-				filters[ch].processBlock(audioBuffer[ch], numSamples);
+			auto ch = 0;
+			for (; ch + 1 < numChannels; ch += 2)
+				processPair(audioBuffer[ch], audioBuffer[ch + 1], ch, numSamples);
+			if (ch < numChannels)
+				processChannel(audioBuffer[ch], ch, numSamples);
+		}
+
+		/* samples, ch, numSamples */
+		void processChannel(Float* samples, int ch, const int numSamples) noexcept
+		{
+			filters[ch].processBlock(samples, numSamples);
+		}
+
+		/* samplesL, samplesR, ch, numSamples
+		processes the channels ch and ch + 1 together */
+		void processPair(Float* samplesL, Float* samplesR, int ch, const int numSamples) noexcept
+		{
+			filters[ch].processPair(filters[ch + 1], samplesL, samplesR, numSamples);
 		}
 		
 		float processSample(Float sample, int ch) noexcept
@@ -251,6 +380,6 @@ namespace oversampling
 		}
 		
 	protected:
-		std::array<IIR<Float>, 4> filters;
+		std::vector<IIR<Float>> filters;
 	};
 }
\ No newline at end of file
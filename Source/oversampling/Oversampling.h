@@ -1,15 +1,16 @@
 #pragma once
 #include <array>
+#include <vector>
 #include "juce_audio_basics/juce_audio_basics.h"
 #include "Filter.h"
 #include "ConvolutionFilter.h"
 #include "IIRFilter.h"
+#include "../dsp/Arena.h"
 
 namespace oversampling
 {
 	constexpr size_t MaxNumStages = 2;
 	static constexpr size_t MaxOrder = 1 << MaxNumStages;
-	static constexpr int NumChannels = 2;
 	
 	using String = juce::String;
 	using AudioBufferF = juce::AudioBuffer<float>;
@@ -69,6 +70,7 @@ namespace oversampling
 	struct Processor
 	{
 		Processor() :
+			bufferUp(),
 			buffer(),
 			//
 			filterUp4(176400., 22050., 44100., true), //  17 samples
@@ -85,7 +87,8 @@ namespace oversampling
 		}
 
 		Processor(Processor& p) :
-			buffer(p.buffer),
+			bufferUp(p.bufferUp),
+			buffer(),
 			filterUp2(p.filterUp2), filterUp4(p.filterUp4),
 			filterDown4(p.filterDown4), filterDown2(p.filterDown2),
 			FsUp(p.FsUp), blockSizeUp(p.blockSizeUp),
@@ -94,7 +97,8 @@ namespace oversampling
 		{
 		}
 
-		void prepareToPlay(const double Fs, const int blockSize, bool _enabled)
+		/* Fs, blockSize, enabled, numChannels, sidechain included */
+		void prepareToPlay(const double Fs, const int blockSize, bool _enabled, int numChannels)
 		{
 			enabled = _enabled;
 			if (enabled)
@@ -107,49 +111,126 @@ namespace oversampling
 				FsUp = Fs;
 				blockSizeUp = blockSize;
 			}
-			buffer.setSize(4, blockSizeUp, false, false, false);
+			bufferUp.setSize(numChannels, blockSizeUp);
+			filterUp2.prepare(numChannels);
+			filterUp4.prepare(numChannels);
+			filterDown4.prepare(numChannels);
+			filterDown2.prepare(numChannels);
+		}
+
+		/* clears the filter states, f.ex. after processing was skipped for a while */
+		void reset() noexcept
+		{
+			filterUp2.reset();
+			filterUp4.reset();
+			filterDown4.reset();
+			filterDown2.reset();
 		}
 		
 		////////////////////////////////////////
 		AudioBufferD& upsample(AudioBufferD& input) noexcept
 		{
+			auto& output = prepareUpsample(input);
 			if (enabled)
 			{
 				const auto numChannels = input.getNumChannels();
+				auto ch = 0;
+				for (; ch + 1 < numChannels; ch += 2)
+					upsamplePair(input, ch);
+				if (ch < numChannels)
+					upsampleChannel(input, ch);
+			}
+			return output;
+		}
+
+		/* input
+		sizes the upsampled buffer and returns it, call before upsampleChannel */
+		AudioBufferD& prepareUpsample(AudioBufferD& input) noexcept
+		{
+			if (enabled)
+			{
 				numSamples1x = input.getNumSamples();
 				numSamples2x = numSamples1x * 2;
 				numSamples4x = numSamples1x * 4;
 
-				buffer.setSize(numChannels, numSamples4x, true, false, true);
-				const auto samplesIn = input.getArrayOfReadPointers();
-				auto samplesUp = buffer.getArrayOfWritePointers();
-				
-				// 2x
-				zeroStuff(samplesUp, samplesIn, numChannels, numSamples1x);
-				filterUp2.processBlock(samplesUp, numChannels, numSamples2x);
-				// 4x
-				zeroStuff(samplesUp, numChannels, numSamples2x);
-				filterUp4.processBlockUp(samplesUp, numChannels, numSamples4x);
-
-				for(auto ch = 0; ch < numChannels; ++ch)
-					juce::FloatVectorOperations::multiply(samplesUp[ch], 2., numSamples4x);
-				
+				bufferUp.referTo(buffer, input.getNumChannels(), numSamples4x);
 				return buffer;
 			}
 			return input;
 		}
+
+		/* input, ch
+		the channels don't share state, so they can be upsampled on different threads */
+		void upsampleChannel(const AudioBufferD& input, int ch) noexcept
+		{
+			const double* samplesIn[] = { input.getReadPointer(ch) };
+			double* samplesUp[] = { buffer.getWritePointer(ch) };
+
+			// 2x
+			zeroStuff(samplesUp, samplesIn, 1, numSamples1x);
+			filterUp2.processChannel(samplesUp[0], ch, numSamples2x);
+			// 4x
+			zeroStuff(samplesUp, 1, numSamples2x);
+			filterUp4.processChannelUp(samplesUp[0], ch, numSamples4x);
+
+			juce::FloatVectorOperations::multiply(samplesUp[0], 2., numSamples4x);
+		}
+
+		/* input, ch
+		upsamples the channels ch and ch + 1, their iir filters run side by side */
+		void upsamplePair(const AudioBufferD& input, int ch) noexcept
+		{
+			const double* samplesIn[] = { input.getReadPointer(ch), input.getReadPointer(ch + 1) };
+			double* samplesUp[] = { buffer.getWritePointer(ch), buffer.getWritePointer(ch + 1) };
+
+			// 2x
+			zeroStuff(samplesUp, samplesIn, 2, numSamples1x);
+			filterUp2.processPair(samplesUp[0], samplesUp[1], ch, numSamples2x);
+			// 4x
+			zeroStuff(samplesUp, 2, numSamples2x);
+			for (auto i = 0; i < 2; ++i)
+			{
+				filterUp4.processChannelUp(samplesUp[i], ch + i, numSamples4x);
+				juce::FloatVectorOperations::multiply(samplesUp[i], 2., numSamples4x);
+			}
+		}
 		
 		void downsample(AudioBufferD& outBuf) noexcept
 		{
-			auto samplesUp = buffer.getArrayOfWritePointers();
-			auto samplesOut = outBuf.getArrayOfWritePointers();
 			const auto numChannels = outBuf.getNumChannels();
+			auto ch = 0;
+			for (; ch + 1 < numChannels; ch += 2)
+				downsamplePair(outBuf, ch);
+			if (ch < numChannels)
+				downsampleChannel(outBuf, ch);
+		}
+
+		/* outBuf, ch */
+		void downsampleChannel(AudioBufferD& outBuf, int ch) noexcept
+		{
+			double* samplesUp[] = { buffer.getWritePointer(ch) };
+			double* samplesOut[] = { outBuf.getWritePointer(ch) };
 			// 4x
-			filterDown4.processBlockDown(samplesUp, numChannels, numSamples4x);
-			decimate(samplesUp, numChannels, numSamples2x);
+			filterDown4.processChannelDown(samplesUp[0], ch, numSamples4x);
+			decimate(samplesUp, 1, numSamples2x);
 			// 2x
-			filterDown2.processBlock(samplesUp, numChannels, numSamples2x);
-			decimate(samplesOut, samplesUp, numChannels, numSamples1x);
+			filterDown2.processChannel(samplesUp[0], ch, numSamples2x);
+			decimate(samplesOut, samplesUp, 1, numSamples1x);
+		}
+
+		/* outBuf, ch
+		downsamples the channels ch and ch + 1, their iir filters run side by side */
+		void downsamplePair(AudioBufferD& outBuf, int ch) noexcept
+		{
+			double* samplesUp[] = { buffer.getWritePointer(ch), buffer.getWritePointer(ch + 1) };
+			double* samplesOut[] = { outBuf.getWritePointer(ch), outBuf.getWritePointer(ch + 1) };
+			// 4x
+			for (auto i = 0; i < 2; ++i)
+				filterDown4.processChannelDown(samplesUp[i], ch + i, numSamples4x);
+			decimate(samplesUp, 2, numSamples2x);
+			// 2x
+			filterDown2.processPair(samplesUp[0], samplesUp[1], ch, numSamples2x);
+			decimate(samplesOut, samplesUp, 2, numSamples1x);
 		}
 		
 		////////////////////////////////////////
@@ -175,6 +256,8 @@ namespace oversampling
 		}
 		
 	protected:
+		dsp::ScratchBuffer<double> bufferUp;
+		// refers to the part of bufferUp the current block needs
 		AudioBufferD buffer;
 
 		ConvolutionFilter<double> filterUp4, filterDown4;
@@ -197,26 +280,26 @@ namespace oversampling
 			gain(0.)
 		{}
 
-		void prepareToPlay(double sampleRate, const int _blockSize, bool enabled)
+		/* sampleRate, blockSize, enabled, numChannels, sidechain included */
+		void prepareToPlay(double sampleRate, const int _blockSize, bool enabled, int numChannels)
 		{
-			processor.prepareToPlay(sampleRate, _blockSize, enabled);
-
-			juce::dsp::ProcessSpec spec;
-			spec.sampleRate = sampleRate;
-			spec.maximumBlockSize = _blockSize;
-			spec.numChannels = 2;
+			processor.prepareToPlay(sampleRate, _blockSize, enabled, numChannels);
 
 			cutoff = 20000.;
 			gain = juce::Decibels::decibelsToGain(14.436 * .5);
 			q = .229;
 			coefficients = juce::dsp::IIR::Coefficients<double>::makeHighShelf(sampleRate, cutoff, q, gain);
 
+			Biquad<double> filter;
+			filter.setCoefficients(coefficients->getRawCoefficients());
+			filters.assign(static_cast<size_t>(numChannels), filter);
+		}
+
+		void reset() noexcept
+		{
+			processor.reset();
 			for (auto& filter : filters)
-			{
 				filter.reset();
-				filter.prepare(spec);
-				filter.coefficients = coefficients;
-			}
 		}
 		
 		/* processing methods */
@@ -227,16 +310,36 @@ namespace oversampling
 		
 		void downsample(AudioBufferD& outBuf) noexcept
 		{
-			processor.downsample(outBuf);
-			
-			for (auto ch = 0; ch < outBuf.getNumChannels(); ++ch)
-			{
-				auto& filter = filters[ch];
-				double* samples[] = { outBuf.getWritePointer(ch) };
-				juce::dsp::AudioBlock<double> block(samples, 1, outBuf.getNumSamples());
-				juce::dsp::ProcessContextReplacing<double> context(block);
-				filter.process(context);
-			}
+			const auto numChannels = outBuf.getNumChannels();
+			auto ch = 0;
+			for (; ch + 1 < numChannels; ch += 2)
+				downsamplePair(outBuf, ch);
+			if (ch < numChannels)
+				downsampleChannel(outBuf, ch);
+		}
+
+		/* per channel processing, for splitting the channels across threads */
+		AudioBufferD& prepareUpsample(AudioBufferD& input) noexcept
+		{
+			return processor.prepareUpsample(input);
+		}
+
+		void upsampleChannel(const AudioBufferD& input, int ch) noexcept
+		{
+			processor.upsampleChannel(input, ch);
+		}
+
+		void downsampleChannel(AudioBufferD& outBuf, int ch) noexcept
+		{
+			processor.downsampleChannel(outBuf, ch);
+			filters[ch].processBlock(outBuf.getWritePointer(ch), outBuf.getNumSamples());
+		}
+
+		/* outBuf, ch, the channels ch and ch + 1 */
+		void downsamplePair(AudioBufferD& outBuf, int ch) noexcept
+		{
+			processor.downsamplePair(outBuf, ch);
+			filters[ch].processPair(filters[ch + 1], outBuf.getWritePointer(ch), outBuf.getWritePointer(ch + 1), outBuf.getNumSamples());
 		}
 		
 		////////////////////////////////////////
@@ -251,7 +354,7 @@ namespace oversampling
 		}
 		
 		Processor processor;
-		std::array<juce::dsp::IIR::Filter<double>, 4> filters;
+		std::vector<Biquad<double>> filters;
 		juce::ReferenceCountedObjectPtr<juce::dsp::IIR::Coefficients<double>> coefficients;
 		double cutoff, q, gain;
 	};
@@ -264,7 +367,4 @@ try other filter types:
 	butterworth low pass filter
 automatic reaction to different sampleRates
 
-optimisations:
-convolution filter simd
-
 */
\ No newline at end of file
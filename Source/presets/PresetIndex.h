@@ -0,0 +1,342 @@
+#pragma once
+#include <JuceHeader.h>
+#include "../dsp/Modulator.h"
+#include <vector>
+#include <memory>
+#include <atomic>
+
+namespace presets
+{
+	using String = juce::String;
+	using StringArray = juce::StringArray;
+	using File = juce::File;
+	using ValueTree = juce::ValueTree;
+	using int64 = juce::int64;
+
+	/* only the metadata of a preset, the patch itself is loaded from file when it's chosen */
+	struct Entry
+	{
+		File file;
+		String name;
+		StringArray tags, modTypes;
+		int64 mtime, size, fingerprint;
+
+		/* all tokens must be found in the name, tags or mod types */
+		bool matches(const StringArray& tokens) const
+		{
+			for (const auto& token : tokens)
+			{
+				bool found = name.containsIgnoreCase(token);
+				for (auto t = 0; !found && t < tags.size(); ++t)
+					found = tags[t].containsIgnoreCase(token);
+				for (auto t = 0; !found && t < modTypes.size(); ++t)
+					found = modTypes[t].containsIgnoreCase(token);
+				if (!found)
+					return false;
+			}
+			return true;
+		}
+	};
+
+	using Entries = std::vector<Entry>;
+
+	/* hash over all parameter values and modulations, so that identical patches can be identified */
+	inline int64 makeFingerprint(const ValueTree& state)
+	{
+		const auto childParams = state.getChildWithName(modSys6::stateID::params());
+		String str;
+		for (auto c = 0; c < childParams.getNumChildren(); ++c)
+		{
+			const auto child = childParams.getChild(c);
+			str << child.getType().toString();
+			for (auto p = 0; p < child.getNumProperties(); ++p)
+				str << child.getProperty(child.getPropertyName(p)).toString();
+		}
+		return str.hashCode64();
+	}
+
+	inline StringArray getModTypes(const ValueTree& state)
+	{
+		StringArray modTypes;
+		const auto modTypeID = vibrato::toString(vibrato::ObjType::ModType);
+		const auto modTypeState = state.getChildWithName(modTypeID);
+		for (auto p = 0; p < modTypeState.getNumProperties(); ++p)
+			modTypes.addIfNotAlreadyThere(modTypeState.getProperty(modTypeState.getPropertyName(p)).toString());
+		return modTypes;
+	}
+
+	/* file, state, extension */
+	inline Entry makeEntry(const File& file, const ValueTree& state, const String& extension)
+	{
+		const auto fileName = file.getFileName();
+		return
+		{
+			file,
+			fileName.substring(0, fileName.length() - extension.length()),
+			StringArray::fromTokens(state.getProperty("tags", "").toString(), ",", ""),
+			getModTypes(state),
+			file.getLastModificationTime().toMilliseconds(),
+			file.getSize(),
+			makeFingerprint(state)
+		};
+	}
+
+	/*
+	scans and parses the preset directory on a background thread
+	and keeps a persisted index of the presets' metadata.
+	only files that are new or have a different mtime or size are parsed again.
+	listeners are told on the message thread whenever the index changed.
+	*/
+	struct Index :
+		public juce::Thread,
+		public juce::ChangeBroadcaster
+	{
+		static constexpr int Magic = 0x4e454c49; // "NELI"
+		static constexpr int Version = 1;
+		static constexpr int PollIntervalMs = 1500;
+
+		/* directory, extension */
+		Index(const File& _directory, const String& _extension) :
+			juce::Thread("NEL presets index"),
+			juce::ChangeBroadcaster(),
+			directory(_directory),
+			indexFile(_directory.getChildFile(".index")),
+			extension(_extension),
+			lock(),
+			entries(),
+			numUsers(0),
+			loaded(false),
+			needsSave(false)
+		{
+		}
+
+		~Index()
+		{
+			stopThread(4000);
+		}
+
+		/* message thread. starts indexing and watching the directory, as long as one user needs it */
+		void start()
+		{
+			if (numUsers++ == 0)
+				startThread();
+		}
+
+		/* message thread, the directory is only watched until the last user stops */
+		void stop()
+		{
+			if (numUsers == 0 || --numUsers != 0)
+				return;
+			stopThread(4000);
+		}
+
+		/* incremental update from the message thread, f.ex. after a preset was saved */
+		void update(const File& file, const ValueTree& state)
+		{
+			auto entry = makeEntry(file, state, extension);
+			{
+				const juce::ScopedLock sl(lock);
+				bool replaced = false;
+				for (auto& e : entries)
+					if (e.file == file)
+					{
+						e = entry;
+						replaced = true;
+						break;
+					}
+				if (!replaced)
+				{
+					entries.push_back(entry);
+					sort(entries);
+				}
+			}
+			needsSave.store(true);
+			sendChangeMessage();
+		}
+
+		/* query, tokens separated by whitespace */
+		Entries search(const String& query) const
+		{
+			const auto tokens = StringArray::fromTokens(query.removeCharacters("#"), true);
+			Entries result;
+			const juce::ScopedLock sl(lock);
+			result.reserve(entries.size());
+			for (const auto& e : entries)
+				if (e.matches(tokens))
+					result.push_back(e);
+			return result;
+		}
+
+		bool isFor(const File& _directory, const String& _extension) const noexcept
+		{
+			return directory == _directory && extension == _extension;
+		}
+
+	protected:
+		const File directory, indexFile;
+		String extension;
+		juce::CriticalSection lock;
+		Entries entries;
+		int numUsers;
+		bool loaded;
+		std::atomic<bool> needsSave;
+
+		void run() override
+		{
+			if (!loaded)
+			{
+				load();
+				loaded = true;
+				sendChangeMessage();
+			}
+
+			while (!threadShouldExit())
+			{
+				if (rescan())
+				{
+					needsSave.store(true);
+					sendChangeMessage();
+				}
+				if (needsSave.exchange(false))
+					save();
+				wait(PollIntervalMs);
+			}
+		}
+
+		/* returns true if anything changed */
+		bool rescan()
+		{
+			Entries prev;
+			{
+				const juce::ScopedLock sl(lock);
+				prev = entries;
+			}
+
+			Entries next;
+			next.reserve(prev.size());
+			bool changed = false;
+
+			for (const auto& it : juce::RangedDirectoryIterator(directory, true, "*" + extension, File::findFiles))
+			{
+				if (threadShouldExit())
+					return false;
+
+				const auto file = it.getFile();
+				const auto mtime = it.getModificationTime().toMilliseconds();
+				const auto size = it.getFileSize();
+
+				const auto known = std::find_if(prev.begin(), prev.end(), [&file](const Entry& e)
+				{
+					return e.file == file;
+				});
+				if (known != prev.end() && known->mtime == mtime && known->size == size)
+				{
+					next.push_back(*known);
+					continue;
+				}
+
+				const auto xml = juce::parseXML(file);
+				if (xml == nullptr)
+					continue;
+				next.push_back(makeEntry(file, ValueTree::fromXml(*xml), extension));
+				changed = true;
+			}
+
+			if (!changed && next.size() == prev.size())
+				return false;
+
+			sort(next);
+			const juce::ScopedLock sl(lock);
+			entries = std::move(next);
+			return true;
+		}
+
+		void load()
+		{
+			juce::MemoryBlock data;
+			if (!indexFile.loadFileAsData(data) || data.getSize() < 8)
+				return;
+
+			juce::MemoryInputStream stream(data, false);
+			if (stream.readInt() != Magic || stream.readInt() != Version)
+				return;
+
+			const auto state = ValueTree::readFromStream(stream);
+			Entries loadedEntries;
+			loadedEntries.reserve(state.getNumChildren());
+			for (const auto child : state)
+			{
+				loadedEntries.push_back
+				({
+					directory.getChildFile(child.getProperty("file").toString()),
+					child.getProperty("name").toString(),
+					StringArray::fromTokens(child.getProperty("tags").toString(), ",", ""),
+					StringArray::fromTokens(child.getProperty("modtypes").toString(), ",", ""),
+					static_cast<int64>(child.getProperty("mtime")),
+					static_cast<int64>(child.getProperty("size")),
+					static_cast<int64>(child.getProperty("fingerprint"))
+				});
+			}
+
+			const juce::ScopedLock sl(lock);
+			entries = std::move(loadedEntries);
+		}
+
+		void save()
+		{
+			ValueTree state("index");
+			{
+				const juce::ScopedLock sl(lock);
+				for (const auto& e : entries)
+				{
+					ValueTree child("preset");
+					child.setProperty("file", e.file.getRelativePathFrom(directory), nullptr);
+					child.setProperty("name", e.name, nullptr);
+					child.setProperty("tags", e.tags.joinIntoString(","), nullptr);
+					child.setProperty("modtypes", e.modTypes.joinIntoString(","), nullptr);
+					child.setProperty("mtime", e.mtime, nullptr);
+					child.setProperty("size", e.size, nullptr);
+					child.setProperty("fingerprint", e.fingerprint, nullptr);
+					state.appendChild(child, nullptr);
+				}
+			}
+
+			juce::MemoryOutputStream stream;
+			stream.writeInt(Magic);
+			stream.writeInt(Version);
+			state.writeToStream(stream);
+			indexFile.replaceWithData(stream.getData(), stream.getDataSize());
+		}
+
+		static void sort(Entries& e)
+		{
+			std::sort(e.begin(), e.end(), [](const Entry& a, const Entry& b)
+			{
+				return a.name.compareNatural(b.name) < 0;
+			});
+		}
+	};
+
+	/* the indices of all plugin instances in this process, one per directory.
+	held through a juce::SharedResourcePointer, so every editor searches the same entries
+	and a directory is only scanned once. message thread */
+	struct Indices
+	{
+		Indices() :
+			indices()
+		{}
+
+		/* directory, extension */
+		Index& get(const File& directory, const String& extension)
+		{
+			for (auto& index : indices)
+				if (index->isFor(directory, extension))
+					return *index;
+			indices.push_back(std::make_unique<Index>(directory, extension));
+			return *indices.back();
+		}
+
+	private:
+		std::vector<std::unique_ptr<Index>> indices;
+	};
+}
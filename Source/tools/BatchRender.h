@@ -0,0 +1,485 @@
+#pragma once
+#include "../PluginProcessor.h"
+#include "../dsp/Simd.h"
+#include "../BenchmarkKernels.h"
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+/*
+offline batch renderer.
+streams audio files through NEL with a fixed preset,
+several files at a time with one processor per worker thread.
+*/
+
+namespace batch
+{
+	using String = juce::String;
+	using StringArray = juce::StringArray;
+	using File = juce::File;
+	using Processor = Nel19AudioProcessor;
+	using AudioBufferF = juce::AudioBuffer<float>;
+	using AudioBufferD = juce::AudioBuffer<double>;
+	using ChannelSet = juce::AudioChannelSet;
+	using Clock = std::chrono::steady_clock;
+	using Duration = std::chrono::duration<double>;
+
+	// what runs instead of the render, if anything
+	enum class Mode { Render, Kernels, Instantiation, Engines, Pool, Realtime };
+
+	struct Settings
+	{
+		File preset, outDir;
+		juce::Array<File> inputs;
+		int blockSize = 1 << 13;
+		int numThreads = juce::SystemStats::getNumCpus();
+		double tailSecs = 1.;
+		// empty picks the best instruction set the cpu supports
+		String simd;
+		Mode mode = Mode::Render;
+	};
+
+	struct Result
+	{
+		File input, output;
+		String error;
+		juce::int64 numSamples = 0;
+		double sampleRate = 0., secs = 0.;
+
+		bool failed() const noexcept { return error.isNotEmpty(); }
+
+		double getRealtimeFactor() const noexcept
+		{
+			if (secs <= 0. || sampleRate <= 0.)
+				return 0.;
+			return static_cast<double>(numSamples) / sampleRate / secs;
+		}
+	};
+
+	inline String getUsage()
+	{
+		return
+			"usage: NEL-BatchRender --preset <file> [--out <dir>] [--threads <n>] [--block <n>] [--tail <secs>] [--simd <isa>] <files...>\n"
+			"       NEL-BatchRender --kernels|--instantiation|--engines|--pool [--simd <isa>]\n"
+			"       NEL-BatchRender --realtime [--preset <file>] [--simd <isa>]\n"
+			"  --preset   a .nel preset or a saved state chunk\n"
+			"  --out      output directory, default: next to each input\n"
+			"  --threads  number of files rendered in parallel\n"
+			"  --block    samples per processBlock call\n"
+			"  --tail     seconds rendered after the end of each input\n"
+			"  --kernels  check the dsp kernels against their references and time them\n"
+			"  --instantiation  time creating and deleting processors, fails above 10 ms each\n"
+			"  --engines  compare memory and time per block of the delay, chorus and allpass engines\n"
+			"  --pool     time the delay engine per block on the realtime worker pool against serial processing\n"
+			"  --realtime  process like a realtime host, fails on anything the audio thread must not do.\n"
+			"             needs a build with NEL_REALTIME_SANITIZER, f.ex. the debug build\n"
+			"  --simd     force an instruction set: scalar, sse2, avx2, avx512 or neon";
+	}
+
+	/* args, settings, returns an error message if the arguments don't make sense */
+	inline String parse(const StringArray& args, Settings& settings)
+	{
+		const auto cwd = File::getCurrentWorkingDirectory();
+		for (auto i = 0; i < args.size(); ++i)
+		{
+			const auto& arg = args[i];
+			const auto hasValue = i + 1 < args.size();
+			if (arg == "--preset" && hasValue)
+				settings.preset = cwd.getChildFile(args[++i]);
+			else if (arg == "--out" && hasValue)
+				settings.outDir = cwd.getChildFile(args[++i]);
+			else if (arg == "--threads" && hasValue)
+				settings.numThreads = juce::jmax(1, args[++i].getIntValue());
+			else if (arg == "--block" && hasValue)
+				settings.blockSize = juce::jlimit(64, 1 << 16, args[++i].getIntValue());
+			else if (arg == "--tail" && hasValue)
+				settings.tailSecs = juce::jmax(0., args[++i].getDoubleValue());
+			else if (arg == "--kernels")
+				settings.mode = Mode::Kernels;
+			else if (arg == "--instantiation")
+				settings.mode = Mode::Instantiation;
+			else if (arg == "--engines")
+				settings.mode = Mode::Engines;
+			else if (arg == "--pool")
+				settings.mode = Mode::Pool;
+			else if (arg == "--realtime")
+				settings.mode = Mode::Realtime;
+			else if (arg == "--simd" && hasValue)
+				settings.simd = args[++i];
+			else if (arg.startsWith("--"))
+				return "unknown option: " + arg;
+			else
+				settings.inputs.add(cwd.getChildFile(arg));
+		}
+
+		if (settings.simd.isNotEmpty() && !simd::isSupported(simd::toISA(settings.simd)))
+			return "unsupported instruction set: " + settings.simd;
+		if (settings.mode != Mode::Render)
+			return settings.preset == File() || settings.preset.existsAsFile() ? String()
+				: "preset not found: " + settings.preset.getFullPathName();
+		if (!settings.preset.existsAsFile())
+			return "preset not found: " + settings.preset.getFullPathName();
+		if (settings.inputs.isEmpty())
+			return "no input files";
+		return {};
+	}
+
+	/* processor, preset file
+	.nel files are presets like the ones of the preset browser, anything else is treated as a state chunk.
+	leaves the processor offline, so that wavetables are imported before this returns. the message loop never runs here */
+	inline String loadPreset(Processor& p, const File& file)
+	{
+		p.setNonRealtime(true);
+		if (file.hasFileExtension(".nel"))
+		{
+			const auto xml = juce::parseXML(file);
+			if (xml == nullptr)
+				return "couldn't parse preset: " + file.getFullPathName();
+			p.params.state = juce::ValueTree::fromXml(*xml);
+			p.loadPatch();
+			return {};
+		}
+
+		juce::MemoryBlock data;
+		if (!file.loadFileAsData(data))
+			return "couldn't read state: " + file.getFullPathName();
+		p.setStateInformation(data.getData(), static_cast<int>(data.getSize()));
+		return {};
+	}
+
+	/* formats, file
+	wav and aiff are memory-mapped, everything else is streamed */
+	inline std::unique_ptr<juce::AudioFormatReader> createReader(juce::AudioFormatManager& formats, const File& file)
+	{
+		if (auto format = formats.findFormatForFileExtension(file.getFileExtension()))
+		{
+			std::unique_ptr<juce::MemoryMappedAudioFormatReader> mapped(format->createMemoryMappedReader(file));
+			if (mapped != nullptr && mapped->mapEntireFile())
+				return mapped;
+		}
+		return std::unique_ptr<juce::AudioFormatReader>(formats.createReaderFor(file));
+	}
+
+	/* processor, numChannels [1, dsp::MaxNumChannels]
+	the usual layout for the number of channels, like a host would pick for a file like that. discrete channels beyond 7.1 */
+	inline bool setLayout(Processor& p, int numChannels)
+	{
+		auto layout = p.getBusesLayout();
+		const auto set = ChannelSet::canonicalChannelSet(numChannels);
+		layout.getChannelSet(true, 0) = set;
+		layout.getChannelSet(false, 0) = set;
+		// the sidechain is fed by the main input when it's disabled
+		for (auto b = 1; b < layout.inputBuses.size(); ++b)
+			layout.getChannelSet(true, b) = ChannelSet::disabled();
+		return p.setBusesLayout(layout);
+	}
+
+	/* processor. the realtime check again, while presets are switched and morphed between the blocks.
+	b is the processor's patch with other parameters and seeds, so that no switch needs a rebuild,
+	which only the message loop could finish */
+	inline bool presetSwitching(Processor& p)
+	{
+		using PID = modSys6::PID;
+		p.savePatch();
+		const auto a = p.params.state.createCopy();
+		juce::Random rand(69);
+		for (const auto pID : { PID::Depth, PID::ModsMix, PID::Perlin0RateHz, PID::Perlin0Octaves, PID::LFO0RateFree, PID::LFO0Waveform })
+			p.params(pID).setValue(rand.nextFloat());
+		p.savePatch();
+		const auto b = p.params.state.createCopy();
+		for (auto m = 0; m < Processor::NumActiveMods; ++m)
+		{
+			const juce::Identifier id(vibrato::toString(vibrato::ObjType::PerlinSeed) + String(m));
+			auto child = b.getChildWithName(id);
+			if (child.isValid())
+				child.setProperty(id, rand.nextInt(), nullptr);
+		}
+		p.switchPreset(a);
+
+		return benchmark::realtimeSafety(p, 1024, 2, 512, [&p, &a, &b](int i)
+		{
+			if (i % 32 == 0)
+				switch ((i / 32) % 3)
+				{
+				case 0: p.switchPreset(b); break;
+				case 1: p.switchPreset(a); break;
+				default: p.morphPresets(a, b); break;
+				}
+			p.setPresetMorph(static_cast<float>(i % 32) / 32.f);
+		}, "realtimePresets");
+	}
+
+	/* processor, input, output, settings
+	renders one file with latency compensation and tail */
+	inline Result render(Processor& p, const File& input, const File& output, const Settings& settings)
+	{
+		Result result;
+		result.input = input;
+		result.output = output;
+
+		juce::AudioFormatManager formats;
+		formats.registerBasicFormats();
+		const auto reader = createReader(formats, input);
+		if (reader == nullptr)
+		{
+			result.error = "unsupported file";
+			return result;
+		}
+
+		// channels beyond what the plugin supports are left out of the render
+		const auto numChannels = juce::jlimit(1, dsp::MaxNumChannels, static_cast<int>(reader->numChannels));
+		const auto sampleRate = reader->sampleRate;
+		const auto blockSize = settings.blockSize;
+		if (!setLayout(p, numChannels))
+		{
+			result.error = "unsupported channel layout";
+			return result;
+		}
+
+		p.setNonRealtime(true);
+		p.setRateAndBufferSizeDetails(sampleRate, blockSize);
+		p.prepareToPlay(sampleRate, blockSize);
+		p.reset();
+
+		output.deleteFile();
+		std::unique_ptr<juce::OutputStream> stream(output.createOutputStream());
+		if (stream == nullptr)
+		{
+			result.error = "couldn't write output";
+			return result;
+		}
+		juce::WavAudioFormat wav;
+		const auto bitDepth = reader->usesFloatingPointData ? 32 : juce::jlimit(16, 24, static_cast<int>(reader->bitsPerSample));
+		std::unique_ptr<juce::AudioFormatWriter> writer(wav.createWriterFor(stream.get(), sampleRate,
+			static_cast<unsigned int>(numChannels), bitDepth, {}, 0));
+		if (writer == nullptr)
+		{
+			result.error = "couldn't create writer";
+			return result;
+		}
+		stream.release();
+
+		const auto latency = static_cast<juce::int64>(p.getLatencySamples());
+		const auto tail = static_cast<juce::int64>(std::round(settings.tailSecs * sampleRate));
+		const auto lengthOut = reader->lengthInSamples + tail;
+		const auto lengthIn = lengthOut + latency;
+
+		AudioBufferF bufferF(numChannels, blockSize);
+		AudioBufferD bufferD(numChannels, blockSize);
+		juce::MidiBuffer midi;
+
+		const auto start = Clock::now();
+		for (juce::int64 pos = 0; pos < lengthIn; pos += blockSize)
+		{
+			const auto numSamples = static_cast<int>(juce::jmin(static_cast<juce::int64>(blockSize), lengthIn - pos));
+			// reading past the end of the file returns silence, that's what renders the tail
+			reader->read(&bufferF, 0, numSamples, pos, true, numChannels > 1);
+
+			for (auto ch = 0; ch < numChannels; ++ch)
+			{
+				const auto src = bufferF.getReadPointer(ch);
+				auto dest = bufferD.getWritePointer(ch);
+				for (auto s = 0; s < numSamples; ++s)
+					dest[s] = static_cast<double>(src[s]);
+			}
+
+			AudioBufferD block(bufferD.getArrayOfWritePointers(), numChannels, numSamples);
+			p.processBlock(block, midi);
+
+			for (auto ch = 0; ch < numChannels; ++ch)
+			{
+				const auto src = bufferD.getReadPointer(ch);
+				auto dest = bufferF.getWritePointer(ch);
+				for (auto s = 0; s < numSamples; ++s)
+					dest[s] = static_cast<float>(src[s]);
+			}
+
+			// the first latency samples are what the lookahead delayed
+			const auto skip = static_cast<int>(juce::jlimit(static_cast<juce::int64>(0), static_cast<juce::int64>(numSamples), latency - pos));
+			if (skip < numSamples)
+				writer->writeFromAudioSampleBuffer(bufferF, skip, numSamples - skip);
+		}
+		writer.reset();
+
+		result.secs = Duration(Clock::now() - start).count();
+		result.numSamples = lengthOut;
+		result.sampleRate = sampleRate;
+		return result;
+	}
+
+	/* one processor per worker, so that no two files share an engine */
+	struct Workers
+	{
+		/* numWorkers, settings */
+		Workers(int numWorkers, const Settings& settings, String& error) :
+			processors(),
+			available(),
+			mutex()
+		{
+			for (auto w = 0; w < numWorkers; ++w)
+			{
+				processors.push_back(std::make_unique<Processor>());
+				error = loadPreset(*processors.back(), settings.preset);
+				if (error.isNotEmpty())
+					return;
+				available.push_back(processors.back().get());
+			}
+		}
+
+		Processor* acquire()
+		{
+			const std::lock_guard<std::mutex> lock(mutex);
+			auto p = available.back();
+			available.pop_back();
+			return p;
+		}
+
+		void release(Processor* p)
+		{
+			const std::lock_guard<std::mutex> lock(mutex);
+			available.push_back(p);
+		}
+
+	protected:
+		std::vector<std::unique_ptr<Processor>> processors;
+		std::vector<Processor*> available;
+		std::mutex mutex;
+	};
+
+	inline File getOutputFile(const File& input, const Settings& settings)
+	{
+		const auto dir = settings.outDir == File() ? input.getParentDirectory() : settings.outDir;
+		return dir.getChildFile(input.getFileNameWithoutExtension() + "_NEL.wav");
+	}
+
+	/* id, log, passes on what a benchmark wrote to its log file */
+	inline void printLog(const String& id, const std::function<void(const String&)>& log)
+	{
+		const auto file = benchmark::getLog(id);
+		log(file.loadFileAsString().trimEnd());
+		log("log: " + file.getFullPathName());
+	}
+
+	/* settings, log, returns the number of checks that failed */
+	inline int runBenchmark(const Settings& settings, const std::function<void(const String&)>& log)
+	{
+		switch (settings.mode)
+		{
+		case Mode::Kernels:
+			return benchmark::kernels(log);
+		case Mode::Instantiation:
+		{
+			const auto passed = benchmark::instantiation([]() -> juce::AudioProcessor* { return new Processor(); });
+			printLog("instantiation", log);
+			return passed ? 0 : 1;
+		}
+		case Mode::Engines:
+			benchmark::vibratoEngines();
+			printLog("engines", log);
+			return 0;
+		case Mode::Pool:
+			benchmark::workerPool();
+			printLog("pool", log);
+			return 0;
+		case Mode::Realtime:
+		{
+			if (!NEL_REALTIME_SANITIZER)
+			{
+				log("built without NEL_REALTIME_SANITIZER, no violation could be caught");
+				return 1;
+			}
+			Processor p;
+			if (settings.preset != File())
+			{
+				const auto error = loadPreset(p, settings.preset);
+				if (error.isNotEmpty())
+				{
+					log(error);
+					return 1;
+				}
+			}
+			p.setNonRealtime(false);
+			if (!setLayout(p, 2))
+			{
+				log("unsupported channel layout");
+				return 1;
+			}
+			p.setRateAndBufferSizeDetails(44100., 512);
+			p.prepareToPlay(44100., 512);
+			auto passed = benchmark::realtimeSafety(p);
+			printLog("realtime", log);
+			passed = presetSwitching(p) && passed;
+			printLog("realtimePresets", log);
+			return passed ? 0 : 1;
+		}
+		default:
+			return 0;
+		}
+	}
+
+	/* settings, log, returns the number of files, or of the benchmark's checks, that failed */
+	inline int run(const Settings& settings, const std::function<void(const String&)>& log)
+	{
+		if (settings.simd.isNotEmpty())
+			simd::force(simd::toISA(settings.simd));
+		if (settings.mode != Mode::Render)
+			return runBenchmark(settings, log);
+		if (settings.outDir != File())
+			settings.outDir.createDirectory();
+		log("instruction set: " + simd::toString(simd::getISA()));
+
+		const auto numWorkers = juce::jlimit(1, juce::jmax(1, settings.inputs.size()), settings.numThreads);
+		String error;
+		Workers workers(numWorkers, settings, error);
+		if (error.isNotEmpty())
+		{
+			log(error);
+			return settings.inputs.size();
+		}
+
+		std::vector<Result> results(static_cast<size_t>(settings.inputs.size()));
+		std::mutex logMutex;
+
+		const auto start = Clock::now();
+		{
+			juce::ThreadPool pool(numWorkers);
+			for (auto i = 0; i < settings.inputs.size(); ++i)
+			{
+				pool.addJob([&, i]()
+				{
+					const auto& input = settings.inputs.getReference(i);
+					auto p = workers.acquire();
+					auto& result = results[static_cast<size_t>(i)];
+					result = render(*p, input, getOutputFile(input, settings), settings);
+					workers.release(p);
+
+					const std::lock_guard<std::mutex> lock(logMutex);
+					if (result.failed())
+						log(input.getFileName() + ": " + result.error);
+					else
+						log(input.getFileName() + " -> " + result.output.getFileName()
+							+ " (" + String(result.getRealtimeFactor(), 1) + "x realtime)");
+				});
+			}
+			while (pool.getNumJobs() > 0)
+				juce::Thread::sleep(20);
+		}
+		const auto secs = Duration(Clock::now() - start).count();
+
+		auto numFailed = 0;
+		auto audioSecs = 0.;
+		for (const auto& result : results)
+		{
+			if (result.failed())
+				++numFailed;
+			else
+				audioSecs += static_cast<double>(result.numSamples) / result.sampleRate;
+		}
+
+		const auto numFiles = static_cast<int>(results.size());
+		log("rendered " + String(numFiles - numFailed) + " of " + String(numFiles) + " files in "
+			+ String(secs, 2) + "s, " + String(secs > 0. ? audioSecs / secs : 0., 1) + "x realtime on "
+			+ String(numWorkers) + " threads");
+		return numFailed;
+	}
+}
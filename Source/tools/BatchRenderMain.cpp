@@ -0,0 +1,26 @@
+#include "BatchRender.h"
+#include <iostream>
+
+int main(int argc, char* argv[])
+{
+	// the processor's timers and async updaters want a message manager
+	juce::ScopedJuceInitialiser_GUI juceInit;
+
+	juce::StringArray args;
+	for (auto i = 1; i < argc; ++i)
+		args.add(juce::CharPointer_UTF8(argv[i]));
+
+	batch::Settings settings;
+	const auto error = batch::parse(args, settings);
+	if (error.isNotEmpty())
+	{
+		std::cerr << error << "\n\n" << batch::getUsage() << std::endl;
+		return 1;
+	}
+
+	const auto numFailed = batch::run(settings, [](const juce::String& msg)
+	{
+		std::cout << msg << std::endl;
+	});
+	return numFailed == 0 ? 0 : 2;
+}